@@ -14,25 +14,199 @@
 #include <zephyr/sys/printk.h>      // for printk()
 #include "IO.h"
 
-const uint8_t buttons_pins[] = {11,12,24,25};             // Vector with pins where buttons are connected
-static const struct device * gpio0_dev = DEVICE_DT_GET(GPIO0_NODE); // Now get the device pointer for GPIO0
+/* Button pins, from the swx aliases. Button i+1 is bit i of the button masks */
+const struct gpio_dt_spec buttons_pins[NUM_BUTTONS] = {
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw1), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw2), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(sw3), gpios),
+};
 
-/* Define a variable of type static struct gpio_callback, which will latter be used to install the callback
-*  It defines e.g. which pin triggers the callback and the address of the function */
-static struct gpio_callback button_cb_data;
+/* Buttons grouped by port, built once by button_config(). Each port has its own
+*  gpio_callback, which tells which pins trigger it and the address of the function */
+struct button_port
+{
+    const struct device *port;
+    gpio_port_pins_t pins;          // Pins of the port owned by buttons
+    gpio_port_pins_t active_low;    // Owned pins whose raw level is inverted
+    struct gpio_callback cb;
+};
+static struct button_port buttons_ports[BUTTONS_MAX_PORTS];
+static uint8_t buttons_port_idx[NUM_BUTTONS];   // Port of each button in buttons_ports
+static int buttons_nports = 0;
+
+/* Button events, lock-free ring: head is only written by the producers
+ * (serialized by button_lock) and tail only by the consumer */
+static struct button_event button_events[BUTTON_EVENTS_LEN];
+static atomic_t button_events_head;
+static atomic_t button_events_tail;
+static struct k_sem button_events_sem;          // Counts events ready for the consumer
+static struct button_stats button_stats;
+
+/* Debounce state */
+static struct k_spinlock button_lock;           // Serializes the GPIO ISR and the debounce timer
+static struct k_timer button_debounce_timer;    // Re-samples the buttons when a window ends
+static uint32_t button_debounce_cyc;            // Debounce window (in cycles)
+static uint32_t button_edge_time[NUM_BUTTONS];  // Time of the last accepted edge of each button
+static uint8_t button_locked;                   // Buttons inside their debounce window
+static uint8_t button_accepted;                 // Debounced state (bit i = button i+1 pressed)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(BUTTON_EVENTS_LEN), "BUTTON_EVENTS_LEN must be a power of two");
 
-uint8_t button_state[4];    // Array to track all buttons state
+/* Output pins, from the ledx aliases. Output i+1 is bit i of the output image */
+const struct gpio_dt_spec outputs_pins[NUM_OUTPUTS] = {
+    GPIO_DT_SPEC_GET(DT_ALIAS(led0), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(led1), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(led2), gpios),
+    GPIO_DT_SPEC_GET(DT_ALIAS(led3), gpios),
+};
+
+/* Outputs grouped by port, built once by outputs_config() */
+struct output_port
+{
+    const struct device *port;
+    gpio_port_pins_t pins;          // Pins of the port owned by outputs
+    gpio_port_pins_t active_low;    // Owned pins whose raw level is inverted
+    uint32_t image_mask;            // Image bits of the outputs on this port
+};
+static struct output_port outputs_ports[OUTPUTS_MAX_PORTS];
+static int outputs_nports = 0;
+static atomic_t outputs_image;
+
+/*
+ * Reads every button with a single read per port.
+ */
+static uint8_t buttons_sample()
+{
+    gpio_port_value_t raw[BUTTONS_MAX_PORTS];
+    uint8_t pressed = 0;
+    int p;
+
+    for(p = 0; p < buttons_nports; p++)
+    {
+        raw[p] = 0;
+        gpio_port_get_raw(buttons_ports[p].port, &raw[p]);
+        raw[p] ^= buttons_ports[p].active_low;
+    }
+    for(int i=0; i<NUM_BUTTONS; i++)
+    {
+        if(raw[buttons_port_idx[i]] & BIT(buttons_pins[i].pin))
+        {
+            pressed |= BIT(i);
+        }
+    }
+    return pressed;
+}
+
+/*
+ * Debounces the current button levels and queues an event if any button changed.
+ * Runs in interrupt context, from the GPIO callback and from the debounce timer.
+ */
+static void buttons_update(bool from_edge)
+{
+    k_spinlock_key_t key = k_spin_lock(&button_lock);
+    uint32_t now = k_cycle_get_32();
+    uint8_t pressed = buttons_sample();
+    uint8_t changed;
+    uint32_t head;
+    struct button_event *ev;
+    int i;
+
+    /* Release buttons whose debounce window has ended */
+    for(i=0; i<NUM_BUTTONS; i++)
+    {
+        if((button_locked & BIT(i)) && (now - button_edge_time[i]) >= button_debounce_cyc)
+        {
+            button_locked &= ~BIT(i);
+        }
+    }
+
+    if(from_edge && ((pressed ^ button_accepted) & button_locked))
+    {
+        button_stats.bounces++;
+    }
+
+    /* Accept changes of the buttons that are not bouncing and open their window */
+    changed = (pressed ^ button_accepted) & ~button_locked;
+    if(changed)
+    {
+        for(i=0; i<NUM_BUTTONS; i++)
+        {
+            if(changed & BIT(i))
+            {
+                button_edge_time[i] = now;
+            }
+        }
+        button_accepted ^= changed;
+        button_locked |= changed;
+
+        head = atomic_get(&button_events_head);
+        if(head - (uint32_t)atomic_get(&button_events_tail) < BUTTON_EVENTS_LEN)
+        {
+            ev = &button_events[head & (BUTTON_EVENTS_LEN - 1)];
+            ev->timestamp = now;
+            ev->pressed = button_accepted;
+            ev->changed = changed;
+            atomic_inc(&button_events_head);
+            button_stats.events++;
+            k_sem_give(&button_events_sem);
+        }
+        else
+        {
+            button_stats.overflows++;
+        }
+    }
+
+    /* Sample again when the windows end, a bounce may have hidden the final level */
+    if(button_locked && k_timer_remaining_get(&button_debounce_timer) == 0)
+    {
+        k_timer_start(&button_debounce_timer, K_CYC(button_debounce_cyc), K_NO_WAIT);
+    }
+
+    k_spin_unlock(&button_lock, key);
+}
+
+static void button_debounce_expired(struct k_timer *timer)
+{
+    buttons_update(false);
+}
 
 /*
  * Callback function for button presses.
- * It updates the button_state array based on which buttons are pressed.
+ * It queues a timestamped event for every debounced change of the buttons.
  */
 void button_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t pins)
 {
-    for(int i=0; i<sizeof(buttons_pins); i++)
+    buttons_update(true);
+}
+
+int button_event_get(struct button_event *ev, k_timeout_t timeout)
+{
+    if(k_sem_take(&button_events_sem, timeout) != 0)
     {
-        button_state[i] = !gpio_pin_get(gpio0_dev, buttons_pins[i]);
+        return -EAGAIN;
     }
+    *ev = button_events[atomic_get(&button_events_tail) & (BUTTON_EVENTS_LEN - 1)];
+    atomic_inc(&button_events_tail);
+    return 0;
+}
+
+void button_debounce_set(uint32_t us)
+{
+    button_debounce_cyc = k_us_to_cyc_ceil32(us);
+}
+
+uint32_t button_debounce_get()
+{
+    return k_cyc_to_us_floor32(button_debounce_cyc);
+}
+
+void button_get_stats(struct button_stats *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&button_lock);
+
+    *stats = button_stats;
+    k_spin_unlock(&button_lock, key);
 }
 
 /*
@@ -42,61 +216,147 @@ void button_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t
 void button_config()
 {
     int ret;
-    int i;
-    uint32_t pinmask = 0;   // Mask for setting the pins that shall generate interrupts
+    int i, p;
 	
+    /* Event queue and debouncing */
+    k_sem_init(&button_events_sem, 0, BUTTON_EVENTS_LEN);
+    k_timer_init(&button_debounce_timer, button_debounce_expired, NULL);
+    button_debounce_set(BUTTON_DEBOUNCE_US);
+
     /* Welcome message */
-    printk("Digital IO accessing IO pins not set via DT (external buttons in the case) \n\r");
-    printk("Hit buttons 1-8 (1...4 internal, 5-8 external connected to A0...A3). Led toggles and button ID printed at console \n\r");
+    printk("Digital IO accessing the buttons through the sw0...sw3 devicetree aliases\n\r");
 
-    /* Check if gpio0 device is ready */
-    if (!device_is_ready(gpio0_dev)) 
-    {
-        printk("Error: gpio0 device is not ready\n");
-        return;
-    } 
-    else 
+    for(i=0; i<NUM_BUTTONS; i++)
     {
-        printk("Success: gpio0 device is ready\n");
-    }
+        /* Check if the button device is ready */
+        if (!gpio_is_ready_dt(&buttons_pins[i]))
+        {
+            printk("Error: button %d device is not ready\n\r", i+1);
+            return;
+        }
 
-    /* Configure GPIO pins as inputs with pull-up resistors */
-    for(i=0; i<sizeof(buttons_pins); i++) 
-    {
-        ret = gpio_pin_configure(gpio0_dev, buttons_pins[i], GPIO_INPUT | GPIO_PULL_UP);
-        if (ret < 0) 
+        /* Configure the pin as input, pull-up and polarity come from the devicetree */
+        ret = gpio_pin_configure_dt(&buttons_pins[i], GPIO_INPUT);
+        if (ret < 0)
         {
-            printk("Error: gpio_pin_configure failed for button %d/pin %d, error:%d\n\r", i+1, buttons_pins[i], ret);
+            printk("Error: gpio_pin_configure_dt failed for button %d/pin %d, error:%d\n\r", i+1, buttons_pins[i].pin, ret);
             return;
-        } 
-        else 
+        }
+
+        /* Configure interrupt on the button's pin */
+        ret = gpio_pin_interrupt_configure_dt(&buttons_pins[i], GPIO_INT_EDGE_BOTH);
+        if (ret < 0)
         {
-            printk("Success: gpio_pin_configure for button %d/pin %d\n\r", i+1, buttons_pins[i]);
+            printk("Error: gpio_pin_interrupt_configure_dt failed for button %d/pin %d, error:%d\n\r", i+1, buttons_pins[i].pin, ret);
+            return;
         }
+
+        /* Find or add the port of the button */
+        for(p = 0; p < buttons_nports && buttons_ports[p].port != buttons_pins[i].port; p++)
+        {
+        }
+        if(p == buttons_nports)
+        {
+            buttons_ports[p].port = buttons_pins[i].port;
+            buttons_nports++;
+        }
+        buttons_ports[p].pins |= BIT(buttons_pins[i].pin);
+        if(buttons_pins[i].dt_flags & GPIO_ACTIVE_LOW)
+        {
+            buttons_ports[p].active_low |= BIT(buttons_pins[i].pin);
+        }
+        buttons_port_idx[i] = p;
+    }
+
+    /* One callback per port, for the pins of the buttons on it */
+    for(p = 0; p < buttons_nports; p++)
+    {
+        gpio_init_callback(&buttons_ports[p].cb, button_pressed, buttons_ports[p].pins);
+        gpio_add_callback(buttons_ports[p].port, &buttons_ports[p].cb);
     }
 
-    /* Configure interrupt on the button's pin */
-    for(i=0; i<sizeof(buttons_pins); i++) 
+    /* HW init done!*/
+    printk("All devices initialized successfully!\n\r");
+
+    /* Start from the current levels */
+    button_accepted = buttons_sample();
+}
+
+
+/*
+ * Configures the output pins and groups them by port.
+ * Must run before outputs_apply() is used.
+ */
+void outputs_config()
+{
+    int ret;
+    int i, p;
+
+    outputs_nports = 0;
+    for(i = 0; i < NUM_OUTPUTS; i++)
     {
-        ret = gpio_pin_interrupt_configure(gpio0_dev, buttons_pins[i], GPIO_INT_EDGE_BOTH);
-        if (ret < 0) 
+        /* Check if the led device is ready */
+        if (!device_is_ready(outputs_pins[i].port))
         {
-            printk("Error: gpio_pin_interrupt_configure failed for button %d / pin %d, error:%d", i+1, buttons_pins[i], ret);
+            printk("Fatal error: led%d device not ready!\n\r", i);
             return;
         }
+
+        /* Configure the led GPIO pin, off */
+        ret = gpio_pin_configure_dt(&outputs_pins[i], GPIO_OUTPUT_INACTIVE);
+        if (ret < 0)
+        {
+            printk("Failed to configure led%d \n\r", i);
+            return;
+        }
+
+        /* Find or add its port */
+        for(p = 0; p < outputs_nports && outputs_ports[p].port != outputs_pins[i].port; p++)
+        {
+        }
+        if(p == outputs_nports)
+        {
+            outputs_ports[p].port = outputs_pins[i].port;
+            outputs_nports++;
+        }
+        outputs_ports[p].pins |= BIT(outputs_pins[i].pin);
+        outputs_ports[p].image_mask |= BIT(i);
+        if(outputs_pins[i].dt_flags & GPIO_ACTIVE_LOW)
+        {
+            outputs_ports[p].active_low |= BIT(outputs_pins[i].pin);
+        }
     }
 
-    /* HW init done!*/
-    printk("All devices initialized successfully!\n\r");
+    outputs_apply(0);
+}
+
+/*
+ * Converts the image into raw levels and writes each port once.
+ */
+void outputs_apply(uint32_t image)
+{
+    struct output_port *op;
+    gpio_port_value_t raw;
+    uint32_t bits;
+    int p, i;
 
-    /* Initialize the static struct gpio_callback variable   */
-    pinmask=0;
-    for(i=0; i<sizeof(buttons_pins); i++) 
+    for(p = 0; p < outputs_nports; p++)
     {
-        pinmask |= BIT(buttons_pins[i]);
+        op = &outputs_ports[p];
+        raw = 0;
+        bits = image & op->image_mask;
+        while(bits)
+        {
+            i = __builtin_ctz(bits);
+            bits &= bits - 1;
+            raw |= BIT(outputs_pins[i].pin);
+        }
+        gpio_port_set_masked_raw(op->port, op->pins, raw ^ op->active_low);
     }
-    gpio_init_callback(&button_cb_data, button_pressed, pinmask); 
-    
-    /* Add the callback function by calling gpio_add_callback()   */
-    gpio_add_callback(gpio0_dev, &button_cb_data);
+    atomic_set(&outputs_image, image);
+}
+
+uint32_t outputs_image_get()
+{
+    return (uint32_t)atomic_get(&outputs_image);
 }
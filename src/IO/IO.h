@@ -21,19 +21,134 @@
 
 #define SLEEP_TIME_MS   60*1000
 
+/*
+ * Buttons 1-4 are the sw0...sw3 aliases and outputs 1-4 the led0...led3
+ * aliases of the board devicetree (the on-board ones on the DK, emulated
+ * GPIOs on native_sim, see boards/native_sim.overlay).
+ */
+#define NUM_BUTTONS 4                   /**< Number of buttons */
+#define BUTTONS_MAX_PORTS NUM_BUTTONS   /**< Worst case: every button on its own port */
+#define BUTTON_EVENTS_LEN 16            /**< Button events that can be queued (power of two) */
+#define BUTTON_DEBOUNCE_US 20000        /**< Default debounce window (in us) */
+
+#define NUM_OUTPUTS 4                   /**< Number of digital outputs (LEDs led0...led3) */
+#define OUTPUTS_MAX_PORTS NUM_OUTPUTS   /**< Worst case: every output on its own port */
+
+/**
+ * \struct button_event
+ * \brief One debounced change of the buttons.
+ */
+struct button_event
+{
+    uint32_t timestamp;     /**< k_cycle_get_32() at the edge */
+    uint8_t pressed;        /**< Buttons pressed after the change (bit i = button i+1) */
+    uint8_t changed;        /**< Buttons that changed */
+};
+
+/**
+ * \struct button_stats
+ * \brief Counters kept by the button event queue.
+ */
+struct button_stats
+{
+    uint32_t events;        /**< Events queued */
+    uint32_t overflows;     /**< Events dropped because the queue was full */
+    uint32_t bounces;       /**< Edges ignored inside a debounce window */
+};
+
+extern const struct gpio_dt_spec buttons_pins[NUM_BUTTONS];    /**< Button i+1 is bit i of the button masks */
+extern const struct gpio_dt_spec outputs_pins[NUM_OUTPUTS];    /**< Output i+1 is bit i of the output image */
+
 /**
- * \brief Pin definitions for LEDs and buttons.
+ * \brief Waits for the next button event.
  *
- * LEDs 1-4 and buttons 1-4 are the ones on board.
+ * Only one thread may consume events.
+ *
+ * \param ev Destination of the event.
+ * \param timeout Maximum time to wait.
+ * \return 0 if an event was copied, -EAGAIN on timeout.
+ */
+int button_event_get(struct button_event *ev, k_timeout_t timeout);
+
+/**
+ * \brief Changes the debounce window.
+ *
+ * After an accepted edge, a button ignores further edges until the window
+ * ends; its level is then sampled again, so the final state is never lost.
+ *
+ * \param us Window length (in us).
  */
-#define LED1_PIN 13
-#define LED2_PIN 14
-#define LED3_PIN 15
-#define LED4_PIN 16
+void button_debounce_set(uint32_t us);
 
-#define GPIO0_NODE DT_NODELABEL(gpio0)  /**< Device tree node for GPIO */
+/**
+ * \brief Returns the debounce window (in us).
+ */
+uint32_t button_debounce_get();
 
-extern uint8_t button_state[4];         /**< Array to store button states */
+/**
+ * \brief Copies the button event queue counters.
+ * \param stats Destination of the counters.
+ */
+void button_get_stats(struct button_stats *stats);
+
+/**
+ * \brief Operations on the output image.
+ */
+enum output_op
+{
+    OUTPUT_OP_SET = 0,      /**< Turn on the outputs in mask */
+    OUTPUT_OP_CLEAR,        /**< Turn off the outputs in mask */
+    OUTPUT_OP_TOGGLE,       /**< Invert the outputs in mask */
+    OUTPUT_OP_WRITE,        /**< Outputs in mask take the matching bits of value */
+};
+
+/**
+ * \brief Applies an operation to an output image.
+ *
+ * \param image Current image (bit i = output i+1).
+ * \param op Operation.
+ * \param mask Outputs affected.
+ * \param value New bits for OUTPUT_OP_WRITE, ignored otherwise.
+ * \return New image.
+ */
+static inline uint32_t outputs_image_op(uint32_t image, enum output_op op, uint32_t mask, uint32_t value)
+{
+    switch(op)
+    {
+        case OUTPUT_OP_SET:
+            return image | mask;
+        case OUTPUT_OP_CLEAR:
+            return image & ~mask;
+        case OUTPUT_OP_TOGGLE:
+            return image ^ mask;
+        default:
+            return (image & ~mask) | (value & mask);
+    }
+}
+
+/**
+ * \brief Configures the output for the LEDs.
+ *
+ * Configures every output pin and groups them by GPIO port so that
+ * outputs_apply() needs a single register write per port. All outputs
+ * start off.
+ */
+void outputs_config();
+
+/**
+ * \brief Drives every output from an image.
+ *
+ * Outputs on the same port switch together, with one gpio_port_set_masked_raw()
+ * call per port and no intermediate state.
+ *
+ * \param image Desired output states (bit i = output i+1).
+ */
+void outputs_apply(uint32_t image);
+
+/**
+ * \brief Returns the last image given to outputs_apply().
+ */
+uint32_t outputs_image_get();
 
 /**
  * \brief Callback function for button presses.
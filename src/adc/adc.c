@@ -2,45 +2,338 @@
  * \file adc.c
  * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
  * \date 1, June, 2024
- * \brief Implementation of ADC module that reads an ADC input and prints the corresponding raw and voltage value in the console.
+ * \brief Continuous, double-buffered, multi-channel ADC acquisition engine.
+ *
+ * The sequence is started once with adc_read_async() and an interval. Its
+ * callback runs after every scan, copies the frame into the block being
+ * filled and answers ADC_ACTION_REPEAT, so the driver keeps scanning into the
+ * same one-frame buffer forever. When a block is full it is
+ * published to the consumer through a semaphore; if the consumer still owns
+ * every slot of the ring the block is dropped and counted as an overrun.
  */
 
 #include "adc.h"
+#include "conv.h"
+#include "filter.h"
+#include "alarm.h"
+#include "wstats.h"
 
-/* ADC channel configuration */
-static const struct adc_channel_cfg my_channel_cfg = {
-	.gain = ADC_GAIN,
-	.reference = ADC_REFERENCE,
-	.acquisition_time = ADC_ACQUISITION_TIME,
-	.channel_id = ADC_CHANNEL_ID,
-	.input_positive = ADC_CHANNEL_INPUT
+#if defined(CONFIG_ADC_NRFX_SAADC)
+#define ADC_INPUT(n) NRF_SAADC_INPUT_AIN##n
+#else
+#define ADC_INPUT(n) (n)
+#endif
+
+/* Scan list: potentiometer on AIN1, field sensors on AIN2, AIN4 and AIN5 */
+const struct adc_scan_channel adc_scan_list[ADC_SCAN_CHANNELS] = {
+	{ .channel_id = 0, .input = ADC_INPUT(1), .decimation = 1 },
+	{ .channel_id = 1, .input = ADC_INPUT(2), .decimation = 1 },
+	{ .channel_id = 2, .input = ADC_INPUT(4), .decimation = 4 },
+	{ .channel_id = 3, .input = ADC_INPUT(5), .decimation = 16 },
 };
 
+struct adc_channel_result adc_results[ADC_SCAN_CHANNELS];
+static uint8_t adc_decim_cnt[ADC_SCAN_CHANNELS];    /* Blocks left until the channel is due */
+
 static const struct device *adc_dev = NULL;
 
-/**
- * Takes one sample from the ADC.
- * Returns 0 if successful, negative value if there's an error.
+/* Ring of blocks shared with the consumer. head is only written by the
+ * sequence callback and tail only by the consumer. */
+static struct adc_block adc_ring[ADC_STREAM_BLOCKS];
+static struct adc_block adc_discard;        /* Target of samples that do not fit in the ring */
+static atomic_t adc_ring_head;              /* Blocks produced */
+static atomic_t adc_ring_tail;              /* Blocks released by the consumer */
+static struct adc_block *adc_fill_block;    /* Block being filled by the callback */
+static uint32_t adc_fill;                   /* Samples already in adc_fill_block */
+static struct k_sem adc_block_sem;          /* Counts blocks ready for the consumer */
+
+static int16_t adc_scan_frame[ADC_SCAN_CHANNELS];   /* Written by the driver on every scan */
+static uint32_t adc_scan_mask;              /* Channels of the sequence */
+static struct k_poll_signal adc_done_sig;   /* Raised when the sequence stops */
+static atomic_t adc_interval_us;            /* Interval applied on the next (re)start */
+static atomic_t adc_restart;                /* Set to finish the running sequence */
+static struct adc_stream_stats adc_stats;
+static bool adc_stopped;                    /* The last (re)arm failed, the sequence is not running */
+static uint32_t adc_backoff_ms = ADC_ARM_BACKOFF_MIN_MS;   /* Wait before the next re-arm attempt */
+
+static struct adc_sequence_options adc_options;
+static struct adc_sequence adc_seq;
+
+BUILD_ASSERT(IS_POWER_OF_TWO(ADC_STREAM_BLOCKS), "ADC_STREAM_BLOCKS must be a power of two");
+
+/*
+ * Sequence callback, runs in the driver (interrupt) context after every conversion.
  */
-int adc_sample(void)
+static enum adc_action adc_stream_cb(const struct device *dev,
+				     const struct adc_sequence *sequence,
+				     uint16_t sampling_index)
+{
+	uint32_t head;
+
+	if (atomic_get(&adc_restart)) {
+		return ADC_ACTION_FINISH;
+	}
+
+	/* Pick the destination slot when a new block starts */
+	if (adc_fill == 0) {
+		head = atomic_get(&adc_ring_head);
+		if (head - (uint32_t)atomic_get(&adc_ring_tail) < ADC_STREAM_BLOCKS) {
+			adc_fill_block = &adc_ring[head & (ADC_STREAM_BLOCKS - 1)];
+		} else {
+			adc_fill_block = &adc_discard;
+		}
+	}
+
+	/* Alarms see every frame as soon as it is converted */
+	alarm_eval(adc_scan_frame);
+	memcpy(adc_fill_block->samples[adc_fill++], adc_scan_frame, sizeof(adc_scan_frame));
+
+	if (adc_fill == ADC_BLOCK_SAMPLES) {
+		adc_fill = 0;
+		adc_fill_block->timestamp = k_cycle_get_32();
+		if (adc_fill_block == &adc_discard) {
+			adc_stats.overruns++;
+		} else {
+			adc_fill_block->seq = adc_stats.blocks++ + adc_stats.overruns;
+			atomic_inc(&adc_ring_head);
+			k_sem_give(&adc_block_sem);
+		}
+	}
+
+	/* Keep sampling into the same buffer, the sequence never ends by itself */
+	return ADC_ACTION_REPEAT;
+}
+
+#if defined(CONFIG_ADC_EMUL)
+/*
+ * Emulated input for native_sim: 0 -> 3000 mV -> 0 triangle with a 2 s period,
+ * shifted by 500 ms per channel.
+ */
+static int adc_emul_ramp(const struct device *dev, unsigned int chan, void *data, uint32_t *result)
+{
+	uint32_t t = (k_uptime_get_32() + chan * 500) % 2000;
+
+	*result = (t < 1000) ? (t * 3) : ((2000 - t) * 3);
+	return 0;
+}
+
+/*
+ * Holds one scan list entry at a fixed voltage, or gives it back to the
+ * ramp when mv is negative. Used by the latency benchmarks.
+ */
+int adc_emul_inject(int ch, int32_t mv)
+{
+	if (adc_dev == NULL || ch < 0 || ch >= ADC_SCAN_CHANNELS) {
+		return -ENODEV;
+	}
+
+	if (mv < 0) {
+		return adc_emul_value_func_set(adc_dev, adc_scan_list[ch].channel_id, adc_emul_ramp, NULL);
+	}
+	return adc_emul_const_value_set(adc_dev, adc_scan_list[ch].channel_id, (uint32_t)mv);
+}
+#endif
+
+/*
+ * Arms the sequence with the current interval.
+ */
+static int adc_stream_arm(void)
+{
+	int ret;
+
+	adc_fill = 0;
+	atomic_clear(&adc_restart);
+	k_poll_signal_reset(&adc_done_sig);
+
+	adc_options.interval_us = (uint32_t)atomic_get(&adc_interval_us);
+	alarm_set_interval(adc_options.interval_us);
+	wstats_set_interval(adc_options.interval_us);
+	adc_options.callback = adc_stream_cb;
+	adc_options.extra_samplings = 0;   /* Buffer holds one frame, the callback repeats it */
+
+	adc_seq.options = &adc_options;
+	adc_seq.channels = adc_scan_mask;
+	adc_seq.buffer = adc_scan_frame;
+	adc_seq.buffer_size = sizeof(adc_scan_frame);
+	adc_seq.resolution = ADC_RESOLUTION;
+
+	ret = adc_read_async(adc_dev, &adc_seq, &adc_done_sig);
+	if (ret) {
+		printk("adc_read_async() failed with code %d\n\r", ret);
+	}
+
+	return ret;
+}
+
+/*
+ * Binds the ADC device and configures every channel of the scan list.
+ * Returns ERR_OK if successful, ERR_CONFIG otherwise.
+ */
+int adc_stream_init(void)
 {
 	int ret;
-	const struct adc_sequence sequence = {
-		.channels = BIT(ADC_CHANNEL_ID),
-		.buffer = adc_sample_buffer,
-		.buffer_size = sizeof(adc_sample_buffer),
-		.resolution = ADC_RESOLUTION
+	int i;
+	struct adc_channel_cfg channel_cfg = {
+		.gain = ADC_GAIN,
+		.reference = ADC_REFERENCE,
+		.acquisition_time = ADC_ACQUISITION_TIME,
 	};
 
+	adc_dev = DEVICE_DT_GET(ADC_NODE);
+	if (!device_is_ready(adc_dev)) {
+		printk("ADC device not ready\n\r");
+		adc_dev = NULL;
+		return ERR_CONFIG;
+	}
+
+	adc_scan_mask = 0;
+	for (i = 0; i < ADC_SCAN_CHANNELS; i++) {
+		if (i > 0 && adc_scan_list[i].channel_id <= adc_scan_list[i - 1].channel_id) {
+			printk("adc_scan_list must be sorted by channel_id\n\r");
+			adc_dev = NULL;
+			return ERR_CONFIG;
+		}
+
+		channel_cfg.channel_id = adc_scan_list[i].channel_id;
+#if defined(CONFIG_ADC_CONFIGURABLE_INPUTS)
+		channel_cfg.input_positive = adc_scan_list[i].input;
+#endif
+		ret = adc_channel_setup(adc_dev, &channel_cfg);
+		if (ret) {
+			printk("adc_channel_setup() failed for channel %d with code %d\n\r", i, ret);
+			adc_dev = NULL;
+			return ERR_CONFIG;
+		}
+
+		adc_scan_mask |= BIT(adc_scan_list[i].channel_id);
+		adc_decim_cnt[i] = 1;
+#if defined(CONFIG_ADC_EMUL)
+		adc_emul_value_func_set(adc_dev, adc_scan_list[i].channel_id, adc_emul_ramp, NULL);
+#endif
+	}
+
+	conv_init();
+	if (filter_stage_init() || alarm_init()) {
+		adc_dev = NULL;
+		return ERR_CONFIG;
+	}
+	k_sem_init(&adc_block_sem, 0, ADC_STREAM_BLOCKS);
+	k_poll_signal_init(&adc_done_sig);
+
+	return ERR_OK;
+}
+
+/*
+ * Starts continuous sampling.
+ * Returns ERR_OK if successful, negative value if there's an error.
+ */
+int adc_stream_start(uint32_t interval_us)
+{
 	if (adc_dev == NULL) {
-		printk("\n\n\nadc_sample(): error, must bind to adc first \n\r");
-		return -1;
+		printk("\n\n\nadc_stream_start(): error, must bind to adc first \n\r");
+		return ERR_CONFIG;
 	}
 
-	ret = adc_read(adc_dev, &sequence);
-	if (ret) {
-		printk("\n\n\nadc_read() failed with code %d\n", ret);
+	atomic_set(&adc_interval_us, interval_us);
+
+	return adc_stream_arm();
+}
+
+void adc_stream_set_interval(uint32_t interval_us)
+{
+	atomic_set(&adc_interval_us, interval_us);
+	atomic_set(&adc_restart, 1);
+}
+
+/*
+ * Waits for the next block, re-arming the sequence whenever it has stopped.
+ */
+const struct adc_block *adc_stream_get(k_timeout_t timeout)
+{
+	struct k_poll_event events[2];
+	unsigned int signaled;
+	int result;
+
+	if (adc_dev == NULL) {
+		return NULL;
 	}
 
-	return ret;
+	k_poll_event_init(&events[0], K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY, &adc_block_sem);
+	k_poll_event_init(&events[1], K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &adc_done_sig);
+
+	while (1) {
+		if (k_sem_take(&adc_block_sem, K_NO_WAIT) == 0) {
+			return &adc_ring[atomic_get(&adc_ring_tail) & (ADC_STREAM_BLOCKS - 1)];
+		}
+
+		/* Sequence finished (interval change or driver error): start it again */
+		k_poll_signal_check(&adc_done_sig, &signaled, &result);
+		if (signaled || adc_stopped) {
+			/* Back off after a failed attempt, so a dead driver does not spin the thread */
+			if (adc_stopped) {
+				k_sleep(K_MSEC(adc_backoff_ms));
+				adc_backoff_ms = MIN(adc_backoff_ms * 2, ADC_ARM_BACKOFF_MAX_MS);
+			}
+			adc_stats.restarts++;
+			if (adc_stream_arm()) {
+				adc_stats.arm_failures++;
+				adc_stopped = true;
+				return NULL;
+			}
+			adc_stopped = false;
+			adc_backoff_ms = ADC_ARM_BACKOFF_MIN_MS;
+			continue;
+		}
+
+		if (k_poll(events, ARRAY_SIZE(events), timeout) == -EAGAIN) {
+			return NULL;
+		}
+		events[0].state = K_POLL_STATE_NOT_READY;
+		events[1].state = K_POLL_STATE_NOT_READY;
+	}
+}
+
+void adc_stream_release(void)
+{
+	atomic_inc(&adc_ring_tail);
+}
+
+uint32_t adc_scan_publish(const struct adc_block *blk)
+{
+	int16_t filtered[ADC_BLOCK_SAMPLES];
+	uint32_t updated = 0;
+	int i, n;
+
+	for (i = 0; i < ADC_SCAN_CHANNELS; i++) {
+		/* Filters keep history, so they see every block; unfiltered channels only cost when due */
+		if (filter_cfg[i].type != FILTER_NONE) {
+			n = filter_channel(i, blk, filtered);
+		} else {
+			n = 0;
+		}
+
+		if (--adc_decim_cnt[i] != 0) {
+			continue;
+		}
+		adc_decim_cnt[i] = adc_scan_list[i].decimation;
+
+		adc_results[i].raw = (n > 0) ? filtered[n - 1] : blk->samples[ADC_BLOCK_SAMPLES - 1][i];
+		adc_results[i].value = conv_apply(i, adc_results[i].raw);
+		adc_results[i].timestamp = blk->timestamp;
+		adc_results[i].count++;
+		updated |= BIT(i);
+	}
+
+	return updated;
+}
+
+int16_t adc_latest(int ch)
+{
+	/* Written by the driver on every scan, a 16-bit read is never torn */
+	return adc_scan_frame[ch];
+}
+
+void adc_stream_get_stats(struct adc_stream_stats *stats)
+{
+	*stats = adc_stats;
 }
@@ -2,7 +2,13 @@
  * \file adc.h
  * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
  * \date 1, June, 2024
- * \brief Implementation of ADC module that reads an ADC input and prints the corresponding raw and voltage value in the console.
+ * \brief Continuous, double-buffered, multi-channel ADC acquisition engine.
+ *
+ * The ADC is armed once with adc_read_async() and then samples on its own
+ * at a fixed interval. Each sampling converts every channel of the scan list
+ * in one burst. The sequence callback copies each scan frame into a ring of
+ * fixed-size blocks. Consumers wake only when a whole block is ready, never
+ * once per sample.
  */
 
 #ifndef ADC_H
@@ -16,31 +22,178 @@
 #include <zephyr/sys/printk.h>      /* for printk()*/
 #include <string.h>
 
+#if defined(CONFIG_ADC_NRFX_SAADC)
 #include <hal/nrf_saadc.h>              /* ADC definitions and includes */
+#endif
+
+#if defined(CONFIG_ADC_EMUL)
+#include <zephyr/drivers/adc/adc_emul.h> /* ADC emulator used on native_sim */
+#endif
 
 #define ADC_RESOLUTION 10               /* ADC resolution in bits */
+#define ADC_FULL_SCALE_MV 3000          /* Input voltage that reads as full scale */
+#if defined(CONFIG_ADC_EMUL)
+#define ADC_GAIN ADC_GAIN_1             /* The emulator only supports unity gain */
+#define ADC_REFERENCE ADC_REF_INTERNAL  /* Emulator reference (ref-internal-mv in DT) */
+#define ADC_ACQUISITION_TIME ADC_ACQ_TIME_DEFAULT
+#else
 #define ADC_GAIN ADC_GAIN_1_4           /* ADC gain setting */
 #define ADC_REFERENCE ADC_REF_VDD_1_4   /* ADC reference voltage */
 #define ADC_ACQUISITION_TIME ADC_ACQ_TIME(ADC_ACQ_TIME_MICROSECONDS, 40) /**< ADC acquisition time */
-#define ADC_CHANNEL_ID 1                /* ADC channel ID */
+#endif
 
-#define ADC_CHANNEL_INPUT NRF_SAADC_INPUT_AIN1 /*nRF ANx input to use*/
+#define ADC_SCAN_CHANNELS 4             /* Channels in the scan list (see adc_scan_list in adc.c) */
+#define ADC_POT_CHANNEL 0               /* Scan list index of the potentiometer */
 
-#define BUFFER_SIZE 1                   /* Buffer size for ADC samples */
+#define ADC_BLOCK_SAMPLES 32            /* Scan frames (samples per channel) per streaming block */
+#define ADC_STREAM_BLOCKS 4             /* Blocks in the stream ring (power of two, >= 2 for ping-pong) */
+#define ADC_ARM_BACKOFF_MIN_MS 10       /* First wait before re-arming a sequence the driver refused */
+#define ADC_ARM_BACKOFF_MAX_MS 1000     /* Longest wait between re-arm attempts */
 
+/* ADC node: nRF SAADC on hardware, ADC emulator on native_sim */
+#if DT_NODE_HAS_STATUS(DT_NODELABEL(adc), okay)
 #define ADC_NODE DT_NODELABEL(adc)      /* Device tree node label for ADC */
+#else
+#define ADC_NODE DT_NODELABEL(adc0)     /* Device tree node label for the ADC emulator */
+#endif
 
 /* Error codes */
 #define ERR_OK 0        /* All fine */
 #define ERR_CONFIG -1   /* Configuration failure */
 
-/* Global vars */
-static uint16_t adc_sample_buffer[BUFFER_SIZE];
+/**
+ * \struct adc_scan_channel
+ * \brief One entry of the scan list.
+ *
+ * Entries must be listed in ascending channel_id order, which is the order
+ * in which the driver stores the results of a scan.
+ */
+struct adc_scan_channel
+{
+    uint8_t channel_id;     /**< ADC channel ID */
+    uint8_t input;          /**< Analog input (nRF AINx) */
+    uint8_t decimation;     /**< Publish one result every decimation blocks */
+};
+
+/**
+ * \struct adc_block
+ * \brief One block of consecutive scan frames produced by the streaming engine.
+ */
+struct adc_block
+{
+    uint32_t seq;                                               /**< Block sequence number, gaps reveal overruns */
+    uint32_t timestamp;                                         /**< k_cycle_get_32() when the last frame was taken */
+    int16_t samples[ADC_BLOCK_SAMPLES][ADC_SCAN_CHANNELS];      /**< Raw conversion results, oldest frame first */
+};
+
+/**
+ * \struct adc_channel_result
+ * \brief Latest published result of one channel.
+ */
+struct adc_channel_result
+{
+    int16_t raw;            /**< Filtered conversion result (counts) */
+    int32_t value;          /**< Converted value in milli-units (see conv.h) */
+    uint32_t timestamp;     /**< k_cycle_get_32() when the sample was taken */
+    uint32_t count;         /**< Results published so far */
+};
 
 /**
- * \brief Initializes ADC configuration and starts sampling.
+ * \struct adc_stream_stats
+ * \brief Counters kept by the streaming engine.
+ */
+struct adc_stream_stats
+{
+    uint32_t blocks;        /**< Blocks handed to the consumer */
+    uint32_t overruns;      /**< Blocks dropped because the consumer still owned every ring slot */
+    uint32_t restarts;      /**< Times the sequence was re-armed (interval changes or driver errors) */
+    uint32_t arm_failures;  /**< Re-arm attempts refused by the driver */
+};
+
+extern const struct adc_scan_channel adc_scan_list[ADC_SCAN_CHANNELS];  /**< Channels converted in every scan */
+extern struct adc_channel_result adc_results[ADC_SCAN_CHANNELS];         /**< Per-channel published results */
+
+/**
+ * \brief Binds the ADC device and configures every channel of the scan list.
  * \return ERR_OK if successful, ERR_CONFIG if configuration failed.
  */
-int adc_sample(void);
+int adc_stream_init(void);
+
+/**
+ * \brief Starts continuous sampling.
+ * \param interval_us Time between two consecutive samples (in us).
+ * \return ERR_OK if successful, negative value if the driver refused the sequence.
+ */
+int adc_stream_start(uint32_t interval_us);
+
+/**
+ * \brief Changes the sampling interval of a running stream.
+ *
+ * Safe to call from any context. The running sequence is finished at the next
+ * sample and re-armed with the new interval by the consumer in adc_stream_get().
+ *
+ * \param interval_us New time between two consecutive samples (in us).
+ */
+void adc_stream_set_interval(uint32_t interval_us);
+
+/**
+ * \brief Waits for the next full block.
+ *
+ * The returned block stays valid until adc_stream_release() is called; the
+ * engine keeps filling the other ring slots in the meantime.
+ *
+ * If re-arming the sequence fails, NULL is returned at once and the next
+ * call tries again after a backoff that doubles from ADC_ARM_BACKOFF_MIN_MS
+ * up to ADC_ARM_BACKOFF_MAX_MS.
+ *
+ * \param timeout Maximum time to wait for a block.
+ * \return Pointer to the oldest unread block, or NULL on timeout or if the sequence could not be re-armed.
+ */
+const struct adc_block *adc_stream_get(k_timeout_t timeout);
+
+/**
+ * \brief Returns the block obtained with adc_stream_get() to the engine.
+ */
+void adc_stream_release(void);
+
+/**
+ * \brief Publishes the results of a block into adc_results.
+ *
+ * Every filtered channel runs through its filter (filter.h) on each block.
+ * The latest output of each due channel is then stored raw and converted to
+ * engineering units. Channels whose decimation counter has not expired are
+ * not published, and an unfiltered slow channel costs nothing on the blocks
+ * where it is not due.
+ *
+ * \param blk Block obtained with adc_stream_get().
+ * \return Bitmask of the scan list entries that were updated.
+ */
+uint32_t adc_scan_publish(const struct adc_block *blk);
+
+/**
+ * \brief Returns the last raw conversion of a channel, without waiting for its block.
+ *
+ * Unfiltered and not decimated; for control loops that run faster than blocks.
+ *
+ * \param ch Scan list index.
+ * \return Raw conversion result.
+ */
+int16_t adc_latest(int ch);
+
+/**
+ * \brief Copies the engine counters.
+ * \param stats Destination of the counters.
+ */
+void adc_stream_get_stats(struct adc_stream_stats *stats);
+
+#if defined(CONFIG_ADC_EMUL)
+/**
+ * \brief Holds an emulated input at a fixed voltage.
+ * \param ch Scan list index.
+ * \param mv Input voltage (in mV), or a negative value to go back to the default ramp.
+ * \return 0 if successful, negative value otherwise.
+ */
+int adc_emul_inject(int ch, int32_t mv);
+#endif
 
-#endif /* ADC_H */
\ No newline at end of file
+#endif /* ADC_H */
@@ -0,0 +1,240 @@
+/**
+ * \file alarm.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Threshold, hysteresis and rate-of-change alarms on the ADC channels.
+ */
+
+#include "alarm.h"
+#include "conv.h"
+#include "threads.h"
+#include "hist.h"
+
+#define ALARM_RAW_MAX ((1 << ADC_RESOLUTION) - 1)
+#define ALARM_NO_REF INT16_MIN
+
+/* Alarm table, outputs in out_mask are driven by the alarms only */
+const struct alarm_cfg alarm_cfg[] = {
+    /* Potentiometer above 2.5 V for 50 ms: output 4 on */
+    { .ch = ADC_POT_CHANNEL, .type = ALARM_HIGH, .out_mask = BIT(3), .delay_ms = 50, .limit = 2500, .hyst = 200 },
+    /* NTC above 60 °C for 1 s: logged */
+    { .ch = 1, .type = ALARM_HIGH, .out_mask = 0, .delay_ms = 1000, .limit = 60000, .hyst = 2000 },
+    /* Potentiometer turned faster than 5 V/s: logged */
+    { .ch = ADC_POT_CHANNEL, .type = ALARM_RATE, .out_mask = 0, .delay_ms = 100, .limit = 5000, .hyst = 1000 },
+};
+const int alarm_count = ARRAY_SIZE(alarm_cfg);
+
+BUILD_ASSERT(ARRAY_SIZE(alarm_cfg) <= ALARM_MAX, "alarm_cfg has more than ALARM_MAX alarms");
+
+/*
+ * Precomputed state of one alarm. Level alarms compare key = sign * raw, so
+ * that the alarm side is always at high keys whatever the direction of the
+ * alarm and of the conversion.
+ */
+struct alarm_state
+{
+    int32_t trip;           /* Level: trips at key >= trip. Rate: at |change| >= trip counts */
+    int32_t clear;          /* Level: clears at key < clear. Rate: at |change| < clear counts */
+    int8_t sign;            /* +1 if the alarm side is at high raw counts, -1 otherwise */
+    uint32_t delay;         /* Frames the condition must hold (rate: frames per window) */
+    uint32_t cnt;           /* Frames the condition has held (rate: frames into the window) */
+    int16_t ref;            /* Rate: raw count at the start of the window, ALARM_NO_REF before the first */
+};
+
+static struct alarm_state alarm_state[ALARM_MAX];
+static uint8_t alarm_outputs;               /* Outputs owned by the alarms */
+static struct alarm_stats alarm_stats;
+
+/*
+ * Smallest sign * raw over every ADC code whose value is on the alarm side of
+ * bound (>= for a high alarm, <= for a low one), INT32_MAX if there is none.
+ */
+static int32_t alarm_key(int ch, int8_t sign, bool high, int32_t bound)
+{
+    int32_t key = INT32_MAX;
+    int32_t raw, v;
+
+    for(raw = 0; raw <= ALARM_RAW_MAX; raw++)
+    {
+        v = conv_apply(ch, raw);
+        if((high ? (v >= bound) : (v <= bound)) && sign * raw < key)
+        {
+            key = sign * raw;
+        }
+    }
+    return key;
+}
+
+int alarm_init(void)
+{
+    const struct alarm_cfg *cfg;
+    struct alarm_state *st;
+    bool increasing, high;
+    int i;
+
+    alarm_outputs = 0;
+    for(i = 0; i < alarm_count; i++)
+    {
+        cfg = &alarm_cfg[i];
+        st = &alarm_state[i];
+        if(cfg->ch >= ADC_SCAN_CHANNELS || cfg->type > ALARM_RATE || cfg->hyst < 0 ||
+           (cfg->type == ALARM_RATE && cfg->hyst >= cfg->limit) || (cfg->out_mask & ~BIT_MASK(NUM_OUTPUTS)))
+        {
+            printk("alarm %d: invalid settings\n\r", i);
+            return -EINVAL;
+        }
+        alarm_outputs |= cfg->out_mask;
+        st->cnt = 0;
+        if(cfg->type == ALARM_RATE)
+        {
+            continue;
+        }
+
+        /* Thresholds of the value, as raw counts: the conversion is monotonic but may decrease (NTC) */
+        increasing = conv_apply(cfg->ch, ALARM_RAW_MAX) >= conv_apply(cfg->ch, 0);
+        high = (cfg->type == ALARM_HIGH);
+        st->sign = (high == increasing) ? 1 : -1;
+        st->trip = alarm_key(cfg->ch, st->sign, high, cfg->limit);
+        st->clear = alarm_key(cfg->ch, st->sign, high, high ? cfg->limit - cfg->hyst : cfg->limit + cfg->hyst);
+    }
+    return 0;
+}
+
+void alarm_set_interval(uint32_t interval_us)
+{
+    const struct alarm_cfg *cfg;
+    struct alarm_state *st;
+    int64_t span, window_us;
+    int i;
+
+    for(i = 0; i < alarm_count; i++)
+    {
+        cfg = &alarm_cfg[i];
+        st = &alarm_state[i];
+        st->delay = MAX(1, (uint32_t)cfg->delay_ms * 1000 / MAX(interval_us, 1));
+        st->cnt = 0;
+        st->ref = ALARM_NO_REF;
+        if(cfg->type != ALARM_RATE)
+        {
+            continue;
+        }
+
+        /* Change over one window, in counts, at the average slope of the conversion */
+        span = conv_apply(cfg->ch, ALARM_RAW_MAX) - conv_apply(cfg->ch, 0);
+        span = (span < 0) ? -span : span;
+        window_us = (int64_t)st->delay * interval_us;
+        if(span == 0)
+        {
+            st->trip = INT32_MAX;
+            st->clear = INT32_MAX;
+            continue;
+        }
+        st->trip = (int32_t)DIV_ROUND_UP((int64_t)cfg->limit * window_us * ALARM_RAW_MAX, span * 1000000);
+        st->clear = (int32_t)DIV_ROUND_UP((int64_t)MAX(cfg->limit - cfg->hyst, 0) * window_us * ALARM_RAW_MAX,
+                                          span * 1000000);
+    }
+}
+
+/*
+ * Records a trip or clear and rewrites the outputs owned by the alarms.
+ */
+static void alarm_change(int i, bool active)
+{
+    uint32_t out = 0;
+    int k;
+
+    if(active)
+    {
+        alarm_stats.active |= BIT(i);
+        alarm_stats.trips++;
+    }
+    else
+    {
+        alarm_stats.active &= ~BIT(i);
+        alarm_stats.clears++;
+    }
+    hist_log(HIST_ALARM, i, active);
+
+    if(alarm_cfg[i].out_mask == 0)
+    {
+        return;
+    }
+    for(k = 0; k < alarm_count; k++)
+    {
+        if(alarm_stats.active & BIT(k))
+        {
+            out |= alarm_cfg[k].out_mask;
+        }
+    }
+    if(outputs_request(OUTPUT_OP_WRITE, alarm_outputs, out) != 0)
+    {
+        alarm_stats.out_errors++;
+    }
+}
+
+void alarm_eval(const int16_t *frame)
+{
+    struct alarm_state *st;
+    bool active;
+    int32_t raw, d;
+    int i;
+
+    for(i = 0; i < alarm_count; i++)
+    {
+        st = &alarm_state[i];
+        raw = frame[alarm_cfg[i].ch];
+        active = (alarm_stats.active & BIT(i)) != 0;
+
+        if(alarm_cfg[i].type == ALARM_RATE)
+        {
+            if(++st->cnt < st->delay)
+            {
+                continue;
+            }
+            d = raw - st->ref;
+            d = (d < 0) ? -d : d;
+            if(st->ref == ALARM_NO_REF)
+            {
+                d = 0;
+            }
+            st->ref = (int16_t)raw;
+            st->cnt = 0;
+            if(!active && d >= st->trip)
+            {
+                alarm_change(i, true);
+            }
+            else if(active && d < st->clear)
+            {
+                alarm_change(i, false);
+            }
+            continue;
+        }
+
+        raw *= st->sign;
+        if(active)
+        {
+            /* The hysteresis band does the debouncing on the way back */
+            if(raw < st->clear)
+            {
+                alarm_change(i, false);
+            }
+        }
+        else if(raw >= st->trip)
+        {
+            if(++st->cnt >= st->delay)
+            {
+                st->cnt = 0;
+                alarm_change(i, true);
+            }
+        }
+        else
+        {
+            st->cnt = 0;
+        }
+    }
+}
+
+void alarm_get_stats(struct alarm_stats *stats)
+{
+    *stats = alarm_stats;
+}
@@ -0,0 +1,98 @@
+/**
+ * \file alarm.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Threshold, hysteresis and rate-of-change alarms on the ADC channels.
+ *
+ * Alarms are listed in alarm_cfg with limits in the engineering units of
+ * their channel (conv.h). alarm_init() turns every limit into a raw count
+ * threshold once, by running the channel conversion over all the ADC codes,
+ * so evaluation is one compare per alarm and never converts a sample.
+ *
+ * alarm_eval() runs in the ADC sequence callback on every scan frame,
+ * before the frame goes into a block. An alarm trips after its condition
+ * held for delay_ms and clears once the value is back past the hysteresis
+ * band. Every trip and clear rewrites the outputs owned by the alarms
+ * (outputs_request()), so the outputs follow the inputs one sample period
+ * later plus the outputs thread wake-up, and is logged in the historian.
+ */
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include "adc.h"
+
+#define ALARM_MAX 8                     /* Alarms in alarm_cfg */
+
+/**
+ * \brief Alarm conditions.
+ */
+enum alarm_type
+{
+    ALARM_HIGH = 0,         /**< value >= limit, clears below limit - hyst */
+    ALARM_LOW,              /**< value <= limit, clears above limit + hyst */
+    ALARM_RATE,             /**< |change| over delay_ms >= limit per second, clears below (limit - hyst) per second */
+};
+
+/**
+ * \struct alarm_cfg
+ * \brief Settings of one alarm.
+ */
+struct alarm_cfg
+{
+    uint8_t ch;             /**< Scan list index */
+    uint8_t type;           /**< Condition (enum alarm_type) */
+    uint8_t out_mask;       /**< Outputs turned on while active (bit i = output i+1), 0 for none */
+    uint16_t delay_ms;      /**< Time the condition must hold (ALARM_RATE: window the change is measured over) */
+    int32_t limit;          /**< Limit in milli-units (ALARM_RATE: milli-units per second) */
+    int32_t hyst;           /**< Hysteresis band in milli-units (ALARM_RATE: milli-units per second) */
+};
+
+/**
+ * \struct alarm_stats
+ * \brief Counters of the alarm engine.
+ */
+struct alarm_stats
+{
+    uint32_t active;        /**< Alarms active now (bit i = alarm_cfg[i]) */
+    uint32_t trips;         /**< Alarms tripped */
+    uint32_t clears;        /**< Alarms cleared */
+    uint32_t out_errors;    /**< Output rewrites lost because the outputs queue was full */
+};
+
+extern const struct alarm_cfg alarm_cfg[];      /**< Alarm table */
+extern const int alarm_count;                   /**< Entries in alarm_cfg */
+
+/**
+ * \brief Computes the raw count thresholds of every alarm.
+ *
+ * Call after conv_init(), with the ADC sequence stopped.
+ *
+ * \return 0 if successful, -EINVAL if alarm_cfg has an invalid entry.
+ */
+int alarm_init(void);
+
+/**
+ * \brief Converts the delays and rate limits to the sampling interval.
+ *
+ * Call with the ADC sequence stopped, whenever it is (re)armed.
+ *
+ * \param interval_us Time between two scan frames (in us).
+ */
+void alarm_set_interval(uint32_t interval_us);
+
+/**
+ * \brief Evaluates every alarm on one scan frame. Runs in the ADC callback.
+ * \param frame Raw results of the scan, one per scan list entry.
+ */
+void alarm_eval(const int16_t *frame);
+
+/**
+ * \brief Copies the alarm counters.
+ * \param stats Destination of the counters.
+ */
+void alarm_get_stats(struct alarm_stats *stats);
+
+#endif /* ALARM_H */
@@ -0,0 +1,515 @@
+/**
+ * \file bench.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief On-target micro-benchmarks of the hot paths.
+ */
+
+#include <zephyr/sys/byteorder.h>
+#include "bench.h"
+#include "latency.h"
+#include "adc.h"
+#include "conv.h"
+#include "filter.h"
+#include "uart.h"
+#include "hist.h"
+#include "codec.h"
+#include "db.h"
+#include "IO.h"
+#include "ui.h"
+#include "plc.h"
+#include "threads.h"
+
+static struct k_work bench_work;
+static uint32_t bench_runs[BENCH_ITERATIONS];
+static int bench_over;                          /* Budgets exceeded in this run */
+
+static struct adc_block bench_block;            /* Synthetic ADC block used as input */
+static int32_t bench_out[ADC_BLOCK_SAMPLES];
+static volatile float bench_sink;
+static int32_t bench_trace[ADC_BLOCK_SAMPLES * ADC_SCAN_CHANNELS];     /* Pot trace, one column per channel */
+static int32_t bench_trace_out[ADC_BLOCK_SAMPLES * ADC_SCAN_CHANNELS];
+static uint8_t bench_packed[CODEC_BOUND(ADC_BLOCK_SAMPLES * ADC_SCAN_CHANNELS)];
+static uint8_t bench_plc_code[PLC_MAX_CODE];
+static struct plc_prog bench_plc_prog;
+static int32_t bench_db_value;                  /* Value db_write stores, the current one */
+static struct sched_stats bench_sched_stats;    /* Job timing shown by the ui_row case */
+
+/*
+ * Insertion sort, BENCH_ITERATIONS is small.
+ */
+void bench_sort(uint32_t *v, int n)
+{
+    int i, j;
+    uint32_t x;
+
+    for(i = 1; i < n; i++)
+    {
+        x = v[i];
+        for(j = i; j > 0 && v[j - 1] > x; j--)
+        {
+            v[j] = v[j - 1];
+        }
+        v[j] = x;
+    }
+}
+
+/*
+ * Budget of a benchmark scaled to the timing counter clock, 0 if it has none.
+ * Never below one count, so the budget still applies on a slow counter.
+ */
+static uint32_t bench_budget(const char *name)
+{
+    int i;
+
+    for(i = 0; i < BENCH_NUM_CASES; i++)
+    {
+        if(bench_cases[i].cycles != 0 && strcmp(bench_cases[i].name, name) == 0)
+        {
+            return MAX(1, (uint32_t)((uint64_t)bench_cases[i].cycles * timing_freq_get_mhz() / BENCH_BUDGET_MHZ));
+        }
+    }
+    return 0;
+}
+
+int bench_measure(const char *name, void (*fn)(void *arg), void *arg, uint32_t units,
+                  struct bench_result *res)
+{
+    struct bench_result r;
+    timing_t start, end;
+    int i;
+
+    for(i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        start = timing_counter_get();
+        fn(arg);
+        end = timing_counter_get();
+        bench_runs[i] = (uint32_t)(timing_cycles_get(&start, &end) / units);
+    }
+
+    bench_sort(bench_runs, BENCH_ITERATIONS);
+    r.min = bench_runs[0];
+    r.median = bench_runs[BENCH_ITERATIONS / 2];
+    r.max = bench_runs[BENCH_ITERATIONS - 1];
+    r.budget = bench_budget(name);
+
+    if(r.budget == 0)
+    {
+        printk("bench %-16s min %6u  median %6u  max %6u cycles\n\r", name, r.min, r.median, r.max);
+    }
+    else
+    {
+        printk("bench %-16s min %6u  median %6u  max %6u cycles, budget %6u %s\n\r", name, r.min,
+               r.median, r.max, r.budget, (r.median > r.budget) ? "OVER" : "ok");
+    }
+    if(res != NULL)
+    {
+        *res = r;
+    }
+
+    if(r.budget != 0 && r.median > r.budget)
+    {
+        bench_over++;
+        return -ERANGE;
+    }
+    return 0;
+}
+
+/*
+ * Fixed-point conversion of one channel of a block.
+ */
+static void bench_conv_fixed(void *arg)
+{
+    conv_block((int)(intptr_t)arg, &bench_block, bench_out);
+}
+
+/*
+ * The float conversion used before the fixed-point stage, for reference
+ * (accuracy is checked by tests/bench).
+ */
+static void bench_conv_float(void *arg)
+{
+    int i;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        bench_sink = 1000*bench_block.samples[i][ADC_POT_CHANNEL]*((float)3/1023);
+    }
+}
+
+void bench_cmd_parse(void *arg)
+{
+    struct cmd_call call;
+
+    cmd_parse((const char *)arg, strlen((const char *)arg), &call);
+}
+
+/*
+ * Database snapshot read and one full write section, as the threads do them.
+ */
+static void bench_db_read(void *arg)
+{
+    struct db_snapshot snap;
+
+    db_read(&snap);
+    bench_sink = db_snap_value(&snap, TAG_ADC(ADC_POT_CHANNEL));
+}
+
+static void bench_db_write(void *arg)
+{
+    k_spinlock_key_t key;
+
+    key = db_write_begin();
+    db_set(TAG_ADC(ADC_POT_CHANNEL), bench_db_value);
+    db_write_end(key);
+}
+
+/*
+ * Change scan over every tag, as a poller catching up from the start.
+ */
+static void bench_db_changed(void *arg)
+{
+    static uint16_t ids[DB_NUM_TAGS];
+    enum db_tag next;
+
+    bench_sink = db_changed(0, 0, ids, DB_NUM_TAGS, &next);
+}
+
+/*
+ * The longest UI row, the task timing one, through the formatting and
+ * change detection of the renderer.
+ */
+static void bench_ui_row(void *arg)
+{
+    static char line[UI_COLS];
+    static char shown[UI_COLS];
+
+    print_task_row(line, sizeof(line), &tasks[TASK_TELEM], &bench_sched_stats);
+    ui_row_update(shown, "%s", line);
+}
+
+/*
+ * Writing the current output image again: same port writes as a change, no
+ * visible effect. The outputs thread may interleave, it writes the same image.
+ */
+static void bench_outputs_apply(void *arg)
+{
+    outputs_apply(outputs_image_get());
+}
+
+/*
+ * One scan of the program built by bench_cases_prepare().
+ */
+static void bench_plc_scan(void *arg)
+{
+    plc_run(&bench_plc_prog);
+}
+
+/*
+ * Budgets are medians in cycles per unit at BENCH_BUDGET_MHZ; cases with no
+ * budget are only reported. Commands are taken at both ends of the command
+ * table, with and without arguments: all should cost about the same.
+ */
+struct bench_case bench_cases[] = {
+    { "conv_float", bench_conv_float, NULL, ADC_BLOCK_SAMPLES, 0 },
+    { "conv_fixed", bench_conv_fixed, (void *)ADC_POT_CHANNEL, ADC_BLOCK_SAMPLES, 40 },
+    { "conv_fixed_lut", bench_conv_fixed, (void *)1, ADC_BLOCK_SAMPLES, 80 },  /* Channel 1 has the NTC table */
+    { "cmd_fu", bench_cmd_parse, "/fu10", 1, 1200 },
+    { "cmd_a", bench_cmd_parse, "/a", 1, 600 },
+    { "cmd_o", bench_cmd_parse, "/o3_1", 1, 800 },
+    { "cmd_ow", bench_cmd_parse, "/owf", 1, 800 },
+    { "cmd_unknown", bench_cmd_parse, "/zz", 1, 600 },
+    { "db_read", bench_db_read, NULL, 1, 120 },
+    { "db_write", bench_db_write, NULL, 1, 120 },
+    { "db_changed", bench_db_changed, NULL, DB_NUM_TAGS, 20 },
+    { "ui_row", bench_ui_row, NULL, 1, 12000 },
+    { "outputs_apply", bench_outputs_apply, NULL, 1, 400 },
+    { "plc_scan", bench_plc_scan, NULL, 0, 40 },   /* Units: instructions of the program */
+};
+
+BUILD_ASSERT(ARRAY_SIZE(bench_cases) == BENCH_NUM_CASES, "BENCH_NUM_CASES must match bench_cases[]");
+
+/*
+ * Program of interlock rungs, "button and pot above 1.5 V for 100 ms sets a
+ * marker", up to PLC_MAX_INSNS. Returns its instructions, 0 if it cannot be
+ * scanned now.
+ */
+static uint32_t bench_plc_prepare(void)
+{
+    static const uint8_t rung[] = {
+        PLC_LD_IN, 0, PLC_LD_ADC, 0, PLC_PUSH, 0xDC, 0x05, 0x00, 0x00, PLC_GT, PLC_AND,
+        PLC_TON, 0, 100, 0, PLC_ST_M, 0,
+    };
+    struct plc_stats st;
+    size_t len = 0;
+    int k;
+
+    /* The program state is shared with the scan */
+    plc_get_stats(&st);
+    if(st.insns != 0)
+    {
+        printk("bench plc_scan: skipped, a program is loaded\n\r");
+        return 0;
+    }
+    for(k = 0; (k + 1) * 7 < PLC_MAX_INSNS; k++)
+    {
+        memcpy(&bench_plc_code[len], rung, sizeof(rung));
+        bench_plc_code[len + 1] = k % NUM_BUTTONS;
+        bench_plc_code[len + 12] = k % PLC_TIMERS;
+        bench_plc_code[len + 16] = k % PLC_MARKERS;
+        len += sizeof(rung);
+    }
+    bench_plc_code[len++] = PLC_END;
+    if(plc_compile(bench_plc_code, len, &bench_plc_prog) != 0)
+    {
+        printk("bench plc_scan: program rejected\n\r");
+        return 0;
+    }
+    return bench_plc_prog.len;
+}
+
+void bench_cases_prepare(void)
+{
+    struct bench_case *plc = bench_case_find("plc_scan");
+    int i, ch;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+        {
+            bench_block.samples[i][ch] = (int16_t)((i * 37) & ((1 << ADC_RESOLUTION) - 1));
+        }
+    }
+
+    /* db_write stores the current value again: a full section, no change recorded */
+    bench_db_value = db_value(TAG_ADC(ADC_POT_CHANNEL));
+
+    /* A busy task with wide timing, so every field of the row has several digits */
+    memset(&bench_sched_stats, 0, sizeof(bench_sched_stats));
+    bench_sched_stats.jobs = 123456;
+    bench_sched_stats.jitter_min = k_us_to_cyc_floor32(3);
+    bench_sched_stats.jitter_max = k_us_to_cyc_floor32(812);
+    bench_sched_stats.jitter_sum = (uint64_t)k_us_to_cyc_floor32(57) * bench_sched_stats.jobs;
+    bench_sched_stats.resp_min = k_us_to_cyc_floor32(40);
+    bench_sched_stats.resp_max = k_us_to_cyc_floor32(1390);
+    bench_sched_stats.resp_sum = (uint64_t)k_us_to_cyc_floor32(95) * bench_sched_stats.jobs;
+    bench_sched_stats.exec_min = 2000;
+    bench_sched_stats.exec_max = 25000;
+    bench_sched_stats.exec_sum = 3300ULL * bench_sched_stats.jobs;
+
+    plc->units = bench_plc_prepare();
+}
+
+struct bench_case *bench_case_find(const char *name)
+{
+    int i;
+
+    for(i = 0; i < BENCH_NUM_CASES; i++)
+    {
+        if(strcmp(bench_cases[i].name, name) == 0)
+        {
+            return &bench_cases[i];
+        }
+    }
+    return NULL;
+}
+
+int bench_run(const struct bench_case *c, struct bench_result *res)
+{
+    if(c->units == 0)
+    {
+        return -EAGAIN;
+    }
+    return bench_measure(c->name, c->fn, c->arg, c->units, res);
+}
+
+/*
+ * Cycles per input sample of every filter type on a noisy ramp.
+ */
+static void bench_filter_run(void *arg)
+{
+    int16_t out[ADC_BLOCK_SAMPLES];
+
+    filter_run((struct filter *)arg, (const int16_t *)bench_out, out);
+}
+
+static void bench_filter(void)
+{
+    static const struct {
+        const char *name;
+        struct filter_cfg cfg;
+    } cases[] = {
+        { "filter_avg16", { FILTER_MOVING_AVG, 16 } },
+        { "filter_median5", { FILTER_MEDIAN, 5 } },
+        { "filter_biquad", { FILTER_BIQUAD, 0 } },
+        { "filter_fir_dec4", { FILTER_FIR_DECIM, 4 } },
+        { "filter_cic8", { FILTER_CIC, 8 } },
+    };
+    static struct filter f;
+    int16_t *in = (int16_t *)bench_out;     /* Reuse the conversion output buffer as input */
+    int i;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        in[i] = (int16_t)(512 + i * 8 + ((i * 7919) & 31) - 16);
+    }
+
+    for(i = 0; i < ARRAY_SIZE(cases); i++)
+    {
+        if(filter_init(&f, &cases[i].cfg) == 0)
+        {
+            bench_measure(cases[i].name, bench_filter_run, &f, ADC_BLOCK_SAMPLES, NULL);
+        }
+    }
+}
+
+/*
+ * Potentiometer trace in raw counts: held still, then turned slowly up and
+ * back, with +-2 LSB of conversion noise throughout.
+ */
+static void bench_pot_trace(int32_t *v, int n)
+{
+    uint32_t lfsr = 0xACE1;
+    int i, pos;
+
+    for(i = 0; i < n; i++)
+    {
+        lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+        pos = i % 256;
+        pos = (pos < 64) ? 0 : (pos < 160) ? (pos - 64) * 6 : (256 - pos) * 6;
+        v[i] = 300 + pos + (int32_t)(lfsr % 5) - 2;
+    }
+}
+
+/*
+ * Compression ratio and cycles per block of the block codec on one ADC
+ * block of pot traces (one column per channel), and the channels at
+ * 1 kHz that fit on the 115200 baud link with and without it.
+ */
+static void bench_codec_encode(void *arg)
+{
+    codec_encode(bench_trace, ARRAY_SIZE(bench_trace), (uint8_t)(uintptr_t)arg, bench_packed,
+                 sizeof(bench_packed));
+}
+
+static void bench_codec_decode(void *arg)
+{
+    codec_decode(bench_packed, sizeof(bench_packed), bench_trace_out, ARRAY_SIZE(bench_trace_out));
+}
+
+static void bench_codec(void)
+{
+    const uint32_t link = UART_BAUDRATE / 10;                   /* Bytes per second */
+    const uint32_t raw = sizeof(int16_t) * ARRAY_SIZE(bench_trace);
+    static const struct {
+        const char *name;
+        uint8_t flags;
+    } cases[] = {
+        { "codec_varint", 0 },
+        { "codec_lz4", CODEC_LZ4 },
+    };
+    int i, n;
+
+    bench_pot_trace(bench_trace, ARRAY_SIZE(bench_trace));
+    for(i = 0; i < ARRAY_SIZE(cases); i++)
+    {
+        n = codec_encode(bench_trace, ARRAY_SIZE(bench_trace), cases[i].flags, bench_packed,
+                         sizeof(bench_packed));
+        if(n <= 0)
+        {
+            continue;
+        }
+        printk("bench %s: %u -> %d bytes, ratio %u.%02u, %u channels at 1 kHz (raw: %u)%s\n\r",
+               cases[i].name, raw, n, raw / n, (raw * 100 / n) % 100,
+               link * (uint32_t)ARRAY_SIZE(bench_trace) / (1000 * n), link / (uint32_t)(sizeof(int16_t) * 1000),
+               ((cases[i].flags & CODEC_LZ4) && !(bench_packed[0] & CODEC_LZ4)) ? ", LZ4 not kept" : "");
+        bench_measure(cases[i].name, bench_codec_encode, (void *)(uintptr_t)cases[i].flags, 1, NULL);
+    }
+    bench_measure("codec_decode", bench_codec_decode, NULL, 1, NULL);
+}
+
+/*
+ * Sustained flash write rate and wear of the historian, on a scratch FCB
+ * (hist_scratch_open()) erased afterwards: the history is left alone.
+ * Writes BENCH_ITERATIONS full synthetic blocks, each with a complete
+ * header and its own sequence number.
+ */
+static void bench_hist_write(void *arg)
+{
+    uint8_t *blk = arg;
+
+    sys_put_le32(sys_get_le32(&blk[4]) + 1, &blk[4]);
+    hist_scratch_write(blk);
+}
+
+static void bench_hist(void)
+{
+    static uint8_t blk[HIST_BLOCK_SIZE];
+    struct hist_stats st;
+    struct bench_result res;
+    uint32_t ms = 0;
+    int i, rc;
+
+    /* ADC records of the four channels every 32 ms, values from the pot trace */
+    bench_pot_trace(bench_trace, ARRAY_SIZE(bench_trace));
+    for(i = 0; i < HIST_BLOCK_RECORDS; i++)
+    {
+        uint8_t *rec = &blk[HIST_HEADER_SIZE + i * HIST_RECORD_SIZE];
+
+        ms = 1000 + (i / ADC_SCAN_CHANNELS) * 32;
+        sys_put_le32(ms, &rec[0]);
+        rec[4] = HIST_ADC;
+        rec[5] = i % ADC_SCAN_CHANNELS;
+        sys_put_le16((uint16_t)bench_trace[i], &rec[6]);
+    }
+    sys_put_le16(0, &blk[0]);
+    blk[2] = HIST_BLOCK_RECORDS;
+    blk[3] = 0;
+    sys_put_le32(0, &blk[4]);
+    sys_put_le32(1000, &blk[8]);
+    sys_put_le32(ms, &blk[12]);
+
+    rc = hist_scratch_open();
+    if(rc != 0)
+    {
+        printk("bench hist: no scratch partition (%d)\n\r", rc);
+        return;
+    }
+    bench_measure("hist_block", bench_hist_write, blk, 1, &res);
+    hist_scratch_close(&st);
+
+    printk("bench hist: %u B/s sustained (median), %u erases for %u blocks on %u sectors, %u write errors\n\r",
+           (uint32_t)((uint64_t)HIST_BLOCK_SIZE * timing_freq_get_mhz() * 1000000 / MAX(res.median, 1)),
+           st.erases, st.blocks, st.sectors, st.write_errors);
+}
+
+static void bench_work_handler(struct k_work *work)
+{
+    int i;
+
+    printk("\n\rbench: %u cycles/us, %d runs per benchmark, results per sample (per call for cmd_, db_, ui_ and outputs_, per tag for db_changed, per instruction for plc_, per block for codec_ and hist_)\n\r",
+           timing_freq_get_mhz(), BENCH_ITERATIONS);
+    bench_over = 0;
+    bench_cases_prepare();
+    for(i = 0; i < BENCH_NUM_CASES; i++)
+    {
+        bench_run(&bench_cases[i], NULL);
+    }
+    bench_filter();
+    bench_codec();
+    bench_hist();
+    printk("bench: done, %s (%d over budget)\n\r", bench_over ? "FAIL" : "PASS", bench_over);
+}
+
+void bench_init()
+{
+    timing_init();
+    timing_start();
+    k_work_init(&bench_work, bench_work_handler);
+    latency_init();
+}
+
+void bench_request()
+{
+    k_work_submit(&bench_work);
+}
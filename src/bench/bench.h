@@ -0,0 +1,122 @@
+/**
+ * \file bench.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief On-target micro-benchmarks of the hot paths.
+ *
+ * Benchmarks run on the system work queue when requested with the /m
+ * command and print their results on the console. Each one times a function
+ * BENCH_ITERATIONS times with the timing API and reports the min, median and
+ * max cycle counts.
+ *
+ * The hot paths are the cases of bench_cases[], run in turn by /m and by
+ * the ztest app, and most have a cycle budget. A benchmark whose median goes
+ * over its budget is flagged OVER, and the run ends with the number of budgets
+ * exceeded, so a change that slows a hot path down shows up as a failure
+ * rather than as a number to compare by eye. Budgets are set in cycles of
+ * the nRF52840 at BENCH_BUDGET_MHZ and scaled to the clock of the timing
+ * counter on other targets. The ztest app in tests/bench checks the same
+ * budgets under twister (native_sim, qemu_cortex_m3).
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/timing/timing.h>
+#include <stdint.h>
+
+#define BENCH_ITERATIONS 101        /* Timed runs per benchmark (odd, for a true median) */
+#define BENCH_BUDGET_MHZ 64         /* Clock the budgets are written for */
+#define BENCH_NUM_CASES 14          /* Entries of bench_cases[] */
+
+/**
+ * \struct bench_result
+ * \brief Cycle statistics of one benchmark.
+ */
+struct bench_result
+{
+    uint32_t min;       /**< Fastest run (cycles per unit) */
+    uint32_t median;    /**< Median run (cycles per unit) */
+    uint32_t max;       /**< Slowest run (cycles per unit) */
+    uint32_t budget;    /**< Budget of the median (cycles per unit), 0 if none */
+};
+
+/**
+ * \struct bench_case
+ * \brief One timed hot path, as given to bench_measure().
+ */
+struct bench_case
+{
+    const char *name;           /**< Name printed with the results */
+    void (*fn)(void *arg);      /**< Function under test */
+    void *arg;                  /**< Argument passed to fn */
+    uint32_t units;             /**< Work units done by one call, 0 while the case cannot run */
+    uint32_t cycles;            /**< Budget of the median, cycles per unit at BENCH_BUDGET_MHZ; 0 if none */
+};
+
+extern struct bench_case bench_cases[BENCH_NUM_CASES];     /**< Hot paths, in the order /m runs them */
+
+/**
+ * \brief Times a function.
+ *
+ * \param name Name printed with the results.
+ * \param fn Function under test, called once per run.
+ * \param arg Argument passed to fn.
+ * \param units Work units done by one call (e.g. samples per block); results are per unit.
+ * \param res Destination of the statistics, may be NULL.
+ * \return 0 if the median is within the budget of name (or it has none), -ERANGE otherwise.
+ */
+int bench_measure(const char *name, void (*fn)(void *arg), void *arg, uint32_t units,
+                  struct bench_result *res);
+
+/**
+ * \brief Builds the inputs of bench_cases[]: ADC block, PLC program, current tag values.
+ *
+ * Called before running the cases. The PLC case is left with no units, and
+ * cannot run, while a PLC program is loaded.
+ */
+void bench_cases_prepare(void);
+
+/**
+ * \brief Finds a case of bench_cases[].
+ * \param name Name of the case.
+ * \return The case, NULL if there is none with that name.
+ */
+struct bench_case *bench_case_find(const char *name);
+
+/**
+ * \brief Times one case with bench_measure().
+ * \param c Case to time, prepared by bench_cases_prepare().
+ * \param res Destination of the statistics, may be NULL.
+ * \return As bench_measure(), -EAGAIN if the case cannot run now.
+ */
+int bench_run(const struct bench_case *c, struct bench_result *res);
+
+/**
+ * \brief Parses a command with cmd_parse(), the function of the cmd_ cases.
+ * \param arg Command text, null terminated.
+ */
+void bench_cmd_parse(void *arg);
+
+/**
+ * \brief Sorts values in ascending order (insertion sort, for short arrays).
+ * \param v Values to sort.
+ * \param n Number of values.
+ */
+void bench_sort(uint32_t *v, int n);
+
+/**
+ * \brief Starts the timing counters used by the benchmarks.
+ */
+void bench_init(void);
+
+/**
+ * \brief Queues a run of every benchmark on the system work queue.
+ *
+ * Safe to call from interrupt context.
+ */
+void bench_request(void);
+
+#endif /* BENCH_H */
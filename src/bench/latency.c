@@ -0,0 +1,392 @@
+/**
+ * \file latency.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief End-to-end latency benchmarks.
+ */
+
+#include <string.h>
+#include "latency.h"
+#include "bench.h"
+#include "IO.h"
+#include "adc.h"
+#include "uart.h"
+#include "threads.h"
+#include "db.h"
+
+#if defined(CONFIG_GPIO_EMUL)
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#endif
+
+static struct k_work latency_work;
+
+/* One-shot probes: armed by the benchmark, fired by the application */
+static atomic_t lat_armed;
+static uint32_t lat_time[NUM_LAT_POINTS];
+static uint32_t lat_origin[NUM_LAT_POINTS];
+static struct k_sem lat_sem[NUM_LAT_POINTS];
+
+static uint32_t lat_us[LAT_RUNS];
+
+void lat_probe(enum lat_point p, uint32_t origin)
+{
+    if(!(atomic_get(&lat_armed) & BIT(p)))
+    {
+        return;
+    }
+    lat_time[p] = k_cycle_get_32();
+    lat_origin[p] = origin;
+    atomic_and(&lat_armed, ~BIT(p));
+    k_sem_give(&lat_sem[p]);
+}
+
+static void lat_arm(enum lat_point p)
+{
+    k_sem_reset(&lat_sem[p]);
+    atomic_or(&lat_armed, BIT(p));
+}
+
+/*
+ * Waits for an armed probe. Returns 0 if it fired, -EAGAIN on timeout.
+ */
+static int lat_wait(enum lat_point p)
+{
+    if(k_sem_take(&lat_sem[p], K_MSEC(LAT_TIMEOUT_MS)) != 0)
+    {
+        atomic_and(&lat_armed, ~BIT(p));
+        return -EAGAIN;
+    }
+    return 0;
+}
+
+/*
+ * Statistics of the n latencies in lat_us.
+ */
+static void lat_stats(struct lat_result *res, int n, uint32_t dropped, uint32_t errors)
+{
+    memset(res, 0, sizeof(*res));
+    res->runs = n;
+    res->dropped = dropped;
+    res->errors = errors;
+    if(n == 0)
+    {
+        return;
+    }
+
+    bench_sort(lat_us, n);
+    res->min_us = lat_us[0];
+    res->p50_us = lat_us[n / 2];
+    res->p99_us = lat_us[(n * 99) / 100];
+    res->max_us = lat_us[n - 1];
+}
+
+/*
+ * Prints a result as one JSON line.
+ */
+static void lat_report(const char *name, const struct lat_result *res)
+{
+    if(res->runs == 0)
+    {
+        printk("{\"bench\":\"%s\",\"runs\":0,\"dropped\":%u}\n\r", name, res->dropped);
+    }
+    else
+    {
+        printk("{\"bench\":\"%s\",\"runs\":%u,\"min_us\":%u,\"p50_us\":%u,\"p99_us\":%u,\"max_us\":%u,\"dropped\":%u}\n\r",
+               name, res->runs, res->min_us, res->p50_us, res->p99_us, res->max_us, res->dropped);
+    }
+    if(res->errors)
+    {
+        printk("{\"bench\":\"%s_errors\",\"errors\":%u}\n\r", name, res->errors);
+    }
+}
+
+#if defined(CONFIG_GPIO_EMUL)
+/*
+ * Drives a button pin of the emulator to its pressed or released level.
+ */
+static void lat_button_set(int i, bool pressed)
+{
+    const struct gpio_dt_spec *sw = &buttons_pins[i];
+    bool active_low = (sw->dt_flags & GPIO_ACTIVE_LOW) != 0;
+
+    gpio_emul_input_set(sw->port, sw->pin, pressed ^ active_low);
+}
+
+/*
+ * Button edge to database, one edge per debounce window.
+ */
+static void lat_edge_to_db(struct lat_result *res)
+{
+    uint32_t dropped = 0;
+    uint32_t t0;
+    int n = 0;
+    int i;
+
+    for(i = 0; i < LAT_RUNS; i++)
+    {
+        k_msleep(button_debounce_get() / 1000 + 2);
+        lat_arm(LAT_BUTTON_DB);
+        t0 = k_cycle_get_32();
+        lat_button_set(0, (i & 1) == 0);
+        if(lat_wait(LAT_BUTTON_DB) != 0)
+        {
+            dropped++;
+            continue;
+        }
+        lat_us[n++] = k_cyc_to_us_floor32(lat_time[LAT_BUTTON_DB] - t0);
+    }
+    lat_button_set(0, false);
+    lat_stats(res, n, dropped, 0);
+}
+
+/*
+ * Edges 20 us apart with a 1 us debounce window: how many become events and how many are lost.
+ */
+static void lat_button_burst(void)
+{
+    struct button_stats before, after;
+    uint32_t debounce = button_debounce_get();
+    int i;
+
+    k_msleep(debounce / 1000 + 2);
+    button_debounce_set(1);
+    button_get_stats(&before);
+    for(i = 0; i < LAT_BURST; i++)
+    {
+        lat_button_set(3, (i & 1) == 0);
+        k_busy_wait(20);
+    }
+    lat_button_set(3, false);
+    k_msleep(LAT_TIMEOUT_MS);
+    button_get_stats(&after);
+    button_debounce_set(debounce);
+
+    printk("{\"bench\":\"button_burst\",\"sent\":%d,\"events\":%u,\"overflows\":%u,\"bounces\":%u}\n\r",
+           LAT_BURST, after.events - before.events, after.overflows - before.overflows,
+           after.bounces - before.bounces);
+}
+#endif /* CONFIG_GPIO_EMUL */
+
+/*
+ * Command line to output pin: toggle output 1, an even number of times.
+ */
+static void lat_cmd_to_pin(struct lat_result *res)
+{
+    static const char cmd[] = "/ot1\r";
+    uint32_t dropped = 0;
+    uint32_t errors = 0;
+    uint32_t t0;
+    int n = 0;
+    int i;
+
+    for(i = 0; i < LAT_RUNS; i++)
+    {
+        k_msleep(5);
+        lat_arm(LAT_OUTPUTS_PIN);
+        t0 = k_cycle_get_32();
+        uart_rx_inject((const uint8_t *)cmd, strlen(cmd));
+        if(lat_wait(LAT_OUTPUTS_PIN) != 0)
+        {
+            dropped++;
+            continue;
+        }
+        lat_us[n++] = k_cyc_to_us_floor32(lat_time[LAT_OUTPUTS_PIN] - t0);
+#if defined(CONFIG_GPIO_EMUL)
+        /* The pin itself must follow the image */
+        if((gpio_emul_output_get(outputs_pins[0].port, outputs_pins[0].pin) ^
+            !!(outputs_pins[0].dt_flags & GPIO_ACTIVE_LOW)) != (int)(outputs_image_get() & 1))
+        {
+            errors++;
+        }
+#endif
+    }
+    lat_stats(res, n, dropped, errors);
+}
+
+/*
+ * Command lines in one go, twice what the RX ring holds: the ring keeps a
+ * prefix and drops the rest. Waits until every line of the prefix is
+ * parsed, or LAT_TIMEOUT_MS.
+ */
+static void lat_cmd_burst(void)
+{
+    static const char cmd[] = "/be\r";
+    static uint8_t burst[2 * UART_RX_RING_SIZE];
+    const int len = sizeof(cmd) - 1;
+    struct uart_rx_stats before, after;
+    uint32_t t0, expected;
+    int i;
+
+    for(i = 0; i + len <= sizeof(burst); i += len)
+    {
+        memcpy(&burst[i], cmd, len);
+    }
+
+    uart_rx_get_stats(&before);
+    t0 = k_cycle_get_32();
+    uart_rx_inject(burst, i);
+
+    /* Lines of the bytes that made it into the ring */
+    uart_rx_get_stats(&after);
+    expected = (i - (after.dropped - before.dropped)) / len;
+    while(after.lines - before.lines < expected &&
+          k_cyc_to_ms_floor32(k_cycle_get_32() - t0) < LAT_TIMEOUT_MS)
+    {
+        k_msleep(2);
+        uart_rx_get_stats(&after);
+    }
+
+    printk("{\"bench\":\"cmd_burst\",\"sent\":%d,\"expected\":%u,\"lines\":%u,\"rx_dropped\":%u,\"time_us\":%u}\n\r",
+           i / len, expected, after.lines - before.lines, after.dropped - before.dropped,
+           k_cyc_to_us_floor32(k_cycle_get_32() - t0));
+}
+
+/*
+ * Last sample of a block to the database, on every block.
+ */
+static void lat_adc_publish(struct lat_result *res)
+{
+    struct adc_stream_stats before, after;
+    uint32_t dropped = 0;
+    int n = 0;
+    int i;
+
+    adc_stream_get_stats(&before);
+    for(i = 0; i < LAT_RUNS; i++)
+    {
+        lat_arm(LAT_ADC_PUBLISH);
+        if(lat_wait(LAT_ADC_PUBLISH) != 0)
+        {
+            dropped++;
+            continue;
+        }
+        lat_us[n++] = k_cyc_to_us_floor32(lat_time[LAT_ADC_PUBLISH] - lat_origin[LAT_ADC_PUBLISH]);
+    }
+    adc_stream_get_stats(&after);
+
+    /* Blocks the engine had to drop count too */
+    lat_stats(res, n, dropped + after.overruns - before.overruns, 0);
+}
+
+#if defined(CONFIG_ADC_EMUL)
+/*
+ * Step on the potentiometer input to the published value crossing half scale,
+ * filter delay included.
+ */
+static void lat_adc_step(struct lat_result *res)
+{
+    uint32_t dropped = 0;
+    uint32_t t0;
+    int n = 0;
+    int i, k;
+
+    for(i = 0; i < LAT_RUNS / 10; i++)
+    {
+        adc_emul_inject(ADC_POT_CHANNEL, 0);
+        k_msleep(LAT_TIMEOUT_MS);
+
+        t0 = k_cycle_get_32();
+        adc_emul_inject(ADC_POT_CHANNEL, ADC_FULL_SCALE_MV);
+        for(k = 0; k < 64; k++)
+        {
+            lat_arm(LAT_ADC_PUBLISH);
+            if(lat_wait(LAT_ADC_PUBLISH) != 0 || db_value(TAG_ADC(ADC_POT_CHANNEL)) >= ADC_FULL_SCALE_MV / 2)
+            {
+                break;
+            }
+        }
+        if(db_value(TAG_ADC(ADC_POT_CHANNEL)) < ADC_FULL_SCALE_MV / 2)
+        {
+            dropped++;
+            continue;
+        }
+        lat_us[n++] = k_cyc_to_us_floor32(lat_time[LAT_ADC_PUBLISH] - t0);
+    }
+    adc_emul_inject(ADC_POT_CHANNEL, -1);
+    lat_stats(res, n, dropped, 0);
+}
+#endif
+
+int latency_run(enum lat_bench b, struct lat_result *res)
+{
+    switch(b)
+    {
+        case LAT_BENCH_EDGE_TO_DB:
+#if defined(CONFIG_GPIO_EMUL)
+            lat_edge_to_db(res);
+            return 0;
+#else
+            return -ENOTSUP;
+#endif
+
+        case LAT_BENCH_CMD_TO_PIN:
+            lat_cmd_to_pin(res);
+            return 0;
+
+        case LAT_BENCH_ADC_PUBLISH:
+            lat_adc_publish(res);
+            return 0;
+
+        case LAT_BENCH_ADC_STEP:
+#if defined(CONFIG_ADC_EMUL)
+            lat_adc_step(res);
+            return 0;
+#else
+            return -ENOTSUP;
+#endif
+
+        default:
+            return -EINVAL;
+    }
+}
+
+static void latency_work_handler(struct k_work *work)
+{
+    static const char *const names[NUM_LAT_BENCHES] = {
+        [LAT_BENCH_EDGE_TO_DB] = "edge_to_db",
+        [LAT_BENCH_CMD_TO_PIN] = "cmd_to_pin",
+        [LAT_BENCH_ADC_PUBLISH] = "adc_publish",
+        [LAT_BENCH_ADC_STEP] = "adc_step",
+    };
+    struct lat_result res;
+
+    printk("\n\r{\"bench\":\"start\",\"runs\":%d,\"adc_period_us\":%u,\"debounce_us\":%u}\n\r",
+           LAT_RUNS, period_get(PERIOD_ADC), button_debounce_get());
+    if(latency_run(LAT_BENCH_EDGE_TO_DB, &res) == 0)
+    {
+        lat_report(names[LAT_BENCH_EDGE_TO_DB], &res);
+    }
+#if defined(CONFIG_GPIO_EMUL)
+    lat_button_burst();
+#endif
+    if(latency_run(LAT_BENCH_CMD_TO_PIN, &res) == 0)
+    {
+        lat_report(names[LAT_BENCH_CMD_TO_PIN], &res);
+    }
+    lat_cmd_burst();
+    if(latency_run(LAT_BENCH_ADC_PUBLISH, &res) == 0)
+    {
+        lat_report(names[LAT_BENCH_ADC_PUBLISH], &res);
+    }
+    if(latency_run(LAT_BENCH_ADC_STEP, &res) == 0)
+    {
+        lat_report(names[LAT_BENCH_ADC_STEP], &res);
+    }
+    printk("{\"bench\":\"done\"}\n\r");
+}
+
+void latency_init(void)
+{
+    int i;
+
+    for(i = 0; i < NUM_LAT_POINTS; i++)
+    {
+        k_sem_init(&lat_sem[i], 0, 1);
+    }
+    k_work_init(&latency_work, latency_work_handler);
+}
+
+void latency_request(void)
+{
+    k_work_submit(&latency_work);
+}
@@ -0,0 +1,109 @@
+/**
+ * \file latency.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief End-to-end latency benchmarks.
+ *
+ * Requested with the /l command, the suite injects stimuli at the inputs of
+ * the application and times how long they take to come out:
+ *
+ *  - edge_to_db: button edge on the GPIO emulator -> database updated
+ *  - button_burst: edges faster than the debounce window -> events, drops
+ *  - cmd_to_pin: command line pushed into the RX ring -> output pin written
+ *  - cmd_burst: twice the RX ring of command lines at once -> lines parsed, bytes dropped
+ *  - adc_publish: last sample of a block taken -> value in the database
+ *  - adc_step: 0 -> full scale step on the ADC emulator -> published value crosses half scale
+ *
+ * Stimuli that need an emulator (button edges, ADC steps) only run on
+ * native_sim; the rest run on hardware too. Each result is one JSON line on
+ * the console, e.g.
+ *
+ *     {"bench":"cmd_to_pin","runs":100,"min_us":41,"p50_us":48,"p99_us":95,"max_us":97,"dropped":0}
+ *
+ * and the suite ends with {"bench":"done"}. tools/latency.py runs it on a
+ * native_sim build and collects the lines. The benchmarks with a latency
+ * distribution are also run through latency_run() by tests/bench, which
+ * fails on drops, wrong outputs or a p99 over its bound.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define LAT_RUNS 100                    /* Stimuli per latency benchmark */
+#define LAT_TIMEOUT_MS 200              /* A stimulus without an effect by then counts as dropped */
+#define LAT_BURST 64                    /* Button edges per burst */
+
+/**
+ * \brief Points of the application where a stimulus comes out.
+ */
+enum lat_point
+{
+    LAT_BUTTON_DB = 0,      /**< Inputs thread wrote a button event to the database */
+    LAT_OUTPUTS_PIN,        /**< Outputs thread wrote a changed image to the pins */
+    LAT_ADC_PUBLISH,        /**< ADC thread wrote the potentiometer value to the database */
+    NUM_LAT_POINTS
+};
+
+/**
+ * \brief Latency benchmarks that can be run on their own (latency_run()).
+ */
+enum lat_bench
+{
+    LAT_BENCH_EDGE_TO_DB = 0,   /**< edge_to_db, needs CONFIG_GPIO_EMUL */
+    LAT_BENCH_CMD_TO_PIN,       /**< cmd_to_pin */
+    LAT_BENCH_ADC_PUBLISH,      /**< adc_publish */
+    LAT_BENCH_ADC_STEP,         /**< adc_step, needs CONFIG_ADC_EMUL */
+    NUM_LAT_BENCHES
+};
+
+/**
+ * \struct lat_result
+ * \brief Latencies of one benchmark.
+ */
+struct lat_result
+{
+    uint32_t runs;          /**< Stimuli that came out */
+    uint32_t dropped;       /**< Stimuli without an effect within LAT_TIMEOUT_MS */
+    uint32_t errors;        /**< Effects that came out wrong (cmd_to_pin: pin not following the image) */
+    uint32_t min_us;        /**< Fastest */
+    uint32_t p50_us;        /**< Median */
+    uint32_t p99_us;        /**< 99th percentile */
+    uint32_t max_us;        /**< Slowest */
+};
+
+/**
+ * \brief Marks that a stimulus came out at a point.
+ *
+ * Costs one atomic read unless the benchmark is waiting on that point.
+ *
+ * \param p Point reached.
+ * \param origin k_cycle_get_32() when the data was produced, if known (0 otherwise).
+ */
+void lat_probe(enum lat_point p, uint32_t origin);
+
+/**
+ * \brief Runs one latency benchmark in the calling thread.
+ *
+ * Takes LAT_RUNS stimuli, up to a few seconds; the caller must not hold
+ * anything the application threads need.
+ *
+ * \param b Benchmark.
+ * \param res Destination of the statistics.
+ * \return 0 if successful, -ENOTSUP if it needs an emulator this build lacks, -EINVAL for an unknown one.
+ */
+int latency_run(enum lat_bench b, struct lat_result *res);
+
+/**
+ * \brief Queues a run of the latency suite on the system work queue.
+ */
+void latency_request(void);
+
+/**
+ * \brief Prepares the probes; called by bench_init().
+ */
+void latency_init(void);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,220 @@
+/**
+ * \file codec.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Delta, zig-zag varint and LZ4 block codec for sample data.
+ */
+
+#include <string.h>
+#include <zephyr/sys/byteorder.h>
+#include "codec.h"
+
+#if defined(CONFIG_LZ4)
+#include <lz4.h>
+
+/* Compressor state (16 KiB) and varint scratch, shared by every encoder */
+static LZ4_stream_t codec_lz4;
+static uint8_t codec_tmp[5 * CODEC_MAX_VALUES];
+static K_MUTEX_DEFINE(codec_mutex);
+#endif
+
+static inline uint32_t codec_zigzag(uint32_t d)
+{
+    return (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+}
+
+static inline uint32_t codec_unzigzag(uint32_t z)
+{
+    return (z >> 1) ^ -(z & 1);
+}
+
+static inline size_t codec_put_varint(uint32_t v, uint8_t *out)
+{
+    size_t o = 0;
+
+    while(v >= 0x80)
+    {
+        out[o++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[o++] = (uint8_t)v;
+    return o;
+}
+
+/*
+ * Reads one varint. Returns its length, or 0 if it is truncated or too long.
+ */
+static inline size_t codec_get_varint(const uint8_t *in, size_t len, uint32_t *v)
+{
+    uint32_t x = 0;
+    size_t i;
+
+    for(i = 0; i < len && i < 5; i++)
+    {
+        x |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if(!(in[i] & 0x80))
+        {
+            *v = x;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Delta + zig-zag varint stream of a block. Returns its length, or -ENOSPC
+ * if it does not fit in size bytes.
+ */
+static int codec_pack(const int32_t *in, size_t n, uint8_t *out, size_t size)
+{
+    uint32_t prev = 0;
+    uint8_t v[5];
+    size_t o = 0;
+    size_t i, k;
+
+    for(i = 0; i < n; i++)
+    {
+        if(size - o >= sizeof(v))
+        {
+            o += codec_put_varint(codec_zigzag((uint32_t)in[i] - prev), &out[o]);
+        }
+        else
+        {
+            /* Near the end of out: check the length before copying */
+            k = codec_put_varint(codec_zigzag((uint32_t)in[i] - prev), v);
+            if(o + k > size)
+            {
+                return -ENOSPC;
+            }
+            memcpy(&out[o], v, k);
+            o += k;
+        }
+        prev = (uint32_t)in[i];
+    }
+    return (int)o;
+}
+
+/*
+ * Reverse of codec_pack(). Returns the bytes used, or -EINVAL.
+ */
+static int codec_unpack(const uint8_t *in, size_t len, int32_t *out, size_t n)
+{
+    uint32_t prev = 0;
+    uint32_t z;
+    size_t o = 0;
+    size_t i, k;
+
+    for(i = 0; i < n; i++)
+    {
+        k = codec_get_varint(&in[o], len - o, &z);
+        if(k == 0)
+        {
+            return -EINVAL;
+        }
+        o += k;
+        prev += codec_unzigzag(z);
+        out[i] = (int32_t)prev;
+    }
+    return (int)o;
+}
+
+int codec_encode(const int32_t *in, size_t n, uint8_t flags, uint8_t *out, size_t size)
+{
+    int len;
+
+    if(n > CODEC_MAX_VALUES)
+    {
+        return -EINVAL;
+    }
+    if(size < 1)
+    {
+        return -ENOSPC;
+    }
+
+#if defined(CONFIG_LZ4)
+    /* Room for the LZ4 header, or the varints straight away */
+    if((flags & CODEC_LZ4) && size >= 1 + 5 + 2)
+    {
+        size_t hdr;
+        int clen = 0;
+
+        k_mutex_lock(&codec_mutex, K_FOREVER);
+        len = codec_pack(in, n, codec_tmp, sizeof(codec_tmp));
+        hdr = 1 + codec_put_varint(len, &out[1]) + 2;
+        if(size > hdr)
+        {
+            clen = LZ4_compress_fast_extState(&codec_lz4, (const char *)codec_tmp, (char *)&out[hdr],
+                                              len, size - hdr, 1);
+        }
+
+        if(clen > 0 && hdr + clen < 1 + (size_t)len)
+        {
+            out[0] = CODEC_LZ4;
+            sys_put_le16(clen, &out[hdr - 2]);
+            len = hdr + clen;
+        }
+        else if(1 + (size_t)len <= size)
+        {
+            /* Not worth it: keep the varints */
+            out[0] = 0;
+            memcpy(&out[1], codec_tmp, len);
+            len++;
+        }
+        else
+        {
+            len = -ENOSPC;
+        }
+        k_mutex_unlock(&codec_mutex);
+        return len;
+    }
+#endif
+
+    out[0] = 0;
+    len = codec_pack(in, n, &out[1], size - 1);
+    return (len < 0) ? len : len + 1;
+}
+
+int codec_decode(const uint8_t *in, size_t len, int32_t *out, size_t n)
+{
+    int rc;
+
+    if(len < 1 || n > CODEC_MAX_VALUES)
+    {
+        return -EINVAL;
+    }
+
+    if(!(in[0] & CODEC_LZ4))
+    {
+        rc = codec_unpack(&in[1], len - 1, out, n);
+        return (rc < 0) ? rc : rc + 1;
+    }
+
+#if defined(CONFIG_LZ4)
+    uint32_t vlen;
+    size_t o, k;
+    int clen;
+
+    k = codec_get_varint(&in[1], len - 1, &vlen);
+    o = 1 + k;
+    if(k == 0 || o + 2 > len || vlen > sizeof(codec_tmp))
+    {
+        return -EINVAL;
+    }
+    clen = sys_get_le16(&in[o]);
+    o += 2;
+    if(o + clen > len)
+    {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&codec_mutex, K_FOREVER);
+    rc = LZ4_decompress_safe((const char *)&in[o], (char *)codec_tmp, clen, sizeof(codec_tmp));
+    rc = (rc == (int)vlen) ? codec_unpack(codec_tmp, vlen, out, n) : -EINVAL;
+    k_mutex_unlock(&codec_mutex);
+
+    return (rc < 0) ? rc : (int)(o + clen);
+#else
+    /* Built without LZ4 */
+    return -ENOTSUP;
+#endif
+}
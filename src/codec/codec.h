@@ -0,0 +1,54 @@
+/**
+ * \file codec.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Delta, zig-zag varint and LZ4 block codec for sample data.
+ *
+ * A block of n int32 values is coded as the difference of each value to the
+ * previous one (the first to 0), each difference zig-zag mapped and written
+ * as an LEB128 varint. Slowly changing data costs one byte per value. The
+ * varint stream can then be LZ4-compressed, which pays off on long runs of
+ * identical differences. Encoded layout:
+ *
+ *     flags(1) varints                                 (flags & CODEC_LZ4 == 0)
+ *     flags(1) varint_len(varint) lz4_len(2) lz4_block (flags & CODEC_LZ4)
+ *
+ * LZ4 is only kept when it makes the block smaller. n is not stored, the
+ * container (telemetry frame, historian block) carries it. Multi-channel
+ * data goes in column by column. tools/decode.py is the host decoder.
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define CODEC_LZ4 BIT(0)                /* Flag: varint stream is LZ4-compressed */
+#define CODEC_MAX_VALUES 512            /* Largest block */
+
+/* Worst-case encoded size of n values */
+#define CODEC_BOUND(n) (1 + 5 + 2 + 5 * (n) + (5 * (n)) / 255 + 16)
+
+/**
+ * \brief Encodes a block.
+ * \param in Values to encode.
+ * \param n Number of values, up to CODEC_MAX_VALUES.
+ * \param flags CODEC_LZ4 to try LZ4 on top of the varints.
+ * \param out Destination.
+ * \param size Size of out, CODEC_BOUND(n) is always enough.
+ * \return Encoded length, or -ENOSPC if out is too small, -EINVAL if n is too large.
+ */
+int codec_encode(const int32_t *in, size_t n, uint8_t flags, uint8_t *out, size_t size);
+
+/**
+ * \brief Decodes a block.
+ * \param in Encoded data.
+ * \param len Length of in, may hold more data after the block.
+ * \param out Destination of the n values.
+ * \param n Number of values in the block.
+ * \return Bytes of in used by the block, or -EINVAL if in is not a valid block.
+ */
+int codec_decode(const uint8_t *in, size_t len, int32_t *out, size_t n);
+
+#endif /* CODEC_H */
@@ -0,0 +1,91 @@
+/**
+ * \file conv.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Fixed-point conversion of raw ADC counts into engineering units.
+ */
+
+#include "conv.h"
+
+/* 10k NTC in a divider against 10k to VDD: divider voltage (mV) -> temperature (m°C) */
+static const struct conv_lut_point ntc_points[] = {
+    {  300, 100000 },
+    {  600,  70000 },
+    { 1000,  45000 },
+    { 1500,  25000 },
+    { 2000,  10000 },
+    { 2500,  -8000 },
+    { 2800, -25000 },
+};
+static int32_t ntc_slopes[ARRAY_SIZE(ntc_points) - 1];
+static struct conv_lut ntc_lut = { ntc_points, ntc_slopes, ARRAY_SIZE(ntc_points) };
+
+/* Per-channel calibration, indexed like adc_scan_list */
+struct conv_cfg conv_cfg[ADC_SCAN_CHANNELS] = {
+    { .offset = 0, .gain = CONV_MV_GAIN, .lut = NULL },        /* Potentiometer, mV */
+    { .offset = 0, .gain = CONV_MV_GAIN, .lut = &ntc_lut },    /* NTC thermistor, m°C */
+    { .offset = 0, .gain = CONV_MV_GAIN, .lut = NULL },        /* Generic 0-3 V input, mV */
+    { .offset = 0, .gain = CONV_MV_GAIN, .lut = NULL },        /* Generic 0-3 V input, mV */
+};
+
+void conv_init()
+{
+    int ch, i;
+    struct conv_lut *lut;
+
+    for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+    {
+        lut = conv_cfg[ch].lut;
+        if(lut == NULL)
+        {
+            continue;
+        }
+        for(i = 0; i < lut->n - 1; i++)
+        {
+            lut->slopes[i] = (int32_t)((((int64_t)(lut->points[i + 1].out - lut->points[i].out)) << CONV_Q) /
+                                       (lut->points[i + 1].in - lut->points[i].in));
+        }
+    }
+}
+
+int32_t conv_lut_eval(const struct conv_lut *lut, int32_t x)
+{
+    const struct conv_lut_point *p = lut->points;
+    int i;
+
+    if(x <= p[0].in)
+    {
+        return p[0].out;
+    }
+    if(x >= p[lut->n - 1].in)
+    {
+        return p[lut->n - 1].out;
+    }
+
+    /* Tables are short, a linear search beats a binary one here */
+    for(i = 1; x > p[i].in; i++)
+    {
+    }
+    i--;
+
+    return p[i].out + (int32_t)(((int64_t)(x - p[i].in) * lut->slopes[i] + CONV_HALF) >> CONV_Q);
+}
+
+void conv_block(int ch, const struct adc_block *blk, int32_t *out)
+{
+    const struct conv_cfg *cfg = &conv_cfg[ch];
+    int i;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        out[i] = (int32_t)(((int64_t)(blk->samples[i][ch] + cfg->offset) * cfg->gain + CONV_HALF) >> CONV_Q);
+    }
+
+    if(cfg->lut != NULL)
+    {
+        for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+        {
+            out[i] = conv_lut_eval(cfg->lut, out[i]);
+        }
+    }
+}
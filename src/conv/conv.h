@@ -0,0 +1,102 @@
+/**
+ * \file conv.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Fixed-point conversion of raw ADC counts into engineering units.
+ *
+ * Each scan list channel has an offset/gain calibration in Q16 and an
+ * optional piecewise-linear table for nonlinear sensors. Results are int32
+ * milli-units (mV, m°C, ...). Only integer multiply and shift are used, so
+ * the conversion is cheap enough to run on every sample of a block.
+ */
+
+#ifndef CONV_H
+#define CONV_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include "adc.h"
+
+#define CONV_Q 16                       /* Fractional bits of gains and slopes */
+#define CONV_ONE (1 << CONV_Q)          /* 1.0 in Q16 */
+#define CONV_HALF (1 << (CONV_Q - 1))   /* 0.5 in Q16, rounds products to nearest */
+
+/* Gain in Q16 that maps the full ADC range onto ADC_FULL_SCALE_MV */
+#define CONV_MV_GAIN ((int32_t)(((int64_t)ADC_FULL_SCALE_MV << CONV_Q) / ((1 << ADC_RESOLUTION) - 1)))
+
+/**
+ * \struct conv_lut_point
+ * \brief Breakpoint of a piecewise-linear table.
+ */
+struct conv_lut_point
+{
+    int32_t in;         /**< Calibrated input (milli-units), ascending */
+    int32_t out;        /**< Output at this breakpoint (milli-units) */
+};
+
+/**
+ * \struct conv_lut
+ * \brief Piecewise-linear table, inputs outside the table are clamped.
+ */
+struct conv_lut
+{
+    const struct conv_lut_point *points;    /**< Breakpoints, sorted by in */
+    int32_t *slopes;                        /**< Per-segment slope in Q16, filled by conv_init() */
+    uint8_t n;                              /**< Number of breakpoints (>= 2) */
+};
+
+/**
+ * \struct conv_cfg
+ * \brief Conversion settings of one channel.
+ *
+ * value = ((raw + offset) * gain) >> CONV_Q (rounded), then mapped through lut if present.
+ */
+struct conv_cfg
+{
+    int32_t offset;         /**< Raw offset correction (counts) */
+    int32_t gain;           /**< Milli-units per count, Q16 */
+    struct conv_lut *lut;   /**< Optional linearisation table, NULL for a linear sensor */
+};
+
+extern struct conv_cfg conv_cfg[ADC_SCAN_CHANNELS];    /**< Per-channel conversion settings */
+
+/**
+ * \brief Precomputes the segment slopes of every linearisation table.
+ */
+void conv_init(void);
+
+/**
+ * \brief Maps a calibrated value through a linearisation table.
+ * \param lut Table to use.
+ * \param x Calibrated input (milli-units).
+ * \return Linearised value (milli-units).
+ */
+int32_t conv_lut_eval(const struct conv_lut *lut, int32_t x);
+
+/**
+ * \brief Converts one raw sample of a channel.
+ * \param ch Scan list index.
+ * \param raw Raw ADC count.
+ * \return Value in milli-units.
+ */
+static inline int32_t conv_apply(int ch, int32_t raw)
+{
+    const struct conv_cfg *cfg = &conv_cfg[ch];
+    int32_t value = (int32_t)(((int64_t)(raw + cfg->offset) * cfg->gain + CONV_HALF) >> CONV_Q);
+
+    if(cfg->lut != NULL)
+    {
+        value = conv_lut_eval(cfg->lut, value);
+    }
+    return value;
+}
+
+/**
+ * \brief Converts every sample of one channel of a block.
+ * \param ch Scan list index.
+ * \param blk Source block.
+ * \param out Destination, ADC_BLOCK_SAMPLES values in milli-units.
+ */
+void conv_block(int ch, const struct adc_block *blk, int32_t *out);
+
+#endif /* CONV_H */
@@ -0,0 +1,244 @@
+/**
+ * \file db.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Tag registry: typed process points with quality, timestamp and change sequence.
+ */
+
+#include <zephyr/sys/barrier.h>
+#include <string.h>
+#include "db.h"
+
+/*
+ * Slot of every tag in the storage of its type, at compile time: each tag
+ * opens an enumerator at the running count of its type, and the next one
+ * resumes one further only if the tag has that type.
+ */
+#define DB_TAG_BSLOT(id, type, name) DB_BSLOT_##id, DB_BNEXT_##id = DB_BSLOT_##id + ((type) == DB_BOOL) - 1,
+#define DB_TAG_ISLOT(id, type, name) DB_ISLOT_##id, DB_INEXT_##id = DB_ISLOT_##id + ((type) == DB_INT) - 1,
+#define DB_TAG_SLOT(id, type, name) [TAG_##id] = ((type) == DB_BOOL) ? DB_BSLOT_##id : DB_ISLOT_##id,
+#define DB_TAG_TYPE(id, type, name) [TAG_##id] = (type),
+#define DB_TAG_NAME(id, type, name) [TAG_##id] = (name),
+
+enum { DB_TAG_LIST(DB_TAG_BSLOT) };
+enum { DB_TAG_LIST(DB_TAG_ISLOT) };
+
+const uint16_t db_tag_slot[DB_NUM_TAGS] = { DB_TAG_LIST(DB_TAG_SLOT) };
+const uint8_t db_tag_type[DB_NUM_TAGS] = { DB_TAG_LIST(DB_TAG_TYPE) };
+const char *const db_tag_name[DB_NUM_TAGS] = { DB_TAG_LIST(DB_TAG_NAME) };
+
+/* Values, by type */
+static struct db_snapshot db_values;
+
+/* Metadata, by tag ID */
+static uint8_t db_quality[DB_NUM_TAGS];
+static uint32_t db_stamp[DB_NUM_TAGS];
+static uint32_t db_tag_seq[DB_NUM_TAGS];
+
+static uint32_t db_changes;             /* Change counter, sequence number of the last change */
+static uint32_t db_now;                 /* Timestamp of the open write section */
+
+static struct k_spinlock db_lock;       /* Serializes writers */
+static atomic_t db_seq;                 /* Odd while a write section is open */
+
+void db_init()
+{
+    k_spinlock_key_t key = db_write_begin();
+
+    memset(&db_values, 0, sizeof(db_values));
+    memset(db_quality, DB_Q_UNINIT, sizeof(db_quality));
+    memset(db_stamp, 0, sizeof(db_stamp));
+    memset(db_tag_seq, 0, sizeof(db_tag_seq));
+    db_changes = 0;
+    db_write_end(key);
+}
+
+k_spinlock_key_t db_write_begin()
+{
+    k_spinlock_key_t key = k_spin_lock(&db_lock);
+
+    atomic_inc(&db_seq);
+    barrier_dmem_fence_full();
+    db_now = k_uptime_get_32();
+    return key;
+}
+
+void db_write_end(k_spinlock_key_t key)
+{
+    barrier_dmem_fence_full();
+    atomic_inc(&db_seq);
+    k_spin_unlock(&db_lock, key);
+}
+
+/*
+ * Stamps a tag whose value or quality changed. Called with the lock held.
+ */
+static inline void db_touch(enum db_tag id, enum db_quality quality)
+{
+    db_quality[id] = quality;
+    db_stamp[id] = db_now;
+    /* 0 stays reserved for never written, also when the counter wraps */
+    if(++db_changes == 0)
+    {
+        db_changes = 1;
+    }
+    db_tag_seq[id] = db_changes;
+}
+
+void db_set(enum db_tag id, int32_t value)
+{
+    uint16_t s = db_tag_slot[id];
+    uint32_t bit;
+
+    if(db_tag_type[id] == DB_BOOL)
+    {
+        bit = BIT(s % 32);
+        if(((db_values.bools[s / 32] & bit) != 0) == (value != 0) && db_quality[id] == DB_Q_GOOD)
+        {
+            return;
+        }
+        db_values.bools[s / 32] = (value != 0) ? (db_values.bools[s / 32] | bit) : (db_values.bools[s / 32] & ~bit);
+    }
+    else
+    {
+        if(db_values.ints[s] == value && db_quality[id] == DB_Q_GOOD)
+        {
+            return;
+        }
+        db_values.ints[s] = value;
+    }
+    db_touch(id, DB_Q_GOOD);
+}
+
+void db_set_bits(enum db_tag first, int n, uint32_t bits)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        db_set(first + i, (bits >> i) & 1);
+    }
+}
+
+void db_set_quality(enum db_tag id, enum db_quality quality)
+{
+    if(db_quality[id] != quality)
+    {
+        db_touch(id, quality);
+    }
+}
+
+/*
+ * Seqlock read side: waits for no writer, then reports whether one ran
+ * while the caller was copying.
+ */
+static inline uint32_t db_read_begin(void)
+{
+    uint32_t seq;
+
+    do
+    {
+        /* Writer in progress on another context, try again */
+        seq = (uint32_t)atomic_get(&db_seq);
+    } while(seq & 1);
+    barrier_dmem_fence_full();
+    return seq;
+}
+
+static inline bool db_read_retry(uint32_t seq)
+{
+    barrier_dmem_fence_full();
+    return (uint32_t)atomic_get(&db_seq) != seq;
+}
+
+uint32_t db_read(struct db_snapshot *snap)
+{
+    uint32_t seq, changes;
+
+    do
+    {
+        seq = db_read_begin();
+        memcpy(snap, &db_values, sizeof(*snap));
+        changes = db_changes;
+    } while(db_read_retry(seq));
+    return changes;
+}
+
+int db_get(enum db_tag id, struct db_tag_info *info)
+{
+    uint16_t s;
+    uint32_t seq;
+
+    if(id >= DB_NUM_TAGS)
+    {
+        return -EINVAL;
+    }
+
+    s = db_tag_slot[id];
+    info->type = db_tag_type[id];
+    do
+    {
+        seq = db_read_begin();
+        info->value = (info->type == DB_BOOL) ? ((db_values.bools[s / 32] >> (s % 32)) & 1) : db_values.ints[s];
+        info->quality = db_quality[id];
+        info->timestamp = db_stamp[id];
+        info->seq = db_tag_seq[id];
+    } while(db_read_retry(seq));
+    return 0;
+}
+
+uint32_t db_bits(enum db_tag first, int n)
+{
+    uint32_t seq, bits;
+
+    do
+    {
+        seq = db_read_begin();
+        bits = db_snap_bits(&db_values, first, n);
+    } while(db_read_retry(seq));
+    return bits;
+}
+
+int32_t db_value(enum db_tag id)
+{
+    uint32_t seq;
+    int32_t v;
+
+    if(id >= DB_NUM_TAGS)
+    {
+        return 0;
+    }
+    do
+    {
+        seq = db_read_begin();
+        v = db_snap_value(&db_values, id);
+    } while(db_read_retry(seq));
+    return v;
+}
+
+int db_changed(uint32_t since, enum db_tag first, uint16_t *ids, int max, enum db_tag *next)
+{
+    uint32_t seq;
+    int id, n;
+
+    do
+    {
+        seq = db_read_begin();
+        n = 0;
+        for(id = first; id < DB_NUM_TAGS && n < max; id++)
+        {
+            /* Never written (seq 0) is never a change; otherwise wrap-safe: changed after since */
+            if(db_tag_seq[id] != 0 && (int32_t)(db_tag_seq[id] - since) > 0)
+            {
+                ids[n++] = id;
+            }
+        }
+    } while(db_read_retry(seq));
+    *next = id;
+    return n;
+}
+
+uint32_t db_change_count(void)
+{
+    return db_changes;
+}
@@ -0,0 +1,255 @@
+/**
+ * \file db.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Tag registry: typed process points with quality, timestamp and change sequence.
+ *
+ * Every point of the application is a tag, listed once in DB_TAG_LIST and
+ * addressed by its ID (enum db_tag) everywhere: threads, commands, UI and
+ * protocols. Values are stored by type, booleans bit-packed into 32-bit words
+ * and integers in one contiguous array, so a snapshot or a scan touches a
+ * few cache lines whatever the number of tags. Metadata lives in parallel
+ * arrays indexed by ID: quality, timestamp of the last change (ms of uptime)
+ * and change sequence number.
+ *
+ * Every change of a value or quality takes the next number of a registry-wide
+ * change counter and stores it as the sequence number of the tag. A consumer
+ * that remembers the counter (db_changed()) finds everything that changed
+ * since in one pass over the sequence array, instead of comparing values.
+ *
+ * Writers wrap their updates in db_write_begin()/db_write_end(). Writers are
+ * serialized by a spinlock held only while a few tags are stored, so they
+ * never sleep. Readers never lock: they copy what they need and retry if a
+ * writer was active meanwhile (seqlock). A reader therefore always gets a
+ * consistent set of tags and can never delay a writer.
+ */
+
+#ifndef DB_H
+#define DB_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+/**
+ * \brief Tag types.
+ */
+enum db_type
+{
+    DB_BOOL = 0,            /**< 0 or 1, bit-packed */
+    DB_INT,                 /**< 32-bit signed value */
+};
+
+/**
+ * \brief Tag quality.
+ */
+enum db_quality
+{
+    DB_Q_UNINIT = 0,        /**< Never written */
+    DB_Q_GOOD,              /**< Written by its source */
+    DB_Q_BAD,               /**< Source failed, the value is the last good one */
+};
+
+/*
+ * Tag table: id, type, name. The enum, the type table and the name table are
+ * generated from this list, so a new point is one line here. Consecutive
+ * booleans get consecutive bits (db_bits(), db_set_bits()).
+ */
+#define DB_TAG_LIST(X) \
+    X(BUTTON1, DB_BOOL, "button1")      /* State of Button 1 */                                 \
+    X(BUTTON2, DB_BOOL, "button2")      /* State of Button 2 */                                 \
+    X(BUTTON3, DB_BOOL, "button3")      /* State of Button 3 */                                 \
+    X(BUTTON4, DB_BOOL, "button4")      /* State of Button 4 */                                 \
+    X(OUTPUT1, DB_BOOL, "output1")      /* State of Output 1 */                                 \
+    X(OUTPUT2, DB_BOOL, "output2")      /* State of Output 2 */                                 \
+    X(OUTPUT3, DB_BOOL, "output3")      /* State of Output 3 */                                 \
+    X(OUTPUT4, DB_BOOL, "output4")      /* State of Output 4 */                                 \
+    X(ADC0, DB_INT, "adc0")             /* Scan channel 0, potentiometer (milli-units, conv.h) */ \
+    X(ADC1, DB_INT, "adc1")             /* Scan channel 1 */                                    \
+    X(ADC2, DB_INT, "adc2")             /* Scan channel 2 */                                    \
+    X(ADC3, DB_INT, "adc3")             /* Scan channel 3 */                                    \
+    X(ADC0_RAW, DB_INT, "adc0_raw")     /* Scan channel 0, filtered counts behind ADC0 */      \
+    X(ADC1_RAW, DB_INT, "adc1_raw")     /* Scan channel 1, counts */                            \
+    X(ADC2_RAW, DB_INT, "adc2_raw")     /* Scan channel 2, counts */                            \
+    X(ADC3_RAW, DB_INT, "adc3_raw")     /* Scan channel 3, counts */
+
+#define DB_TAG_ENUM(id, type, name) TAG_##id,
+#define DB_TAG_BOOLS(id, type, name) + ((type) == DB_BOOL)
+#define DB_TAG_INTS(id, type, name) + ((type) == DB_INT)
+
+/**
+ * \brief Tag IDs.
+ */
+enum db_tag
+{
+    DB_TAG_LIST(DB_TAG_ENUM)
+    DB_NUM_TAGS
+};
+
+#define DB_NUM_BOOLS (0 DB_TAG_LIST(DB_TAG_BOOLS))      /* Boolean tags */
+#define DB_NUM_INTS (0 DB_TAG_LIST(DB_TAG_INTS))        /* Integer tags */
+#define DB_BOOL_WORDS DIV_ROUND_UP(DB_NUM_BOOLS, 32)    /* Words of packed booleans */
+
+#define TAG_ADC(ch) ((enum db_tag)(TAG_ADC0 + (ch)))    /* Tag of scan list entry ch */
+#define TAG_ADC_RAW(ch) ((enum db_tag)(TAG_ADC0_RAW + (ch)))    /* Counts of scan list entry ch */
+
+/**
+ * \struct db_snapshot
+ * \brief Consistent copy of every value, taken with db_read().
+ */
+struct db_snapshot
+{
+    uint32_t bools[DB_BOOL_WORDS];      /**< Booleans, bit i of word w is the (32 w + i)-th boolean tag */
+    int32_t ints[DB_NUM_INTS];          /**< Integers, in tag order */
+};
+
+/**
+ * \struct db_tag_info
+ * \brief Value and metadata of one tag, taken with db_get().
+ */
+struct db_tag_info
+{
+    int32_t value;          /**< Value (0 or 1 for DB_BOOL) */
+    uint8_t type;           /**< Type (enum db_type) */
+    uint8_t quality;        /**< Quality (enum db_quality) */
+    uint32_t timestamp;     /**< k_uptime_get_32() at the last change */
+    uint32_t seq;           /**< Change counter at the last change, 0 if never changed */
+};
+
+extern const uint8_t db_tag_type[DB_NUM_TAGS];         /**< Type of every tag */
+extern const char *const db_tag_name[DB_NUM_TAGS];     /**< Name of every tag */
+extern const uint16_t db_tag_slot[DB_NUM_TAGS];        /**< Index of every tag in the storage of its type */
+
+/**
+ * \brief Resets every tag to 0, DB_Q_UNINIT.
+ */
+void db_init(void);
+
+/**
+ * \brief Opens a write section.
+ *
+ * Keep the section short: it runs with the database spinlock held. Every
+ * change stored in the section gets the same timestamp.
+ *
+ * \return Key to pass to db_write_end().
+ */
+k_spinlock_key_t db_write_begin(void);
+
+/**
+ * \brief Closes a write section opened with db_write_begin().
+ * \param key Key returned by db_write_begin().
+ */
+void db_write_end(k_spinlock_key_t key);
+
+/**
+ * \brief Stores a value, with DB_Q_GOOD. Inside a write section only.
+ *
+ * The sequence number and the timestamp only move when the value or the
+ * quality changes.
+ *
+ * \param id Tag.
+ * \param value New value, booleans store value != 0.
+ */
+void db_set(enum db_tag id, int32_t value);
+
+/**
+ * \brief Stores consecutive boolean tags from a mask. Inside a write section only.
+ * \param first First tag.
+ * \param n Number of tags (at most 32).
+ * \param bits Bit i is the value of tag first + i.
+ */
+void db_set_bits(enum db_tag first, int n, uint32_t bits);
+
+/**
+ * \brief Changes the quality of a tag, keeping its value. Inside a write section only.
+ * \param id Tag.
+ * \param quality New quality (enum db_quality).
+ */
+void db_set_quality(enum db_tag id, enum db_quality quality);
+
+/**
+ * \brief Takes a consistent copy of every value without blocking writers.
+ * \param snap Destination of the copy.
+ * \return Change counter of the copy.
+ */
+uint32_t db_read(struct db_snapshot *snap);
+
+/**
+ * \brief Takes a consistent copy of one tag without blocking writers.
+ * \param id Tag.
+ * \param info Destination.
+ * \return 0 if successful, -EINVAL for an unknown tag.
+ */
+int db_get(enum db_tag id, struct db_tag_info *info);
+
+/**
+ * \brief Returns consecutive boolean tags as a mask, consistently.
+ * \param first First tag.
+ * \param n Number of tags (at most 32).
+ * \return Bit i is the value of tag first + i.
+ */
+uint32_t db_bits(enum db_tag first, int n);
+
+/**
+ * \brief Returns the value of one tag.
+ * \param id Tag.
+ * \return Value, 0 for an unknown tag.
+ */
+int32_t db_value(enum db_tag id);
+
+/**
+ * \brief Lists the tags changed since a value of the change counter, in one pass.
+ *
+ * Tags are listed in ID order from first; when ids fills up, the scan stops
+ * and *next tells where to resume with the same since.
+ *
+ * \param since Change counter the caller is up to date with (0: every tag ever written).
+ * \param first First tag to look at.
+ * \param ids Destination of the changed tags.
+ * \param max Room in ids.
+ * \param next Tag to resume from, DB_NUM_TAGS if the scan reached the end.
+ * \return Number of tags stored in ids.
+ */
+int db_changed(uint32_t since, enum db_tag first, uint16_t *ids, int max, enum db_tag *next);
+
+/**
+ * \brief Returns the change counter: the sequence number of the last change.
+ */
+uint32_t db_change_count(void);
+
+/**
+ * \brief Returns a value from a snapshot.
+ * \param snap Snapshot taken with db_read().
+ * \param id Tag.
+ * \return Value.
+ */
+static inline int32_t db_snap_value(const struct db_snapshot *snap, enum db_tag id)
+{
+    uint16_t s = db_tag_slot[id];
+
+    if(db_tag_type[id] == DB_BOOL)
+    {
+        return (snap->bools[s / 32] >> (s % 32)) & 1;
+    }
+    return snap->ints[s];
+}
+
+/**
+ * \brief Returns consecutive boolean tags of a snapshot as a mask.
+ * \param snap Snapshot taken with db_read().
+ * \param first First tag.
+ * \param n Number of tags (at most 32).
+ * \return Bit i is the value of tag first + i.
+ */
+static inline uint32_t db_snap_bits(const struct db_snapshot *snap, enum db_tag first, int n)
+{
+    uint16_t s = db_tag_slot[first];
+    uint64_t w = snap->bools[s / 32];
+
+    if(s / 32 + 1 < DB_BOOL_WORDS)
+    {
+        w |= (uint64_t)snap->bools[s / 32 + 1] << 32;
+    }
+    return (uint32_t)(w >> (s % 32)) & (uint32_t)BIT64_MASK(n);
+}
+
+#endif /* DB_H */
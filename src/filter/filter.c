@@ -0,0 +1,383 @@
+/**
+ * \file filter.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Filtering and decimation stage between ADC acquisition and the database.
+ *
+ * Histories are seeded with the first sample so the outputs start at the
+ * input level instead of ramping up from zero (the CIC decimator settles
+ * after FILTER_CIC_ORDER output samples).
+ */
+
+#include "filter.h"
+
+/* Default filter of each channel, indexed like adc_scan_list */
+const struct filter_cfg filter_cfg[ADC_SCAN_CHANNELS] = {
+    { .type = FILTER_MOVING_AVG, .len = 16 },   /* Potentiometer */
+    { .type = FILTER_MEDIAN, .len = 5 },        /* NTC, spike rejection */
+    { .type = FILTER_BIQUAD },
+    { .type = FILTER_CIC, .len = 8 },
+};
+
+static struct filter filter_chan[ADC_SCAN_CHANNELS];
+
+/* Butterworth low-pass at fs/20, CMSIS layout {b0, 0, b1, b2, -a1, -a2} scaled by 1/2 (postShift 1) */
+static const int16_t filter_biquad_coeffs[6 * FILTER_BIQUAD_STAGES] = {
+    329, 0, 658, 329, 25576, -10508
+};
+#define FILTER_BIQUAD_POSTSHIFT 1
+
+/* Hamming-windowed low-pass at fs/8, unity DC gain (symmetric, so time reversal is a no-op) */
+static const int16_t filter_fir_coeffs[FILTER_FIR_TAPS] = {
+    -42, -177, -406, -352, 669, 2961, 5846, 7885,
+    7885, 5846, 2961, 669, -352, -406, -177, -42
+};
+
+static inline int16_t filter_sat16(int64_t v)
+{
+    if(v > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if(v < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+/* Back from the q15 working range to raw counts, rounded */
+static inline int16_t filter_from_q15(int16_t v)
+{
+    return (int16_t)((v + (1 << (FILTER_Q15_SHIFT - 1))) >> FILTER_Q15_SHIFT);
+}
+
+int filter_init(struct filter *f, const struct filter_cfg *cfg)
+{
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+
+    switch(cfg->type)
+    {
+        case FILTER_NONE:
+        case FILTER_BIQUAD:
+            break;
+
+        case FILTER_MOVING_AVG:
+            if(cfg->len == 0 || cfg->len > FILTER_MAX_LEN)
+            {
+                return -EINVAL;
+            }
+            break;
+
+        case FILTER_MEDIAN:
+            if(cfg->len == 0 || cfg->len > FILTER_MEDIAN_MAX || (cfg->len & 1) == 0)
+            {
+                return -EINVAL;
+            }
+            break;
+
+        case FILTER_FIR_DECIM:
+            if(cfg->len == 0 || (ADC_BLOCK_SAMPLES % cfg->len) != 0)
+            {
+                return -EINVAL;
+            }
+#if defined(CONFIG_CMSIS_DSP_FILTERING)
+            if(arm_fir_decimate_init_q15(&f->fir.inst, FILTER_FIR_TAPS, cfg->len, filter_fir_coeffs,
+                                         f->fir.state, ADC_BLOCK_SAMPLES) != ARM_MATH_SUCCESS)
+            {
+                return -EINVAL;
+            }
+#endif
+            break;
+
+        case FILTER_CIC:
+            if(!IS_POWER_OF_TWO(cfg->len) || (ADC_BLOCK_SAMPLES % cfg->len) != 0)
+            {
+                return -EINVAL;
+            }
+            /* DC gain is len^order, undone with a shift */
+            f->cic.shift = FILTER_CIC_ORDER * (31 - __builtin_clz(cfg->len));
+            break;
+
+        default:
+            return -EINVAL;
+    }
+
+#if defined(CONFIG_CMSIS_DSP_FILTERING)
+    if(cfg->type == FILTER_BIQUAD)
+    {
+        arm_biquad_cascade_df1_init_q15(&f->iir.inst, FILTER_BIQUAD_STAGES, filter_biquad_coeffs,
+                                        f->iir.state, FILTER_BIQUAD_POSTSHIFT);
+    }
+#endif
+
+    return 0;
+}
+
+/*
+ * Seeds the history with the first sample.
+ */
+static void filter_prime(struct filter *f, int16_t x)
+{
+    int i;
+    int16_t xq = (int16_t)(x << FILTER_Q15_SHIFT);
+
+    switch(f->cfg.type)
+    {
+        case FILTER_MOVING_AVG:
+            for(i = 0; i < f->cfg.len; i++)
+            {
+                f->avg.hist[i] = x;
+            }
+            f->avg.sum = (int32_t)x * f->cfg.len;
+            break;
+
+        case FILTER_MEDIAN:
+            for(i = 0; i < f->cfg.len; i++)
+            {
+                f->med.hist[i] = x;
+            }
+            break;
+
+        case FILTER_BIQUAD:
+            for(i = 0; i < 4 * FILTER_BIQUAD_STAGES; i++)
+            {
+                f->iir.state[i] = xq;
+            }
+            break;
+
+        case FILTER_FIR_DECIM:
+            for(i = 0; i < FILTER_FIR_TAPS - 1; i++)
+            {
+                f->fir.state[i] = xq;
+            }
+            break;
+
+        default:
+            break;
+    }
+    f->primed = true;
+}
+
+static int filter_moving_avg(struct filter *f, const int16_t *in, int16_t *out)
+{
+    int i;
+    int len = f->cfg.len;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        f->avg.sum += in[i] - f->avg.hist[f->avg.idx];
+        f->avg.hist[f->avg.idx] = in[i];
+        if(++f->avg.idx == len)
+        {
+            f->avg.idx = 0;
+        }
+        out[i] = (int16_t)((f->avg.sum + len / 2) / len);
+    }
+    return ADC_BLOCK_SAMPLES;
+}
+
+static int filter_median(struct filter *f, const int16_t *in, int16_t *out)
+{
+    int16_t win[FILTER_MEDIAN_MAX];
+    int16_t x;
+    int i, j, k;
+    int len = f->cfg.len;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        f->med.hist[f->med.idx] = in[i];
+        if(++f->med.idx == len)
+        {
+            f->med.idx = 0;
+        }
+
+        /* Insertion sort of the window, at most FILTER_MEDIAN_MAX elements */
+        for(j = 0; j < len; j++)
+        {
+            x = f->med.hist[j];
+            for(k = j; k > 0 && win[k - 1] > x; k--)
+            {
+                win[k] = win[k - 1];
+            }
+            win[k] = x;
+        }
+        out[i] = win[len / 2];
+    }
+    return ADC_BLOCK_SAMPLES;
+}
+
+static int filter_biquad(struct filter *f, const int16_t *in, int16_t *out)
+{
+    int16_t buf[ADC_BLOCK_SAMPLES];
+    int i;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        buf[i] = (int16_t)(in[i] << FILTER_Q15_SHIFT);
+    }
+
+#if defined(CONFIG_CMSIS_DSP_FILTERING)
+    arm_biquad_cascade_df1_q15(&f->iir.inst, buf, buf, ADC_BLOCK_SAMPLES);
+#else
+    {
+        /* Same arithmetic as arm_biquad_cascade_df1_q15(): state {x1, x2, y1, y2} per stage */
+        const int16_t *c;
+        int16_t *st;
+        int64_t acc;
+        int s;
+
+        for(s = 0; s < FILTER_BIQUAD_STAGES; s++)
+        {
+            c = &filter_biquad_coeffs[6 * s];
+            st = &f->iir.state[4 * s];
+            for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+            {
+                acc = (int64_t)c[0] * buf[i] + (int64_t)c[2] * st[0] + (int64_t)c[3] * st[1] +
+                      (int64_t)c[4] * st[2] + (int64_t)c[5] * st[3];
+                st[1] = st[0];
+                st[0] = buf[i];
+                st[3] = st[2];
+                st[2] = filter_sat16(acc >> (15 - FILTER_BIQUAD_POSTSHIFT));
+                buf[i] = st[2];
+            }
+        }
+    }
+#endif
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        out[i] = filter_from_q15(buf[i]);
+    }
+    return ADC_BLOCK_SAMPLES;
+}
+
+static int filter_fir_decim(struct filter *f, const int16_t *in, int16_t *out)
+{
+    int16_t buf[ADC_BLOCK_SAMPLES];
+    int n_out = ADC_BLOCK_SAMPLES / f->cfg.len;
+    int i;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        buf[i] = (int16_t)(in[i] << FILTER_Q15_SHIFT);
+    }
+
+#if defined(CONFIG_CMSIS_DSP_FILTERING)
+    arm_fir_decimate_q15(&f->fir.inst, buf, buf, ADC_BLOCK_SAMPLES);
+#else
+    {
+        /* Same arithmetic as arm_fir_decimate_q15(): the state holds the last TAPS-1 inputs followed by the block */
+        int16_t *x = f->fir.state;
+        int64_t acc;
+        int n, j;
+
+        memcpy(&x[FILTER_FIR_TAPS - 1], buf, sizeof(buf));
+        for(i = 0; i < n_out; i++)
+        {
+            n = (i + 1) * f->cfg.len - 1;
+            acc = 0;
+            for(j = 0; j < FILTER_FIR_TAPS; j++)
+            {
+                acc += (int64_t)filter_fir_coeffs[j] * x[n + j];
+            }
+            buf[i] = filter_sat16(acc >> 15);
+        }
+        memmove(x, &x[ADC_BLOCK_SAMPLES], (FILTER_FIR_TAPS - 1) * sizeof(int16_t));
+    }
+#endif
+
+    for(i = 0; i < n_out; i++)
+    {
+        out[i] = filter_from_q15(buf[i]);
+    }
+    return n_out;
+}
+
+static int filter_cic(struct filter *f, const int16_t *in, int16_t *out)
+{
+    uint32_t y, tmp;
+    int i, s;
+    int n_out = 0;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        /* Integrators run at the input rate, wrap-around is harmless */
+        y = (uint32_t)(int32_t)in[i];
+        for(s = 0; s < FILTER_CIC_ORDER; s++)
+        {
+            f->cic.integ[s] += y;
+            y = f->cic.integ[s];
+        }
+
+        if(++f->cic.phase < f->cfg.len)
+        {
+            continue;
+        }
+        f->cic.phase = 0;
+
+        /* Combs run at the output rate */
+        for(s = 0; s < FILTER_CIC_ORDER; s++)
+        {
+            tmp = y;
+            y -= f->cic.comb[s];
+            f->cic.comb[s] = tmp;
+        }
+        out[n_out++] = (int16_t)((int32_t)y >> f->cic.shift);
+    }
+    return n_out;
+}
+
+int filter_run(struct filter *f, const int16_t *in, int16_t *out)
+{
+    if(!f->primed)
+    {
+        filter_prime(f, in[0]);
+    }
+
+    switch(f->cfg.type)
+    {
+        case FILTER_MOVING_AVG:
+            return filter_moving_avg(f, in, out);
+        case FILTER_MEDIAN:
+            return filter_median(f, in, out);
+        case FILTER_BIQUAD:
+            return filter_biquad(f, in, out);
+        case FILTER_FIR_DECIM:
+            return filter_fir_decim(f, in, out);
+        case FILTER_CIC:
+            return filter_cic(f, in, out);
+        default:
+            memcpy(out, in, ADC_BLOCK_SAMPLES * sizeof(int16_t));
+            return ADC_BLOCK_SAMPLES;
+    }
+}
+
+int filter_stage_init()
+{
+    int ch, ret;
+
+    for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+    {
+        ret = filter_init(&filter_chan[ch], &filter_cfg[ch]);
+        if(ret)
+        {
+            printk("filter_init() failed for channel %d with code %d\n\r", ch, ret);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int filter_channel(int ch, const struct adc_block *blk, int16_t *out)
+{
+    int16_t in[ADC_BLOCK_SAMPLES];
+    int i;
+
+    for(i = 0; i < ADC_BLOCK_SAMPLES; i++)
+    {
+        in[i] = blk->samples[i][ch];
+    }
+    return filter_run(&filter_chan[ch], in, out);
+}
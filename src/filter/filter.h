@@ -0,0 +1,138 @@
+/**
+ * \file filter.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Filtering and decimation stage between ADC acquisition and the database.
+ *
+ * Every scan list channel has one filter that runs on each block of raw
+ * samples: moving average, median-of-N, biquad low-pass IIR, FIR decimator
+ * or CIC decimator. The biquad and FIR kernels use the CMSIS-DSP q15
+ * functions when CONFIG_CMSIS_DSP_FILTERING is enabled (nRF52840) and
+ * equivalent portable C everywhere else (native_sim).
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include "adc.h"
+
+#if defined(CONFIG_CMSIS_DSP_FILTERING)
+#include <arm_math.h>
+#endif
+
+#define FILTER_MAX_LEN 32               /* Longest moving average window */
+#define FILTER_MEDIAN_MAX 9             /* Longest median window (odd) */
+#define FILTER_BIQUAD_STAGES 1          /* Biquad sections in the low-pass IIR */
+#define FILTER_FIR_TAPS 16              /* Taps of the decimating FIR */
+#define FILTER_CIC_ORDER 3              /* Integrator/comb pairs of the CIC decimator */
+
+/* Raw samples are scaled to use the whole q15 range inside the IIR and FIR kernels */
+#define FILTER_Q15_SHIFT (15 - ADC_RESOLUTION)
+
+/**
+ * \brief Available filter types.
+ */
+enum filter_type
+{
+    FILTER_NONE = 0,        /**< Samples pass through unchanged */
+    FILTER_MOVING_AVG,      /**< Moving average over len samples */
+    FILTER_MEDIAN,          /**< Median of the last len samples (len odd) */
+    FILTER_BIQUAD,          /**< Butterworth low-pass at fs/20 */
+    FILTER_FIR_DECIM,       /**< 16-tap low-pass FIR, keeps one sample out of len */
+    FILTER_CIC,             /**< Third-order CIC, keeps one sample out of len (power of two) */
+};
+
+/**
+ * \struct filter_cfg
+ * \brief Filter settings of one channel.
+ */
+struct filter_cfg
+{
+    enum filter_type type;  /**< Filter type */
+    uint8_t len;            /**< Window length (average, median) or decimation ratio (FIR, CIC) */
+};
+
+/**
+ * \struct filter
+ * \brief Filter instance: settings plus the history kept across blocks.
+ */
+struct filter
+{
+    struct filter_cfg cfg;
+    bool primed;            /**< History seeded with the first sample */
+    union
+    {
+        struct
+        {
+            int32_t sum;
+            uint8_t idx;
+            int16_t hist[FILTER_MAX_LEN];
+        } avg;
+        struct
+        {
+            uint8_t idx;
+            int16_t hist[FILTER_MEDIAN_MAX];
+        } med;
+        struct
+        {
+#if defined(CONFIG_CMSIS_DSP_FILTERING)
+            arm_biquad_casd_df1_inst_q15 inst;
+#endif
+            int16_t state[4 * FILTER_BIQUAD_STAGES];
+        } iir;
+        struct
+        {
+#if defined(CONFIG_CMSIS_DSP_FILTERING)
+            arm_fir_decimate_instance_q15 inst;
+#endif
+            int16_t state[FILTER_FIR_TAPS + ADC_BLOCK_SAMPLES - 1];
+        } fir;
+        struct
+        {
+            uint32_t integ[FILTER_CIC_ORDER];
+            uint32_t comb[FILTER_CIC_ORDER];
+            uint8_t phase;
+            uint8_t shift;
+        } cic;
+    };
+};
+
+extern const struct filter_cfg filter_cfg[ADC_SCAN_CHANNELS];   /**< Default filter of each channel */
+
+/**
+ * \brief Prepares a filter instance.
+ * \param f Instance to initialize.
+ * \param cfg Settings to use.
+ * \return 0 if successful, -EINVAL if the settings are out of range.
+ */
+int filter_init(struct filter *f, const struct filter_cfg *cfg);
+
+/**
+ * \brief Filters one block of samples.
+ *
+ * \param f Filter instance.
+ * \param in ADC_BLOCK_SAMPLES raw samples.
+ * \param out Destination, up to ADC_BLOCK_SAMPLES filtered samples.
+ * \return Number of samples written to out (less than ADC_BLOCK_SAMPLES for decimators).
+ */
+int filter_run(struct filter *f, const int16_t *in, int16_t *out);
+
+/**
+ * \brief Initializes the filter of every scan list channel from filter_cfg.
+ * \return 0 if successful, -EINVAL if a default setting is invalid.
+ */
+int filter_stage_init(void);
+
+/**
+ * \brief Filters one channel of a block through its channel filter.
+ *
+ * \param ch Scan list index.
+ * \param blk Source block.
+ * \param out Destination, up to ADC_BLOCK_SAMPLES filtered samples.
+ * \return Number of samples written to out.
+ */
+int filter_channel(int ch, const struct adc_block *blk, int16_t *out);
+
+#endif /* FILTER_H */
@@ -0,0 +1,673 @@
+/**
+ * \file hist.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Flash-backed data historian.
+ */
+
+#include <zephyr/fs/fcb.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include "hist.h"
+#include "adc.h"
+#include "proto.h"
+#include "uart.h"
+#include "codec.h"
+
+#define HIST_PARTITION FIXED_PARTITION_ID(storage_partition)
+#if FIXED_PARTITION_EXISTS(bench_partition)
+#define HIST_SCRATCH_PARTITION FIXED_PARTITION_ID(bench_partition)
+#elif FIXED_PARTITION_EXISTS(scratch_partition) && !defined(CONFIG_BOOTLOADER_MCUBOOT)
+#define HIST_SCRATCH_PARTITION FIXED_PARTITION_ID(scratch_partition)     /* Swap scratch, unused without MCUboot */
+#endif
+#define HIST_FCB_MAGIC 0x48495354       /* "HIST", sectors written by anything else are erased */
+
+/* Readback frame: req_id, opcode, status, block, crc */
+#define HIST_FRAME (3 + HIST_BLOCK_SIZE + 2)
+#define HIST_ENCODED (HIST_FRAME + HIST_FRAME / 254 + 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(HIST_RAM_BLOCKS), "HIST_RAM_BLOCKS must be a power of two");
+BUILD_ASSERT(IS_POWER_OF_TWO(HIST_MAX_SECTORS), "HIST_MAX_SECTORS must be a power of two");
+BUILD_ASSERT(HIST_BLOCK_SIZE % 8 == 0, "HIST_BLOCK_SIZE must be a multiple of the flash write size");
+BUILD_ASSERT(HIST_ENCODED + 2 <= UART_TX_FRAME_SIZE, "readback frame must fit in one TX frame");
+
+/**
+ * \struct hist_index_entry
+ * \brief An FCB sector in use and the time span of its blocks.
+ */
+struct hist_index_entry
+{
+    struct flash_sector *sector;
+    uint64_t first;         /**< HIST_TIME() of the first block */
+    uint64_t last;          /**< HIST_TIME() of the end of the last block */
+    uint32_t blocks;        /**< Blocks in the sector */
+};
+
+static struct fcb hist_fcb;
+static uint8_t hist_pack[HIST_BLOCK_SIZE] __aligned(4);    /* Block being written, packed */
+static struct flash_sector hist_sectors[HIST_MAX_SECTORS];
+static K_MUTEX_DEFINE(hist_flash_mutex);        /* FCB and index, held for a whole block write */
+static bool hist_ready;
+
+/* Index of the FCB sectors in use, oldest first. head and tail only grow:
+ * a sector erased and used again gets a new position. */
+static struct hist_index_entry hist_index[HIST_MAX_SECTORS];
+static uint32_t hist_index_head;
+static uint32_t hist_index_tail;
+static uint32_t hist_indexed;                   /* Blocks in the indexed sectors */
+
+/* RAM blocks: producers fill the one at head, the historian thread writes from tail */
+static uint8_t hist_ram[HIST_RAM_BLOCKS][HIST_BLOCK_SIZE] __aligned(4);
+static atomic_t hist_ram_head;
+static atomic_t hist_ram_tail;
+static int hist_fill;                           /* Records in the block at head */
+static uint32_t hist_first_ms;
+static uint32_t hist_last_ms;
+static struct k_spinlock hist_lock;             /* Filling state and counters */
+static struct k_sem hist_sem;                   /* Blocks sealed or readback queued */
+
+static uint16_t hist_boot;                      /* Incremented on every boot */
+static uint32_t hist_seq;
+static uint8_t hist_adc_div[ADC_SCAN_CHANNELS];
+
+static atomic_t hist_query_busy;
+static uint8_t hist_query_id;
+static uint64_t hist_query_from;
+static uint64_t hist_query_to;
+
+static struct hist_stats hist_stats;
+
+/* Scratch FCB of the write rate benchmark, never indexed */
+static struct fcb hist_scratch_fcb;
+static struct flash_sector hist_scratch_sectors[HIST_MAX_SECTORS];
+static struct hist_stats hist_scratch_stats;
+static bool hist_scratch_ready;
+
+static K_THREAD_STACK_DEFINE(hist_stack, HIST_STACK_SIZE);
+static struct k_thread hist_thread;
+
+/*
+ * Writes the header of the block at head and hands it to the historian thread.
+ * hist_lock must be held.
+ */
+static void hist_seal_locked(void)
+{
+    uint8_t *blk = hist_ram[atomic_get(&hist_ram_head) & (HIST_RAM_BLOCKS - 1)];
+
+    sys_put_le16(hist_boot, &blk[0]);
+    blk[2] = hist_fill;
+    blk[3] = 0;
+    sys_put_le32(hist_seq++, &blk[4]);
+    sys_put_le32(hist_first_ms, &blk[8]);
+    sys_put_le32(hist_last_ms, &blk[12]);
+    hist_fill = 0;
+    atomic_inc(&hist_ram_head);
+}
+
+void hist_log(enum hist_type type, uint8_t id, int16_t value)
+{
+    k_spinlock_key_t key;
+    uint32_t head;
+    uint8_t *rec;
+    bool sealed = false;
+
+    key = k_spin_lock(&hist_lock);
+    head = atomic_get(&hist_ram_head);
+    if(hist_fill == 0 && head - (uint32_t)atomic_get(&hist_ram_tail) >= HIST_RAM_BLOCKS)
+    {
+        hist_stats.dropped++;
+        k_spin_unlock(&hist_lock, key);
+        return;
+    }
+
+    hist_last_ms = k_uptime_get_32();
+    if(hist_fill == 0)
+    {
+        hist_first_ms = hist_last_ms;
+    }
+    rec = &hist_ram[head & (HIST_RAM_BLOCKS - 1)][HIST_HEADER_SIZE + hist_fill * HIST_RECORD_SIZE];
+    sys_put_le32(hist_last_ms, &rec[0]);
+    rec[4] = type;
+    rec[5] = id;
+    sys_put_le16((uint16_t)value, &rec[6]);
+    hist_stats.records++;
+
+    if(++hist_fill == HIST_BLOCK_RECORDS)
+    {
+        hist_seal_locked();
+        sealed = true;
+    }
+    k_spin_unlock(&hist_lock, key);
+
+    if(sealed)
+    {
+        k_sem_give(&hist_sem);
+    }
+}
+
+void hist_log_adc(int ch, int16_t raw)
+{
+    /* Only the ADC thread logs samples, the divider needs no lock */
+    if(hist_adc_div[ch] == 0)
+    {
+        hist_log(HIST_ADC, ch, raw);
+        hist_adc_div[ch] = HIST_SAMPLE_DIV;
+    }
+    hist_adc_div[ch]--;
+}
+
+/*
+ * Forgets a sector the FCB has erased. hist_flash_mutex must be held.
+ */
+static void hist_index_drop(struct flash_sector *sector)
+{
+    struct hist_index_entry *e;
+
+    while(hist_index_tail != hist_index_head)
+    {
+        e = &hist_index[hist_index_tail & (HIST_MAX_SECTORS - 1)];
+        if(e->sector != sector)
+        {
+            break;
+        }
+        hist_indexed -= e->blocks;
+        hist_index_tail++;
+    }
+}
+
+/*
+ * Indexes a block from its header: extends the span of its sector, or starts
+ * a new sector. Blocks come in FCB order. hist_flash_mutex must be held.
+ */
+static void hist_index_add(const struct fcb_entry *loc, const uint8_t *hdr)
+{
+    struct hist_index_entry *e = &hist_index[(hist_index_head - 1) & (HIST_MAX_SECTORS - 1)];
+    uint16_t boot = sys_get_le16(&hdr[0]);
+
+    if(hist_index_head == hist_index_tail || e->sector != loc->fe_sector)
+    {
+        if(hist_index_head - hist_index_tail == HIST_MAX_SECTORS)
+        {
+            hist_indexed -= hist_index[hist_index_tail & (HIST_MAX_SECTORS - 1)].blocks;
+            hist_index_tail++;
+        }
+        e = &hist_index[hist_index_head++ & (HIST_MAX_SECTORS - 1)];
+        e->sector = loc->fe_sector;
+        e->first = HIST_TIME(boot, sys_get_le32(&hdr[8]));
+        e->blocks = 0;
+    }
+    e->last = HIST_TIME(boot, sys_get_le32(&hdr[12]));
+    e->blocks++;
+    hist_indexed++;
+}
+
+/*
+ * Packs the records of a block column by column into hist_pack.
+ * Returns the packed length, or 0 if packing does not pay off. hist_flash_mutex must be held.
+ */
+static size_t hist_pack_block(const uint8_t *blk)
+{
+    static int32_t cols[4 * HIST_BLOCK_RECORDS];
+    const uint8_t *rec;
+    int count = MIN(blk[2], HIST_BLOCK_RECORDS);
+    int i, n;
+
+    for(i = 0; i < count; i++)
+    {
+        rec = &blk[HIST_HEADER_SIZE + i * HIST_RECORD_SIZE];
+        cols[i] = (int32_t)sys_get_le32(&rec[0]);
+        cols[count + i] = rec[4];
+        cols[2 * count + i] = rec[5];
+        cols[3 * count + i] = (int16_t)sys_get_le16(&rec[6]);
+    }
+
+    n = codec_encode(cols, 4 * count, CODEC_LZ4, &hist_pack[HIST_HEADER_SIZE], count * HIST_RECORD_SIZE);
+    if(n < 0 || ROUND_UP(n, 8) >= count * HIST_RECORD_SIZE)
+    {
+        return 0;
+    }
+
+    memcpy(hist_pack, blk, HIST_HEADER_SIZE);
+    hist_pack[3] |= HIST_PACKED;
+    memset(&hist_pack[HIST_HEADER_SIZE + n], 0, ROUND_UP(n, 8) - n);
+    return HIST_HEADER_SIZE + ROUND_UP(n, 8);
+}
+
+/*
+ * Packs a block and appends it to an FCB, erasing the oldest sector when the
+ * FCB is full. Blocks of the historian FCB are indexed (and forgotten with
+ * their sector); the write is counted in st. hist_flash_mutex must be held.
+ */
+static int hist_append(struct fcb *fcb, const uint8_t *blk, struct hist_stats *st)
+{
+    struct fcb_entry loc;
+    struct flash_sector *oldest;
+    bool indexed = (fcb == &hist_fcb);
+    uint16_t len, raw;
+    uint32_t start, cycles;
+    int rc;
+
+    start = k_cycle_get_32();
+
+    /* Packing is timed with the write, it is part of the cost of a block */
+    raw = HIST_HEADER_SIZE + MIN(blk[2], HIST_BLOCK_RECORDS) * HIST_RECORD_SIZE;
+    len = hist_pack_block(blk);
+    if(len > 0)
+    {
+        blk = hist_pack;
+    }
+    else
+    {
+        len = raw;
+    }
+
+    /* Full: erase the oldest sector and try again */
+    while((rc = fcb_append(fcb, len, &loc)) == -ENOSPC)
+    {
+        oldest = fcb->f_oldest;
+        rc = fcb_rotate(fcb);
+        if(rc != 0)
+        {
+            break;
+        }
+        st->erases++;
+        if(indexed)
+        {
+            hist_index_drop(oldest);
+        }
+    }
+    if(rc == 0)
+    {
+        rc = flash_area_write(fcb->fap, FCB_ENTRY_FA_DATA_OFF(loc), blk, len);
+    }
+    if(rc == 0)
+    {
+        rc = fcb_append_finish(fcb, &loc);
+    }
+
+    cycles = k_cycle_get_32() - start;
+    if(rc == 0)
+    {
+        if(indexed)
+        {
+            hist_index_add(&loc, blk);
+        }
+        st->blocks++;
+        st->bytes += len;
+        st->raw_bytes += raw;
+        st->write_sum += cycles;
+        st->write_max = MAX(st->write_max, cycles);
+    }
+    else
+    {
+        st->write_errors++;
+    }
+
+    return rc;
+}
+
+/*
+ * Writes one sealed block to the historian FCB.
+ */
+static int hist_write_block(const uint8_t *blk)
+{
+    int rc;
+
+    if(!hist_ready)
+    {
+        return -ENODEV;
+    }
+
+    k_mutex_lock(&hist_flash_mutex, K_FOREVER);
+    rc = hist_append(&hist_fcb, blk, &hist_stats);
+    k_mutex_unlock(&hist_flash_mutex);
+
+    return rc;
+}
+
+int hist_query(uint8_t req_id, uint64_t from, uint64_t to)
+{
+    if(!hist_ready)
+    {
+        return -ENODEV;
+    }
+    if(atomic_set(&hist_query_busy, 1))
+    {
+        return -EBUSY;
+    }
+
+    hist_query_id = req_id;
+    hist_query_from = from;
+    hist_query_to = to;
+    k_sem_give(&hist_sem);
+    return 0;
+}
+
+/*
+ * Sends one readback frame; an empty block ends the readback.
+ */
+static void hist_send(const uint8_t *blk, size_t len)
+{
+    static uint8_t frame[HIST_FRAME];
+    static uint8_t enc[HIST_ENCODED + 2];
+    size_t n;
+
+    frame[0] = hist_query_id;
+    frame[1] = PROTO_OP_HIST_BLOCK | PROTO_RESPONSE;
+    frame[2] = PROTO_OK;
+    if(len > 0)
+    {
+        memcpy(&frame[3], blk, len);
+    }
+    len += 3;
+    sys_put_le16(crc16_itu_t(0xFFFF, frame, len), &frame[len]);
+    len += 2;
+
+    enc[0] = 0;
+    n = cobs_encode(frame, len, &enc[1]);
+    enc[n + 1] = 0;
+    uart_tx_write(enc, n + 2);
+}
+
+/*
+ * Tells whether an FCB sector still holds what the index has at pos.
+ * hist_flash_mutex must be held.
+ */
+static bool hist_index_holds(uint32_t pos, struct flash_sector *sector)
+{
+    return (int32_t)(pos - hist_index_tail) >= 0 && pos != hist_index_head &&
+           hist_index[pos & (HIST_MAX_SECTORS - 1)].sector == sector;
+}
+
+/*
+ * Sends every block in flash that overlaps the queried range.
+ */
+static void hist_readback(void)
+{
+    static uint8_t blk[HIST_BLOCK_SIZE];
+    struct fcb_entry loc;
+    uint32_t lo, hi, mid, pos;
+    uint16_t boot;
+    int rc;
+
+    /* Sectors are indexed in time order: find the first one that ends at or after from */
+    k_mutex_lock(&hist_flash_mutex, K_FOREVER);
+    lo = hist_index_tail;
+    hi = hist_index_head;
+    while(lo != hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(hist_index[mid & (HIST_MAX_SECTORS - 1)].last < hist_query_from)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    pos = lo;
+    memset(&loc, 0, sizeof(loc));
+    loc.fe_sector = (pos != hist_index_head) ? hist_index[pos & (HIST_MAX_SECTORS - 1)].sector : NULL;
+    k_mutex_unlock(&hist_flash_mutex);
+
+    /* Then walk its blocks and the next ones in FCB order */
+    while(loc.fe_sector != NULL)
+    {
+        /* The flash is only held while one block is read, writes go on in between */
+        k_mutex_lock(&hist_flash_mutex, K_FOREVER);
+        if(!hist_index_holds(pos, loc.fe_sector))
+        {
+            /* Sector erased meanwhile, resume at the oldest block left */
+            pos = hist_index_tail;
+            memset(&loc, 0, sizeof(loc));
+        }
+        rc = fcb_getnext(&hist_fcb, &loc);
+        if(rc != 0)
+        {
+            k_mutex_unlock(&hist_flash_mutex);
+            break;
+        }
+        /* Blocks come in FCB order: the sector of this one is pos or a later one */
+        while(pos != hist_index_head && hist_index[pos & (HIST_MAX_SECTORS - 1)].sector != loc.fe_sector)
+        {
+            pos++;
+        }
+        if(pos == hist_index_head)
+        {
+            k_mutex_unlock(&hist_flash_mutex);
+            break;
+        }
+        if(loc.fe_data_len < HIST_HEADER_SIZE || loc.fe_data_len > HIST_BLOCK_SIZE ||
+           flash_area_read(hist_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), blk, loc.fe_data_len) != 0)
+        {
+            k_mutex_unlock(&hist_flash_mutex);
+            continue;
+        }
+        k_mutex_unlock(&hist_flash_mutex);
+
+        boot = sys_get_le16(&blk[0]);
+        if(HIST_TIME(boot, sys_get_le32(&blk[12])) < hist_query_from)
+        {
+            continue;
+        }
+        if(HIST_TIME(boot, sys_get_le32(&blk[8])) > hist_query_to)
+        {
+            break;
+        }
+        hist_send(blk, loc.fe_data_len);
+    }
+
+    hist_send(NULL, 0);
+    uart_tx_flush();
+    atomic_clear(&hist_query_busy);
+}
+
+/*
+ * Historian thread: moves sealed blocks to flash and serves readbacks.
+ */
+static void hist_thread_code(void *p1, void *p2, void *p3)
+{
+    k_spinlock_key_t key;
+    uint32_t tail;
+
+    while(1)
+    {
+        /* Nothing sealed for HIST_FLUSH_MS: seal what has been logged so far */
+        if(k_sem_take(&hist_sem, K_MSEC(HIST_FLUSH_MS)) != 0)
+        {
+            key = k_spin_lock(&hist_lock);
+            if(hist_fill > 0)
+            {
+                hist_seal_locked();
+            }
+            k_spin_unlock(&hist_lock, key);
+        }
+
+        for(tail = atomic_get(&hist_ram_tail); tail != (uint32_t)atomic_get(&hist_ram_head); tail++)
+        {
+            hist_write_block(hist_ram[tail & (HIST_RAM_BLOCKS - 1)]);
+            atomic_inc(&hist_ram_tail);
+        }
+
+        if(atomic_get(&hist_query_busy))
+        {
+            hist_readback();
+        }
+    }
+}
+
+/*
+ * Indexes a block left in flash by an earlier boot, at the times of its header.
+ */
+static int hist_walk_cb(struct fcb_entry_ctx *ctx, void *arg)
+{
+    uint8_t hdr[HIST_HEADER_SIZE];
+
+    if(ctx->loc.fe_data_len < HIST_HEADER_SIZE ||
+       flash_area_read(ctx->fap, FCB_ENTRY_FA_DATA_OFF(ctx->loc), hdr, sizeof(hdr)) != 0)
+    {
+        return 0;
+    }
+
+    hist_boot = MAX(hist_boot, sys_get_le16(&hdr[0]));
+    hist_seq = sys_get_le32(&hdr[4]) + 1;
+    hist_index_add(&ctx->loc, hdr);
+    return 0;
+}
+
+/*
+ * Erases a whole partition, for a first boot or a partition written by something else.
+ */
+static int hist_erase(int id)
+{
+    const struct flash_area *fa;
+    int rc;
+
+    rc = flash_area_open(id, &fa);
+    if(rc == 0)
+    {
+        rc = flash_area_erase(fa, 0, fa->fa_size);
+        flash_area_close(fa);
+    }
+    return rc;
+}
+
+int hist_init(void)
+{
+    uint32_t cnt = HIST_MAX_SECTORS;
+    int rc;
+
+    k_sem_init(&hist_sem, 0, K_SEM_MAX_LIMIT);
+
+    rc = flash_area_get_sectors(HIST_PARTITION, &cnt, hist_sectors);
+    if(rc != 0 || cnt < 2)
+    {
+        printk("hist: storage_partition unusable (%d)\n\r", rc);
+        return rc ? rc : -ENOSPC;
+    }
+
+    hist_fcb.f_magic = HIST_FCB_MAGIC;
+    hist_fcb.f_version = 1;
+    hist_fcb.f_sector_cnt = cnt;
+    hist_fcb.f_scratch_cnt = 0;
+    hist_fcb.f_sectors = hist_sectors;
+    rc = fcb_init(HIST_PARTITION, &hist_fcb);
+    if(rc != 0)
+    {
+        printk("hist: fcb_init() failed (%d), erasing storage_partition\n\r", rc);
+        rc = hist_erase(HIST_PARTITION);
+        if(rc == 0)
+        {
+            rc = fcb_init(HIST_PARTITION, &hist_fcb);
+        }
+        if(rc != 0)
+        {
+            return rc;
+        }
+    }
+
+    fcb_walk(&hist_fcb, NULL, hist_walk_cb, NULL);
+    if(hist_index_head != hist_index_tail)
+    {
+        hist_boot++;
+    }
+    hist_stats.sectors = cnt;
+    hist_ready = true;
+
+    k_thread_create(&hist_thread, hist_stack, K_THREAD_STACK_SIZEOF(hist_stack), hist_thread_code,
+                    NULL, NULL, NULL, HIST_PRIO, 0, K_NO_WAIT);
+    k_thread_name_set(&hist_thread, "hist");
+
+    return 0;
+}
+
+uint16_t hist_boot_get(void)
+{
+    return hist_boot;
+}
+
+void hist_get_stats(struct hist_stats *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&hist_lock);
+
+    *stats = hist_stats;
+    stats->indexed = hist_indexed;
+    k_spin_unlock(&hist_lock, key);
+}
+
+int hist_scratch_open(void)
+{
+#if defined(HIST_SCRATCH_PARTITION)
+    uint32_t cnt = HIST_MAX_SECTORS;
+    int rc;
+
+    rc = flash_area_get_sectors(HIST_SCRATCH_PARTITION, &cnt, hist_scratch_sectors);
+    if(rc != 0 || cnt < 2)
+    {
+        return rc ? rc : -ENOSPC;
+    }
+
+    /* Starts empty: whatever was there is not a historian */
+    rc = hist_erase(HIST_SCRATCH_PARTITION);
+    if(rc != 0)
+    {
+        return rc;
+    }
+    memset(&hist_scratch_fcb, 0, sizeof(hist_scratch_fcb));
+    hist_scratch_fcb.f_magic = HIST_FCB_MAGIC;
+    hist_scratch_fcb.f_version = 1;
+    hist_scratch_fcb.f_sector_cnt = cnt;
+    hist_scratch_fcb.f_scratch_cnt = 0;
+    hist_scratch_fcb.f_sectors = hist_scratch_sectors;
+    rc = fcb_init(HIST_SCRATCH_PARTITION, &hist_scratch_fcb);
+    if(rc != 0)
+    {
+        return rc;
+    }
+
+    memset(&hist_scratch_stats, 0, sizeof(hist_scratch_stats));
+    hist_scratch_stats.sectors = cnt;
+    hist_scratch_ready = true;
+    return 0;
+#else
+    return -ENODEV;
+#endif
+}
+
+int hist_scratch_write(const uint8_t *blk)
+{
+    int rc;
+
+    if(!hist_scratch_ready)
+    {
+        return -ENODEV;
+    }
+
+    /* Same mutex as the historian: one flash writer at a time */
+    k_mutex_lock(&hist_flash_mutex, K_FOREVER);
+    rc = hist_append(&hist_scratch_fcb, blk, &hist_scratch_stats);
+    k_mutex_unlock(&hist_flash_mutex);
+
+    return rc;
+}
+
+int hist_scratch_close(struct hist_stats *stats)
+{
+#if defined(HIST_SCRATCH_PARTITION)
+    if(!hist_scratch_ready)
+    {
+        return -ENODEV;
+    }
+
+    hist_scratch_ready = false;
+    if(stats != NULL)
+    {
+        *stats = hist_scratch_stats;
+    }
+    return hist_erase(HIST_SCRATCH_PARTITION);
+#else
+    return -ENODEV;
+#endif
+}
@@ -0,0 +1,162 @@
+/**
+ * \file hist.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Flash-backed data historian.
+ *
+ * ADC results, button events, output changes and alarms are logged as fixed-size
+ * records into RAM blocks of HIST_BLOCK_SIZE bytes. Producers only copy a
+ * record under a spinlock; they never touch the flash. A full block, or a
+ * partial one older than HIST_FLUSH_MS, is handed to the historian thread,
+ * which appends it to a flash circular buffer (FCB) on storage_partition
+ * and erases the oldest sector when the partition is full. When every RAM
+ * block is still waiting for the flash, new records are dropped and counted.
+ *
+ * Block layout, little endian:
+ *
+ *     boot(2) count(1) flags(1) seq(4) first_ms(4) last_ms(4) record * count
+ *
+ * Record layout, HIST_RECORD_SIZE bytes:
+ *
+ *     ms(4) type(1) id(1) value(2)
+ *
+ * with ms the uptime when the record was taken. Blocks are packed on their
+ * way to flash: with HIST_PACKED set in flags, the records are replaced by
+ * one codec block (codec.h) of their ms, type, id and value columns, padded
+ * to a multiple of 8 bytes.
+ *
+ * Times are (boot, ms) pairs, HIST_TIME(), ordered by boot first, so blocks
+ * left by earlier boots keep their place in time. A RAM index of the FCB
+ * sectors in use, rebuilt from the FCB at boot, holds the time span of the
+ * blocks in each one. A time range query finds the first sector that reaches
+ * the range with a binary search and walks the blocks from there, so the
+ * index never runs out of room however small the packed blocks get.
+ * Matching blocks are read back over the binary protocol
+ * (PROTO_OP_READ_HIST in proto.h).
+ */
+
+#ifndef HIST_H
+#define HIST_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define HIST_BLOCK_SIZE 256             /* Block size (in bytes), a multiple of the flash write size */
+#define HIST_HEADER_SIZE 16
+#define HIST_PACKED BIT(0)              /* Header flag: records stored through the block codec */
+#define HIST_RECORD_SIZE 8
+#define HIST_BLOCK_RECORDS ((HIST_BLOCK_SIZE - HIST_HEADER_SIZE) / HIST_RECORD_SIZE)
+#define HIST_RAM_BLOCKS 4               /* RAM blocks between producers and the flash (power of two) */
+#define HIST_MAX_SECTORS 16             /* Flash sectors used from storage_partition (power of two) */
+#define HIST_FLUSH_MS 5000              /* Oldest record a partial block may hold */
+#define HIST_SAMPLE_DIV 8               /* Log one ADC result out of HIST_SAMPLE_DIV per channel */
+#define HIST_PRIO 14                    /* Historian thread, below every periodic task */
+#define HIST_STACK_SIZE 1536
+
+#define HIST_TIME(boot, ms) (((uint64_t)(boot) << 32) | (uint32_t)(ms))     /* Time of a record across boots */
+
+/**
+ * \brief Record types.
+ */
+enum hist_type
+{
+    HIST_ADC = 0,           /**< id: scan list index, value: raw counts */
+    HIST_BUTTONS,           /**< id: pressed mask, value: changed mask */
+    HIST_OUTPUTS,           /**< id: output image, value: 0 */
+    HIST_ALARM,             /**< id: alarm_cfg index, value: 1 tripped, 0 cleared */
+};
+
+/**
+ * \struct hist_stats
+ * \brief Counters of the historian.
+ */
+struct hist_stats
+{
+    uint32_t records;       /**< Records logged */
+    uint32_t dropped;       /**< Records lost because every RAM block was taken */
+    uint32_t blocks;        /**< Blocks written to flash */
+    uint32_t bytes;         /**< Bytes written to flash, after packing */
+    uint32_t raw_bytes;     /**< What the same blocks would have taken unpacked */
+    uint32_t write_errors;  /**< Blocks lost on a flash error */
+    uint32_t erases;        /**< Sectors erased to make room (wear is erases / sectors) */
+    uint32_t sectors;       /**< Sectors in the FCB */
+    uint32_t indexed;       /**< Blocks currently indexed */
+    uint32_t write_max;     /**< Longest block write (in cycles) */
+    uint64_t write_sum;     /**< Cycles spent writing blocks */
+};
+
+/**
+ * \brief Mounts the FCB, rebuilds the block index and starts the historian thread.
+ * \return 0 if successful, negative value if the flash could not be used.
+ */
+int hist_init(void);
+
+/**
+ * \brief Logs one record.
+ *
+ * Safe to call from any thread and from interrupts; never waits for the flash.
+ *
+ * \param type Record type.
+ * \param id Type dependent identifier.
+ * \param value Type dependent value.
+ */
+void hist_log(enum hist_type type, uint8_t id, int16_t value);
+
+/**
+ * \brief Logs an ADC result, keeping one out of HIST_SAMPLE_DIV per channel.
+ * \param ch Scan list index.
+ * \param raw Raw conversion result.
+ */
+void hist_log_adc(int ch, int16_t raw);
+
+/**
+ * \brief Queues a readback of the blocks that overlap a time range.
+ *
+ * The historian thread sends every matching block in one PROTO_OP_HIST_BLOCK
+ * frame tagged with req_id, then an empty one.
+ *
+ * \param req_id Request id echoed in the frames.
+ * \param from Start of the range, HIST_TIME().
+ * \param to End of the range, HIST_TIME().
+ * \return 0 if queued, -EBUSY if a readback is running, -ENODEV without a historian.
+ */
+int hist_query(uint8_t req_id, uint64_t from, uint64_t to);
+
+/**
+ * \brief Returns the boot number of this run, the one in the blocks it writes.
+ */
+uint16_t hist_boot_get(void);
+
+/**
+ * \brief Mounts an empty scratch FCB for the write rate benchmark (bench.c).
+ *
+ * The scratch FCB lives on bench_partition, or on the swap scratch partition
+ * when the board has no bench_partition and the build no MCUboot. Blocks are
+ * packed and sectors rotated as in the historian, but nothing is indexed and
+ * the historian partition is never touched.
+ *
+ * \return 0 if successful, -ENODEV without a scratch partition, negative value on a flash error.
+ */
+int hist_scratch_open(void);
+
+/**
+ * \brief Writes one block to the scratch FCB, from the caller's thread.
+ * \param blk HIST_BLOCK_SIZE bytes laid out as a block, header included.
+ * \return 0 if successful, -ENODEV if not open, negative value on a flash error.
+ */
+int hist_scratch_write(const uint8_t *blk);
+
+/**
+ * \brief Erases the scratch partition.
+ * \param stats Destination of the counters of the writes since hist_scratch_open(), may be NULL.
+ * \return 0 if successful, -ENODEV if not open, negative value on a flash error.
+ */
+int hist_scratch_close(struct hist_stats *stats);
+
+/**
+ * \brief Copies the historian counters.
+ * \param stats Destination of the counters.
+ */
+void hist_get_stats(struct hist_stats *stats);
+
+#endif /* HIST_H */
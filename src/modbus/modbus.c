@@ -0,0 +1,206 @@
+/**
+ * \file modbus.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Modbus RTU server exposing the database on the console UART.
+ */
+
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include "modbus.h"
+#include "uart.h"
+#include "threads.h"
+
+#define MODBUS_CRC(buf, len) crc16_reflect(0xA001, 0xFFFF, (buf), (len))
+
+/**
+ * \struct modbus_image
+ * \brief Everything a read can return, in wire order.
+ */
+struct modbus_image
+{
+    uint8_t inputs;                                 /* Discrete inputs, bit i = input i */
+    uint8_t coils;                                  /* Coils, bit i = coil i */
+    uint8_t input_regs[2 * MODBUS_NUM_INPUT_REGS];  /* Big endian */
+};
+
+/* Double-buffered image: the task fills the spare one, then publishes it */
+static struct modbus_image modbus_images[2];
+static atomic_ptr_t modbus_image = ATOMIC_PTR_INIT(&modbus_images[0]);
+static struct modbus_stats modbus_stats;
+static uint8_t modbus_rsp[MODBUS_MAX_ADU];
+static atomic_t modbus_last_ms;         /* Uptime of the last frame received */
+static atomic_t modbus_seen;            /* Set once a frame has been received */
+
+void modbus_image_job(void)
+{
+    struct modbus_image *img = (atomic_ptr_get(&modbus_image) == &modbus_images[0]) ? &modbus_images[1] : &modbus_images[0];
+    struct db_snapshot snap;
+    int32_t v;
+    int i;
+
+    db_read(&snap);
+    img->inputs = db_snap_bits(&snap, TAG_BUTTON1, NUM_BUTTONS);
+    img->coils = db_snap_bits(&snap, TAG_OUTPUT1, NUM_OUTPUTS);
+
+    for(i = 0; i < ADC_SCAN_CHANNELS; i++)
+    {
+        v = CLAMP(db_snap_value(&snap, TAG_ADC(i)), INT16_MIN, INT16_MAX);
+        sys_put_be16((uint16_t)v, &img->input_regs[2 * i]);
+        sys_put_be16((uint16_t)db_snap_value(&snap, TAG_ADC_RAW(i)), &img->input_regs[2 * (ADC_SCAN_CHANNELS + i)]);
+    }
+    for(i = 0; i < NUM_PERIODS; i++)
+    {
+        sys_put_be32(period_get(i), &img->input_regs[2 * (2 * ADC_SCAN_CHANNELS) + 4 * i]);
+    }
+
+    atomic_ptr_set(&modbus_image, img);
+}
+
+/*
+ * Packs count bits of src, starting at bit start, the Modbus way (first bit in the LSB).
+ */
+static uint8_t modbus_bits(uint8_t src, uint16_t start, uint16_t count)
+{
+    return (src >> start) & BIT_MASK(count);
+}
+
+/*
+ * Executes a request. Writes the response PDU (function code onwards) into
+ * rsp and returns its length, or returns the exception code as a negative value.
+ */
+static int modbus_execute(const uint8_t *pdu, size_t len, uint8_t *rsp)
+{
+    const struct modbus_image *img = atomic_ptr_get(&modbus_image);
+    uint8_t fc = pdu[0];
+    uint16_t addr, count, value;
+
+    /* An unsupported function is reported as such, whatever its length */
+    switch(fc)
+    {
+        case MODBUS_FC_READ_COILS:
+        case MODBUS_FC_READ_DISCRETE_INPUTS:
+        case MODBUS_FC_READ_INPUT_REGS:
+        case MODBUS_FC_WRITE_COIL:
+        case MODBUS_FC_WRITE_COILS:
+            break;
+        default:
+            return -MODBUS_EX_ILLEGAL_FUNCTION;
+    }
+    if(len < 5)
+    {
+        return -MODBUS_EX_ILLEGAL_VALUE;
+    }
+    addr = sys_get_be16(&pdu[1]);
+    count = sys_get_be16(&pdu[3]);
+    rsp[0] = fc;
+
+    switch(fc)
+    {
+        case MODBUS_FC_READ_COILS:
+        case MODBUS_FC_READ_DISCRETE_INPUTS:
+            if(len != 5 || count == 0)
+            {
+                return -MODBUS_EX_ILLEGAL_VALUE;
+            }
+            if(addr + count > MODBUS_NUM_BITS)
+            {
+                return -MODBUS_EX_ILLEGAL_ADDRESS;
+            }
+            rsp[1] = 1;
+            rsp[2] = modbus_bits((fc == MODBUS_FC_READ_COILS) ? img->coils : img->inputs, addr, count);
+            return 3;
+
+        case MODBUS_FC_READ_INPUT_REGS:
+            if(len != 5 || count == 0 || count > 125)
+            {
+                return -MODBUS_EX_ILLEGAL_VALUE;
+            }
+            if(addr + count > MODBUS_NUM_INPUT_REGS)
+            {
+                return -MODBUS_EX_ILLEGAL_ADDRESS;
+            }
+            rsp[1] = 2 * count;
+            memcpy(&rsp[2], &img->input_regs[2 * addr], 2 * count);
+            return 2 + 2 * count;
+
+        case MODBUS_FC_WRITE_COIL:
+            /* count holds the value here: 0xFF00 on, 0x0000 off */
+            value = count;
+            if(len != 5 || (value != 0xFF00 && value != 0x0000))
+            {
+                return -MODBUS_EX_ILLEGAL_VALUE;
+            }
+            if(addr >= MODBUS_NUM_BITS)
+            {
+                return -MODBUS_EX_ILLEGAL_ADDRESS;
+            }
+            if(outputs_request(value ? OUTPUT_OP_SET : OUTPUT_OP_CLEAR, BIT(addr), 0) != 0)
+            {
+                return -MODBUS_EX_DEVICE_FAILURE;
+            }
+            memcpy(&rsp[1], &pdu[1], 4);
+            return 5;
+
+        case MODBUS_FC_WRITE_COILS:
+            if(len != 7 || count == 0 || pdu[5] != 1)
+            {
+                return -MODBUS_EX_ILLEGAL_VALUE;
+            }
+            if(addr + count > MODBUS_NUM_BITS)
+            {
+                return -MODBUS_EX_ILLEGAL_ADDRESS;
+            }
+            /* All coils of the request switch together */
+            if(outputs_request(OUTPUT_OP_WRITE, BIT_MASK(count) << addr, (uint32_t)pdu[6] << addr) != 0)
+            {
+                return -MODBUS_EX_DEVICE_FAILURE;
+            }
+            memcpy(&rsp[1], &pdu[1], 4);
+            return 5;
+
+        default:
+            return -MODBUS_EX_ILLEGAL_FUNCTION;
+    }
+}
+
+bool modbus_active(void)
+{
+    return atomic_get(&modbus_seen) && (k_uptime_get_32() - (uint32_t)atomic_get(&modbus_last_ms)) < MODBUS_QUIET_MS;
+}
+
+void modbus_handle_frame(const uint8_t *adu, size_t len)
+{
+    int n;
+
+    atomic_set(&modbus_last_ms, k_uptime_get_32());
+    atomic_set(&modbus_seen, 1);
+
+    if(len < 4 || len > MODBUS_MAX_ADU || MODBUS_CRC(adu, len - 2) != sys_get_le16(&adu[len - 2]))
+    {
+        modbus_stats.crc_errors++;
+        return;
+    }
+
+    modbus_rsp[0] = MODBUS_ADDR;
+    n = modbus_execute(&adu[1], len - 3, &modbus_rsp[1]);
+    if(n < 0)
+    {
+        modbus_rsp[1] = adu[1] | 0x80;
+        modbus_rsp[2] = -n;
+        n = 2;
+        modbus_stats.exceptions++;
+    }
+    n += 1;
+    sys_put_le16(MODBUS_CRC(modbus_rsp, n), &modbus_rsp[n]);
+    n += 2;
+
+    uart_tx_write(modbus_rsp, n);
+    uart_tx_flush();
+    modbus_stats.requests++;
+}
+
+void modbus_get_stats(struct modbus_stats *stats)
+{
+    *stats = modbus_stats;
+}
@@ -0,0 +1,106 @@
+/**
+ * \file modbus.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Modbus RTU server exposing the database on the console UART.
+ *
+ * A request starts with MODBUS_ADDR, a byte that neither the ASCII console
+ * nor the binary protocol ever sends first, and ends with a silent interval
+ * of t3.5 (the UART RX timeout, see uart.h). It is accepted only if its
+ * CRC is valid. Broadcast (address 0) is not supported because 0x00 opens
+ * binary protocol frames.
+ *
+ * Register map:
+ *
+ *     Discrete inputs 0..3    BUTTON1..BUTTON4
+ *     Coils 0..3              OUTPUT1..OUTPUT4 (writes go through outputs_request())
+ *     Input registers 0..3    ADC channel values (milli-units, signed, saturated to 16 bits)
+ *     Input registers 4..7    ADC channel raw counts
+ *     Input registers 8..15   Periods in us, two registers each (high word first):
+ *                             UI, ADC, outputs, debounce (enum period_id)
+ *
+ * Reads are served from a register image packed once per MODBUS_IMAGE_PERIOD_US
+ * by the modbus task, already in wire (big endian) order.
+ */
+
+#ifndef MODBUS_H
+#define MODBUS_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include "adc.h"
+
+#define MODBUS_ADDR 1                   /* Server address */
+#define MODBUS_MAX_ADU 256              /* Largest RTU frame */
+#define MODBUS_IMAGE_PERIOD_US 10000    /* Register image refresh period */
+#define MODBUS_QUIET_MS 3000            /* The UI stays quiet this long after the last frame */
+
+#define MODBUS_NUM_BITS 4               /* Discrete inputs and coils */
+#define MODBUS_NUM_INPUT_REGS (2 * ADC_SCAN_CHANNELS + 8)
+
+/**
+ * \brief Function codes served.
+ */
+enum modbus_fc
+{
+    MODBUS_FC_READ_COILS = 0x01,
+    MODBUS_FC_READ_DISCRETE_INPUTS = 0x02,
+    MODBUS_FC_READ_INPUT_REGS = 0x04,
+    MODBUS_FC_WRITE_COIL = 0x05,
+    MODBUS_FC_WRITE_COILS = 0x0F,
+};
+
+/**
+ * \brief Exception codes.
+ */
+enum modbus_exception
+{
+    MODBUS_EX_NONE = 0,
+    MODBUS_EX_ILLEGAL_FUNCTION = 0x01,
+    MODBUS_EX_ILLEGAL_ADDRESS = 0x02,
+    MODBUS_EX_ILLEGAL_VALUE = 0x03,
+    MODBUS_EX_DEVICE_FAILURE = 0x04,
+};
+
+/**
+ * \struct modbus_stats
+ * \brief Counters kept by the server.
+ */
+struct modbus_stats
+{
+    uint32_t requests;      /**< Requests answered (exceptions included) */
+    uint32_t exceptions;    /**< Exception responses */
+    uint32_t crc_errors;    /**< Frames dropped for a bad CRC or length */
+};
+
+/**
+ * \brief Handles one request and sends the response.
+ *
+ * Called by the UART command parser with the bytes received between two t3.5
+ * silences, the first of them being MODBUS_ADDR. Runs in thread context.
+ *
+ * \param adu Request, address to CRC included.
+ * \param len Length of adu.
+ */
+void modbus_handle_frame(const uint8_t *adu, size_t len);
+
+/**
+ * \brief Tells whether a frame was received in the last MODBUS_QUIET_MS.
+ *
+ * The UI does not redraw meanwhile, so its escape sequences never land in
+ * the middle of a master's polling.
+ */
+bool modbus_active(void);
+
+/**
+ * \brief Packs the register image, run by the scheduler every MODBUS_IMAGE_PERIOD_US.
+ */
+void modbus_image_job(void);
+
+/**
+ * \brief Copies the server counters.
+ * \param stats Destination of the counters.
+ */
+void modbus_get_stats(struct modbus_stats *stats);
+
+#endif /* MODBUS_H */
@@ -0,0 +1,228 @@
+/**
+ * \file pid.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Fixed-point PID loop from an ADC channel to a PWM output.
+ */
+
+#include <zephyr/drivers/pwm.h>
+#include "pid.h"
+#include "adc.h"
+#include "conv.h"
+
+#define PID_Q 16                        /* Fractional bits of gains, integrator and plant state */
+#define PID_RAW_FRAC 8                  /* Fractional bits of the filtered measurement */
+
+#if DT_NODE_EXISTS(DT_ALIAS(pid_pwm))
+static const struct pwm_dt_spec pid_pwm = PWM_DT_SPEC_GET(DT_ALIAS(pid_pwm));
+static bool pid_pwm_ready;
+static uint32_t pid_pwm_duty = UINT32_MAX;     /* Duty the PWM runs at */
+#endif
+
+static struct k_spinlock pid_lock;     /* Guards the parameters, the gains and the stats */
+static int32_t pid_params[NUM_PID_PARAMS] = {
+    [PID_KP] = 1000,
+    [PID_KI] = 20000,
+    [PID_KD] = 0,
+    [PID_SETPOINT] = 1500,
+};
+
+/* Gains in Q16 per mille per milli-unit, per iteration */
+static int32_t pid_kp_q;
+static int32_t pid_ki_q;
+static int32_t pid_kd_q;
+
+/* Loop state, only touched by the job (and by pid_start() under the lock) */
+static int32_t pid_filt;                /* Filtered raw measurement, PID_RAW_FRAC fractional bits */
+static int32_t pid_plant;               /* Plant model output (milli-units, Q16) */
+static int64_t pid_integ;               /* Integral term (per mille, Q16) */
+static int32_t pid_y_prev;
+static uint32_t pid_last;               /* k_cycle_get_32() of the previous iteration */
+static bool pid_primed;
+static struct pid_stats pid_stats;
+
+/*
+ * Derives the per-iteration Q16 gains from the parameters. Called with the lock held.
+ */
+static void pid_gains_update(void)
+{
+    pid_kp_q = (int32_t)(((int64_t)pid_params[PID_KP] << PID_Q) / 1000);
+    pid_ki_q = (int32_t)(((int64_t)pid_params[PID_KI] << PID_Q) * PID_PERIOD_US / (1000LL * 1000000));
+    pid_kd_q = (int32_t)(((int64_t)pid_params[PID_KD] << PID_Q) * 1000000 / (1000LL * PID_PERIOD_US));
+}
+
+/*
+ * Writes the duty to the PWM output, if there is one.
+ */
+static void pid_output(uint32_t duty)
+{
+#if DT_NODE_EXISTS(DT_ALIAS(pid_pwm))
+    if(pid_pwm_ready && duty != pid_pwm_duty)
+    {
+        pid_pwm_duty = duty;
+        pwm_set_dt(&pid_pwm, PID_PWM_PERIOD_NS, (uint32_t)((uint64_t)PID_PWM_PERIOD_NS * duty / PID_DUTY_MAX));
+    }
+#endif
+}
+
+int pid_init(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&pid_lock);
+
+    pid_gains_update();
+    k_spin_unlock(&pid_lock, key);
+
+#if DT_NODE_EXISTS(DT_ALIAS(pid_pwm))
+    pid_pwm_ready = pwm_is_ready_dt(&pid_pwm);
+    if(pid_pwm_ready)
+    {
+        return 0;
+    }
+#endif
+    printk("PID: no PWM output, the loop only drives its stats\n\r");
+    return -ENODEV;
+}
+
+int pid_start(enum pid_mode mode)
+{
+    k_spinlock_key_t key;
+
+    if(mode > PID_PLANT)
+    {
+        return -EINVAL;
+    }
+
+    key = k_spin_lock(&pid_lock);
+    memset(&pid_stats, 0, sizeof(pid_stats));
+    pid_stats.mode = mode;
+    pid_stats.setpoint = pid_params[PID_SETPOINT];
+    pid_stats.period_min = UINT32_MAX;
+    pid_integ = 0;
+    pid_plant = 0;
+    pid_primed = false;
+    k_spin_unlock(&pid_lock, key);
+
+    if(mode == PID_OFF)
+    {
+        pid_output(0);
+    }
+    return 0;
+}
+
+int pid_set(enum pid_param p, int32_t value)
+{
+    k_spinlock_key_t key;
+
+    if(p >= NUM_PID_PARAMS)
+    {
+        return -EINVAL;
+    }
+
+    key = k_spin_lock(&pid_lock);
+    pid_params[p] = value;
+    pid_gains_update();
+    k_spin_unlock(&pid_lock, key);
+    return 0;
+}
+
+int32_t pid_get(enum pid_param p)
+{
+    return (p < NUM_PID_PARAMS) ? pid_params[p] : 0;
+}
+
+void pid_job(void)
+{
+    k_spinlock_key_t key;
+    int32_t kp, ki, kd, sp, y, e, band;
+    int64_t u_q, u_raw;
+    int32_t u;
+    uint32_t now = k_cycle_get_32();
+    uint8_t mode;
+
+    key = k_spin_lock(&pid_lock);
+    mode = pid_stats.mode;
+    kp = pid_kp_q;
+    ki = pid_ki_q;
+    kd = pid_kd_q;
+    sp = pid_params[PID_SETPOINT];
+    k_spin_unlock(&pid_lock, key);
+
+    if(mode == PID_OFF)
+    {
+        return;
+    }
+
+    /* Measurement */
+    if(mode == PID_PLANT)
+    {
+        y = pid_plant >> PID_Q;
+    }
+    else
+    {
+        if(!pid_primed)
+        {
+            pid_filt = (int32_t)adc_latest(PID_CHANNEL) << PID_RAW_FRAC;
+        }
+        pid_filt += (((int32_t)adc_latest(PID_CHANNEL) << PID_RAW_FRAC) - pid_filt) >> PID_FILTER_SHIFT;
+        y = conv_apply(PID_CHANNEL, (pid_filt + BIT(PID_RAW_FRAC - 1)) >> PID_RAW_FRAC);
+    }
+    if(!pid_primed)
+    {
+        pid_y_prev = y;
+    }
+
+    /* u = P + I + D, the derivative on the measurement */
+    e = sp - y;
+    u_q = (int64_t)kp * e + pid_integ - (int64_t)kd * (y - pid_y_prev);
+    pid_y_prev = y;
+    u_raw = u_q >> PID_Q;
+    u = (int32_t)CLAMP(u_raw, 0, PID_DUTY_MAX);
+
+    /* Anti-windup: no integration while saturated in the direction of the error */
+    if(!(u_raw > PID_DUTY_MAX && e > 0) && !(u_raw < 0 && e < 0))
+    {
+        pid_integ = CLAMP(pid_integ + (int64_t)ki * e, 0, (int64_t)PID_DUTY_MAX << PID_Q);
+    }
+
+    if(mode == PID_PLANT)
+    {
+        /* First order: tau * dy/dt = gain * u - y */
+        pid_plant += (int32_t)((((int64_t)PID_PLANT_GAIN_MV * u / PID_DUTY_MAX << PID_Q) - pid_plant) *
+                               PID_PERIOD_US / PID_PLANT_TAU_US);
+    }
+    pid_output(u);
+
+    /* Stats */
+    band = (int32_t)((int64_t)(sp < 0 ? -sp : sp) * PID_SETTLE_BAND / 1000);
+    key = k_spin_lock(&pid_lock);
+    if(pid_primed)
+    {
+        pid_stats.period_min = MIN(pid_stats.period_min, now - pid_last);
+        pid_stats.period_max = MAX(pid_stats.period_max, now - pid_last);
+    }
+    pid_stats.jobs++;
+    pid_stats.setpoint = sp;
+    pid_stats.y = y;
+    pid_stats.y_max = pid_primed ? MAX(pid_stats.y_max, y) : y;
+    pid_stats.duty = u;
+    if(e > band || e < -band)
+    {
+        pid_stats.settled_at = pid_stats.jobs;
+    }
+    if(u != u_raw)
+    {
+        pid_stats.saturated++;
+    }
+    k_spin_unlock(&pid_lock, key);
+
+    pid_last = now;
+    pid_primed = true;
+}
+
+void pid_get_stats(struct pid_stats *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&pid_lock);
+
+    *stats = pid_stats;
+    k_spin_unlock(&pid_lock, key);
+}
@@ -0,0 +1,125 @@
+/**
+ * \file pid.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Fixed-point PID loop from an ADC channel to a PWM output.
+ *
+ * pid_job() is released every PID_PERIOD_US by the scheduler (TASK_PID). It
+ * takes the latest raw sample of PID_CHANNEL straight from the ADC engine,
+ * low-pass filters it (first order, 2^-PID_FILTER_SHIFT), converts it to
+ * milli-units and runs
+ *
+ *     u = Kp * e + I - Kd * dy / T,    I += Ki * T * e
+ *
+ * with e = setpoint - y, all in Q16 integer arithmetic. The derivative acts
+ * on the measurement so setpoint changes do not kick the output. u is a duty
+ * cycle in per mille, clamped to [0, PID_DUTY_MAX]; the integrator stops
+ * while the output is saturated in the direction of the error (anti-windup)
+ * and is clamped to the output range.
+ *
+ * The duty drives the pid-pwm alias when the board has it, a pin of its own:
+ * never one of the LEDs, which outputs_config() owns as GPIO outputs (on the
+ * DK, boards/nrf52840dk_nrf52840.overlay puts it on P1.10). With PID_PLANT
+ * the measurement comes from a first-order plant model fed by the duty
+ * instead of the ADC, which is how the loop is tested (tests/bench).
+ */
+
+#ifndef PID_H
+#define PID_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define PID_PERIOD_US 1000              /* Loop period */
+#define PID_CHANNEL 0                   /* Scan list index of the measurement (potentiometer) */
+#define PID_FILTER_SHIFT 2              /* Measurement low-pass, cutoff about fs / (2 pi 2^shift) */
+#define PID_DUTY_MAX 1000               /* Full duty (per mille) */
+#define PID_SETTLE_BAND 20              /* Settled within this many per mille of the setpoint */
+#define PID_PWM_PERIOD_NS 100000        /* PWM period, 10 kHz */
+
+#define PID_PLANT_GAIN_MV 3000          /* Plant model: output at full duty */
+#define PID_PLANT_TAU_US 50000          /* Plant model: time constant */
+
+/**
+ * \brief Loop modes.
+ */
+enum pid_mode
+{
+    PID_OFF = 0,            /**< Loop stopped, output at 0 */
+    PID_ADC,                /**< Measurement from PID_CHANNEL */
+    PID_PLANT,              /**< Measurement from the plant model */
+};
+
+/**
+ * \brief Tunable parameters, set with pid_set().
+ */
+enum pid_param
+{
+    PID_KP = 0,             /**< Proportional gain, 1/1000 per mille of duty per milli-unit */
+    PID_KI,                 /**< Integral gain, same unit per second */
+    PID_KD,                 /**< Derivative gain, same unit times second */
+    PID_SETPOINT,           /**< Setpoint, milli-units */
+    NUM_PID_PARAMS
+};
+
+/**
+ * \struct pid_stats
+ * \brief State and timing of the loop since the last pid_start().
+ */
+struct pid_stats
+{
+    uint8_t mode;           /**< Current mode (enum pid_mode) */
+    int32_t setpoint;       /**< Setpoint (milli-units) */
+    int32_t y;              /**< Last filtered measurement (milli-units) */
+    int32_t y_max;          /**< Largest measurement (milli-units) */
+    uint32_t duty;          /**< Last duty (per mille) */
+    uint32_t jobs;          /**< Loop iterations */
+    uint32_t settled_at;    /**< Iteration after which y stayed in the settle band */
+    uint32_t saturated;     /**< Iterations with the output clamped */
+    uint32_t period_min;    /**< Shortest time between two iterations (cycles) */
+    uint32_t period_max;    /**< Longest time between two iterations (cycles) */
+};
+
+/**
+ * \brief Binds the PWM output, if the board has one.
+ * \return 0 if successful, -ENODEV without a PWM output (the loop still runs).
+ */
+int pid_init(void);
+
+/**
+ * \brief Starts, restarts or stops the loop.
+ *
+ * Clears the integrator, the filter and the stats.
+ *
+ * \param mode Measurement source, or PID_OFF.
+ * \return 0 if successful, -EINVAL for an unknown mode.
+ */
+int pid_start(enum pid_mode mode);
+
+/**
+ * \brief Changes a parameter, from the next iteration on.
+ * \param p Parameter.
+ * \param value New value (see enum pid_param).
+ * \return 0 if successful, -EINVAL for an unknown parameter.
+ */
+int pid_set(enum pid_param p, int32_t value);
+
+/**
+ * \brief Returns a parameter.
+ * \param p Parameter.
+ * \return Current value.
+ */
+int32_t pid_get(enum pid_param p);
+
+/**
+ * \brief Runs one loop iteration. Job of TASK_PID.
+ */
+void pid_job(void);
+
+/**
+ * \brief Copies the loop state and timing.
+ * \param stats Destination.
+ */
+void pid_get_stats(struct pid_stats *stats);
+
+#endif /* PID_H */
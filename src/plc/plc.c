@@ -0,0 +1,398 @@
+/**
+ * \file plc.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief PLC-style scan engine running uploaded bytecode on a process image.
+ */
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/atomic.h>
+#include "plc.h"
+#include "threads.h"
+#include "adc.h"
+
+/*
+ * Decoding and checking rules of each opcode: operand bytes, stack effect and
+ * the bound of the index operand (0 if the first operand is not an index).
+ */
+static const struct {
+    uint8_t size;
+    uint8_t pops;
+    uint8_t pushes;
+    uint8_t limit;
+} plc_ops[NUM_PLC_OPS] = {
+    [PLC_END] = { 0, 0, 0, 0 },
+    [PLC_LD_IN] = { 1, 0, 1, NUM_BUTTONS },
+    [PLC_LD_OUT] = { 1, 0, 1, NUM_OUTPUTS },
+    [PLC_LD_M] = { 1, 0, 1, PLC_MARKERS },
+    [PLC_LD_ADC] = { 1, 0, 1, ADC_SCAN_CHANNELS },
+    [PLC_PUSH] = { 4, 0, 1, 0 },
+    [PLC_AND] = { 0, 2, 1, 0 },
+    [PLC_OR] = { 0, 2, 1, 0 },
+    [PLC_XOR] = { 0, 2, 1, 0 },
+    [PLC_NOT] = { 0, 1, 1, 0 },
+    [PLC_GT] = { 0, 2, 1, 0 },
+    [PLC_GE] = { 0, 2, 1, 0 },
+    [PLC_LT] = { 0, 2, 1, 0 },
+    [PLC_LE] = { 0, 2, 1, 0 },
+    [PLC_EQ] = { 0, 2, 1, 0 },
+    [PLC_NE] = { 0, 2, 1, 0 },
+    [PLC_ST_OUT] = { 1, 1, 0, NUM_OUTPUTS },
+    [PLC_ST_M] = { 1, 1, 0, PLC_MARKERS },
+    [PLC_TON] = { 3, 1, 1, PLC_TIMERS },
+    [PLC_TOF] = { 3, 1, 1, PLC_TIMERS },
+    [PLC_CTU] = { 3, 1, 1, PLC_COUNTERS },
+    [PLC_RES] = { 1, 1, 0, PLC_COUNTERS },
+};
+
+/* Process image, latched at the start of each scan */
+static struct {
+    uint32_t in;                        /* Buttons (bit i = button i+1) */
+    uint32_t out;                       /* Outputs (bit i = output i+1), written by the program */
+    int32_t adc[ADC_SCAN_CHANNELS];     /* ADC values (milli-units) */
+    uint32_t now;                       /* k_uptime_get_32() */
+} plc_img;
+
+/* Program state, cleared on every swap */
+static int32_t plc_markers[PLC_MARKERS];
+static struct {
+    uint32_t start;         /* Time of the last edge of the input */
+    bool in;                /* Input at the previous scan */
+    bool q;
+} plc_timers[PLC_TIMERS];
+static struct {
+    int32_t count;
+    bool cu;                /* Input at the previous scan */
+} plc_counters[PLC_COUNTERS];
+
+/* Double-buffered program: the scan runs plc_progs[plc_cur], swaps compile into the other one */
+static struct plc_prog plc_progs[2];
+static atomic_t plc_cur;
+static atomic_t plc_next = ATOMIC_INIT(-1);    /* Buffer the scan takes at its next start, -1 for none */
+static uint8_t plc_code[PLC_MAX_CODE];         /* Uploaded bytecode */
+
+static struct k_spinlock plc_lock;             /* Guards the stats */
+static struct plc_stats plc_stats;
+
+/*
+ * The interpreter. With labels set, only exports the handler address of
+ * every opcode (computed goto labels are local to their function).
+ */
+static void plc_exec(const struct plc_prog *prog, const void *const **labels)
+{
+    static const void *const handlers[NUM_PLC_OPS] = {
+        [PLC_END] = &&op_end,
+        [PLC_LD_IN] = &&op_ld_in,
+        [PLC_LD_OUT] = &&op_ld_out,
+        [PLC_LD_M] = &&op_ld_m,
+        [PLC_LD_ADC] = &&op_ld_adc,
+        [PLC_PUSH] = &&op_push,
+        [PLC_AND] = &&op_and,
+        [PLC_OR] = &&op_or,
+        [PLC_XOR] = &&op_xor,
+        [PLC_NOT] = &&op_not,
+        [PLC_GT] = &&op_gt,
+        [PLC_GE] = &&op_ge,
+        [PLC_LT] = &&op_lt,
+        [PLC_LE] = &&op_le,
+        [PLC_EQ] = &&op_eq,
+        [PLC_NE] = &&op_ne,
+        [PLC_ST_OUT] = &&op_st_out,
+        [PLC_ST_M] = &&op_st_m,
+        [PLC_TON] = &&op_ton,
+        [PLC_TOF] = &&op_tof,
+        [PLC_CTU] = &&op_ctu,
+        [PLC_RES] = &&op_res,
+    };
+    int32_t stack[PLC_STACK + 1];
+    int32_t *sp = stack;                /* Top of the stack, stack[0] is never used */
+    const struct plc_insn *ip;
+    bool in;
+
+    if(labels != NULL)
+    {
+        *labels = handlers;
+        return;
+    }
+
+/* plc_compile() checked every operand and the stack depth, nothing is checked here */
+#define PLC_NEXT() goto *(++ip)->handler
+#define PLC_BINARY(expr) do { sp--; *sp = (expr); PLC_NEXT(); } while(0)
+
+    ip = prog->insn;
+    goto *ip->handler;
+
+op_ld_in:
+    *++sp = (plc_img.in >> ip->a) & 1;
+    PLC_NEXT();
+op_ld_out:
+    *++sp = (plc_img.out >> ip->a) & 1;
+    PLC_NEXT();
+op_ld_m:
+    *++sp = plc_markers[ip->a];
+    PLC_NEXT();
+op_ld_adc:
+    *++sp = plc_img.adc[ip->a];
+    PLC_NEXT();
+op_push:
+    *++sp = ip->a;
+    PLC_NEXT();
+op_and:
+    PLC_BINARY(sp[0] && sp[1]);
+op_or:
+    PLC_BINARY(sp[0] || sp[1]);
+op_xor:
+    PLC_BINARY(!sp[0] != !sp[1]);
+op_not:
+    *sp = !*sp;
+    PLC_NEXT();
+op_gt:
+    PLC_BINARY(sp[0] > sp[1]);
+op_ge:
+    PLC_BINARY(sp[0] >= sp[1]);
+op_lt:
+    PLC_BINARY(sp[0] < sp[1]);
+op_le:
+    PLC_BINARY(sp[0] <= sp[1]);
+op_eq:
+    PLC_BINARY(sp[0] == sp[1]);
+op_ne:
+    PLC_BINARY(sp[0] != sp[1]);
+op_st_out:
+    plc_img.out = (plc_img.out & ~BIT(ip->a)) | ((uint32_t)(*sp-- != 0) << ip->a);
+    PLC_NEXT();
+op_st_m:
+    plc_markers[ip->a] = *sp--;
+    PLC_NEXT();
+op_ton:
+    /* q rises once in held for the preset, falls with in */
+    in = (*sp != 0);
+    if(in && !plc_timers[ip->a].in)
+    {
+        plc_timers[ip->a].start = plc_img.now;
+    }
+    plc_timers[ip->a].q = in && (plc_img.now - plc_timers[ip->a].start >= (uint32_t)ip->b);
+    plc_timers[ip->a].in = in;
+    *sp = plc_timers[ip->a].q;
+    PLC_NEXT();
+op_tof:
+    /* q rises with in, falls once in stayed off for the preset */
+    in = (*sp != 0);
+    if(!in && plc_timers[ip->a].in)
+    {
+        plc_timers[ip->a].start = plc_img.now;
+    }
+    plc_timers[ip->a].q = in || (plc_timers[ip->a].q && plc_img.now - plc_timers[ip->a].start < (uint32_t)ip->b);
+    plc_timers[ip->a].in = in;
+    *sp = plc_timers[ip->a].q;
+    PLC_NEXT();
+op_ctu:
+    in = (*sp != 0);
+    if(in && !plc_counters[ip->a].cu && plc_counters[ip->a].count < INT32_MAX)
+    {
+        plc_counters[ip->a].count++;
+    }
+    plc_counters[ip->a].cu = in;
+    *sp = (plc_counters[ip->a].count >= ip->b);
+    PLC_NEXT();
+op_res:
+    if(*sp-- != 0)
+    {
+        plc_counters[ip->a].count = 0;
+    }
+    PLC_NEXT();
+op_end:
+    return;
+
+#undef PLC_BINARY
+#undef PLC_NEXT
+}
+
+int plc_compile(const uint8_t *code, size_t len, struct plc_prog *prog)
+{
+    const void *const *handlers;
+    struct plc_insn *insn;
+    size_t pc = 0;
+    uint32_t mask = 0;
+    int depth = 0;
+    int n = 0;
+    uint8_t op;
+
+    plc_exec(NULL, &handlers);
+    while(pc < len && n < PLC_MAX_INSNS)
+    {
+        op = code[pc];
+        if(op >= NUM_PLC_OPS || pc + 1 + plc_ops[op].size > len)
+        {
+            return -EINVAL;
+        }
+        if(depth < plc_ops[op].pops || depth - plc_ops[op].pops + plc_ops[op].pushes > PLC_STACK)
+        {
+            return -EINVAL;
+        }
+        depth += plc_ops[op].pushes - plc_ops[op].pops;
+
+        insn = &prog->insn[n++];
+        insn->handler = handlers[op];
+        insn->a = 0;
+        insn->b = 0;
+        if(op == PLC_PUSH)
+        {
+            insn->a = (int32_t)sys_get_le32(&code[pc + 1]);
+        }
+        else if(plc_ops[op].size > 0)
+        {
+            insn->a = code[pc + 1];
+            if(insn->a >= plc_ops[op].limit)
+            {
+                return -EINVAL;
+            }
+        }
+        if(plc_ops[op].size == 3)
+        {
+            insn->b = sys_get_le16(&code[pc + 2]);
+        }
+        if(op == PLC_ST_OUT)
+        {
+            mask |= BIT(insn->a);
+        }
+        pc += 1 + plc_ops[op].size;
+
+        if(op == PLC_END)
+        {
+            /* Nothing may follow END */
+            if(pc != len)
+            {
+                return -EINVAL;
+            }
+            prog->len = n;
+            prog->out_mask = mask;
+            return 0;
+        }
+    }
+    return -EINVAL;
+}
+
+void plc_run(const struct plc_prog *prog)
+{
+    plc_exec(prog, NULL);
+}
+
+int plc_write(uint16_t offset, const uint8_t *data, size_t len)
+{
+    if((size_t)offset + len > PLC_MAX_CODE)
+    {
+        return -EINVAL;
+    }
+    memcpy(&plc_code[offset], data, len);
+    return 0;
+}
+
+int plc_swap(uint16_t len)
+{
+    k_spinlock_key_t key;
+    int buf;
+
+    if(len > PLC_MAX_CODE)
+    {
+        return -EINVAL;
+    }
+    /* Once the scan took the last swap it only runs plc_cur, the other buffer is free */
+    if(atomic_get(&plc_next) >= 0)
+    {
+        return -EBUSY;
+    }
+    buf = 1 - atomic_get(&plc_cur);
+
+    if(len == 0)
+    {
+        plc_progs[buf].len = 0;
+        plc_progs[buf].out_mask = 0;
+    }
+    else if(plc_compile(plc_code, len, &plc_progs[buf]) != 0)
+    {
+        key = k_spin_lock(&plc_lock);
+        plc_stats.load_errors++;
+        k_spin_unlock(&plc_lock, key);
+        return -EINVAL;
+    }
+
+    atomic_set(&plc_next, buf);
+    key = k_spin_lock(&plc_lock);
+    plc_stats.loads++;
+    k_spin_unlock(&plc_lock, key);
+    return 0;
+}
+
+void plc_scan(void)
+{
+    const struct plc_prog *prog;
+    struct db_snapshot snap;
+    k_spinlock_key_t key;
+    uint32_t start = k_cycle_get_32();
+    uint32_t image, dt;
+    int next;
+    int ch;
+
+    /*
+     * Program swap, at the scan boundary. plc_next is only cleared once
+     * plc_cur names the new buffer, so plc_swap() never sees the running
+     * buffer as free.
+     */
+    next = (int)atomic_get(&plc_next);
+    if(next >= 0)
+    {
+        atomic_set(&plc_cur, next);
+        atomic_cas(&plc_next, next, -1);
+        memset(plc_markers, 0, sizeof(plc_markers));
+        memset(plc_timers, 0, sizeof(plc_timers));
+        memset(plc_counters, 0, sizeof(plc_counters));
+        key = k_spin_lock(&plc_lock);
+        plc_stats.scan_max = 0;
+        plc_stats.insns = plc_progs[next].len;
+        plc_stats.out_mask = plc_progs[next].out_mask;
+        k_spin_unlock(&plc_lock, key);
+    }
+    prog = &plc_progs[atomic_get(&plc_cur)];
+    if(prog->len == 0)
+    {
+        return;
+    }
+
+    /* Input image */
+    db_read(&snap);
+    plc_img.in = db_snap_bits(&snap, TAG_BUTTON1, NUM_BUTTONS);
+    for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+    {
+        plc_img.adc[ch] = db_snap_value(&snap, TAG_ADC(ch));
+    }
+    plc_img.out = outputs_image_get();
+    plc_img.now = k_uptime_get_32();
+    image = plc_img.out;
+
+    plc_run(prog);
+
+    /* Output image: every owned output in one request, so they change together */
+    if(((plc_img.out ^ image) & prog->out_mask) != 0 &&
+       outputs_request(OUTPUT_OP_WRITE, prog->out_mask, plc_img.out) != 0)
+    {
+        key = k_spin_lock(&plc_lock);
+        plc_stats.out_errors++;
+        k_spin_unlock(&plc_lock, key);
+    }
+
+    dt = k_cycle_get_32() - start;
+    key = k_spin_lock(&plc_lock);
+    plc_stats.scans++;
+    plc_stats.scan_last = dt;
+    plc_stats.scan_max = MAX(plc_stats.scan_max, dt);
+    k_spin_unlock(&plc_lock, key);
+}
+
+void plc_get_stats(struct plc_stats *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&plc_lock);
+
+    *stats = plc_stats;
+    k_spin_unlock(&plc_lock, key);
+}
@@ -0,0 +1,178 @@
+/**
+ * \file plc.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief PLC-style scan engine running uploaded bytecode on a process image.
+ *
+ * plc_scan() is released every PLC_SCAN_US by the scheduler (TASK_PLC). A
+ * scan latches the buttons, the ADC values and the output image into the
+ * input image, runs the active program once from top to bottom and writes
+ * the outputs the program owns in one OUTPUT_OP_WRITE request, so they all
+ * change together, and only when one of them changed.
+ *
+ * A program is a stack machine bytecode, one opcode byte followed by its
+ * operands (little endian):
+ *
+ *     op      operands        stack
+ *     LD_IN   n(1)            -> button n
+ *     LD_OUT  n(1)            -> output n (as written so far in this scan)
+ *     LD_M    n(1)            -> marker n
+ *     LD_ADC  ch(1)           -> value of ADC channel ch (milli-units)
+ *     PUSH    v(4)            -> v
+ *     AND OR XOR              a b -> a op b (boolean)
+ *     NOT                     a -> !a
+ *     GT GE LT LE EQ NE       a b -> a op b (signed compare)
+ *     ST_OUT  n(1)            a -> (output n = a != 0)
+ *     ST_M    n(1)            a -> (marker n = a)
+ *     TON     t(1) ms(2)      in -> q, on-delay timer t
+ *     TOF     t(1) ms(2)      in -> q, off-delay timer t
+ *     CTU     c(1) pv(2)      cu -> q, counts the rising edges of cu, q = count >= pv
+ *     RES     c(1)            r -> , clears counter c while r
+ *     END                     last instruction
+ *
+ * There are no jumps, so a scan runs every instruction exactly once and its
+ * time is bounded by the program length. plc_compile() checks the operands
+ * and the stack depth of every instruction once, at load time, and turns the
+ * bytecode into a direct-threaded list (one handler address per
+ * instruction); the interpreter then does no decoding and no checks.
+ *
+ * Programs are uploaded in chunks over the binary protocol (PROTO_OP_PLC_WRITE)
+ * and installed with PROTO_OP_PLC_SWAP, which compiles them into the program
+ * buffer the scan is not running. The scan switches buffers at its next
+ * start, so the engine never stops. Timers, counters and markers restart
+ * from zero with the new program.
+ */
+
+#ifndef PLC_H
+#define PLC_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define PLC_SCAN_US 10000               /* Scan period */
+#define PLC_MAX_CODE 1024               /* Largest bytecode program */
+#define PLC_MAX_INSNS 256               /* Largest program, in instructions */
+#define PLC_STACK 16                    /* Evaluation stack depth */
+#define PLC_MARKERS 32                  /* Internal bits/words (LD_M, ST_M) */
+#define PLC_TIMERS 16                   /* TON/TOF timers */
+#define PLC_COUNTERS 16                 /* CTU counters */
+
+/**
+ * \brief Bytecode opcodes.
+ */
+enum plc_op
+{
+    PLC_END = 0x00,
+    PLC_LD_IN = 0x01,
+    PLC_LD_OUT = 0x02,
+    PLC_LD_M = 0x03,
+    PLC_LD_ADC = 0x04,
+    PLC_PUSH = 0x05,
+    PLC_AND = 0x06,
+    PLC_OR = 0x07,
+    PLC_XOR = 0x08,
+    PLC_NOT = 0x09,
+    PLC_GT = 0x0A,
+    PLC_GE = 0x0B,
+    PLC_LT = 0x0C,
+    PLC_LE = 0x0D,
+    PLC_EQ = 0x0E,
+    PLC_NE = 0x0F,
+    PLC_ST_OUT = 0x10,
+    PLC_ST_M = 0x11,
+    PLC_TON = 0x12,
+    PLC_TOF = 0x13,
+    PLC_CTU = 0x14,
+    PLC_RES = 0x15,
+    NUM_PLC_OPS
+};
+
+/**
+ * \struct plc_insn
+ * \brief One compiled instruction.
+ */
+struct plc_insn
+{
+    const void *handler;    /**< Interpreter label of the opcode */
+    int32_t a;              /**< First operand (index or immediate) */
+    int32_t b;              /**< Second operand (timer/counter preset) */
+};
+
+/**
+ * \struct plc_prog
+ * \brief A compiled program.
+ */
+struct plc_prog
+{
+    uint16_t len;                           /**< Instructions, including END (0: no program) */
+    uint8_t out_mask;                       /**< Outputs written by the program (bit i = output i+1) */
+    struct plc_insn insn[PLC_MAX_INSNS];    /**< Direct-threaded code */
+};
+
+/**
+ * \struct plc_stats
+ * \brief Counters and timing of the scan engine.
+ */
+struct plc_stats
+{
+    uint32_t scans;         /**< Scans run with a program */
+    uint32_t scan_last;     /**< Duration of the last scan (cycles) */
+    uint32_t scan_max;      /**< Longest scan since the last swap (cycles) */
+    uint16_t insns;         /**< Instructions of the running program */
+    uint8_t out_mask;       /**< Outputs owned by the running program */
+    uint32_t loads;         /**< Programs installed */
+    uint32_t load_errors;   /**< Programs rejected by plc_swap() */
+    uint32_t out_errors;    /**< Output writes lost because the outputs queue was full */
+};
+
+/**
+ * \brief Compiles a bytecode program.
+ * \param code Bytecode.
+ * \param len Length of code.
+ * \param prog Destination.
+ * \return 0 if successful, -EINVAL for a bad opcode or operand, a stack
+ *         overflow or underflow, a missing END or too many instructions.
+ */
+int plc_compile(const uint8_t *code, size_t len, struct plc_prog *prog);
+
+/**
+ * \brief Runs a compiled program once on the current process image.
+ *
+ * Used by plc_scan() and the benchmarks; the caller latches the image.
+ *
+ * \param prog Compiled program, with at least one instruction.
+ */
+void plc_run(const struct plc_prog *prog);
+
+/**
+ * \brief Stores a chunk of an uploaded program.
+ * \param offset Position of the chunk in the program.
+ * \param data Chunk.
+ * \param len Length of the chunk.
+ * \return 0 if successful, -EINVAL if the chunk does not fit in PLC_MAX_CODE.
+ */
+int plc_write(uint16_t offset, const uint8_t *data, size_t len);
+
+/**
+ * \brief Compiles the uploaded program and hands it to the scan.
+ *
+ * The scan starts running it at its next release. Thread context only.
+ *
+ * \param len Length of the uploaded program, 0 to unload the program.
+ * \return 0 if successful, -EINVAL for an invalid program, -EBUSY if the
+ *         previous swap was not taken by the scan yet.
+ */
+int plc_swap(uint16_t len);
+
+/**
+ * \brief Runs one scan. Job of TASK_PLC.
+ */
+void plc_scan(void);
+
+/**
+ * \brief Copies the engine counters.
+ * \param stats Destination.
+ */
+void plc_get_stats(struct plc_stats *stats);
+
+#endif /* PLC_H */
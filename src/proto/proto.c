@@ -0,0 +1,369 @@
+/**
+ * \file proto.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Binary command/response protocol for pollers, sharing the UART with the ASCII console.
+ */
+
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include "proto.h"
+#include "uart.h"
+#include "threads.h"
+#include "adc.h"
+#include "hist.h"
+#include "plc.h"
+#include "wstats.h"
+
+BUILD_ASSERT(NUM_WSTATS_WINDOWS * 20 <= PROTO_MAX_RESPONSE, "every window must fit in one response");
+
+static struct proto_stats proto_stats;
+
+/*
+ * Stores the aggregates of one window as count, min, max, mean, std.
+ */
+static void proto_put_wstats(const struct wstats_result *ws, uint8_t *rsp)
+{
+    sys_put_le32(ws->count, &rsp[0]);
+    sys_put_le32((uint32_t)ws->min, &rsp[4]);
+    sys_put_le32((uint32_t)ws->max, &rsp[8]);
+    sys_put_le32((uint32_t)ws->mean, &rsp[12]);
+    sys_put_le32((uint32_t)ws->std, &rsp[16]);
+}
+
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_pos = 0;    /* Where the code byte of the current block goes */
+    size_t o = 1;
+    uint8_t code = 1;
+
+    for(size_t i = 0; i < len; i++)
+    {
+        if(in[i] != 0)
+        {
+            out[o++] = in[i];
+            code++;
+        }
+        if(in[i] == 0 || code == 0xFF)
+        {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+
+    return o;
+}
+
+int cobs_decode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0;
+    size_t o = 0;
+    uint8_t code;
+
+    while(i < len)
+    {
+        code = in[i++];
+        if(code == 0 || i + code - 1 > len)
+        {
+            return -EINVAL;
+        }
+        for(uint8_t k = 1; k < code; k++)
+        {
+            out[o++] = in[i++];
+        }
+        /* A block shorter than 254 data bytes stands for a zero, except at the end */
+        if(code != 0xFF && i < len)
+        {
+            out[o++] = 0;
+        }
+    }
+
+    return (int)o;
+}
+
+/*
+ * Executes a request. Fills the response payload and returns its status.
+ */
+static uint8_t proto_execute(uint8_t req_id, uint8_t opcode, const uint8_t *req, size_t len,
+                             uint8_t *rsp, size_t *rsp_len)
+{
+    struct db_snapshot snap;
+    struct db_tag_info tag;
+    uint16_t ids[PROTO_MAX_CHANGES];
+    enum db_tag next;
+    int i, n;
+    struct plc_stats plc;
+    struct wstats_result ws;
+    uint32_t seq;
+    uint64_t from, to;
+    int ch;
+
+    *rsp_len = 0;
+    switch(opcode)
+    {
+        case PROTO_OP_PING:
+            return PROTO_OK;
+
+        case PROTO_OP_READ_DB:
+            if(len != 0)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            db_read(&snap);
+            rsp[0] = db_snap_bits(&snap, TAG_BUTTON1, NUM_BUTTONS);
+            rsp[1] = db_snap_bits(&snap, TAG_OUTPUT1, NUM_OUTPUTS);
+            sys_put_le32((uint32_t)db_snap_value(&snap, TAG_ADC(ADC_POT_CHANNEL)), &rsp[2]);
+            *rsp_len = 6;
+            return PROTO_OK;
+
+        case PROTO_OP_WRITE_OUTPUTS:
+            if(len != 3)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            switch(outputs_request(req[0], req[1], req[2]))
+            {
+                case 0:
+                    return PROTO_OK;
+                case -EINVAL:
+                    return PROTO_ERR_ARG;
+                default:
+                    return PROTO_ERR_BUSY;
+            }
+
+        case PROTO_OP_READ_PERIOD:
+            if(len != 1)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            if(req[0] >= NUM_PERIODS)
+            {
+                return PROTO_ERR_ARG;
+            }
+            sys_put_le32(period_get(req[0]), rsp);
+            *rsp_len = 4;
+            return PROTO_OK;
+
+        case PROTO_OP_WRITE_PERIOD:
+            if(len != 5)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            if(period_set(req[0], sys_get_le32(&req[1])) != 0)
+            {
+                return PROTO_ERR_ARG;
+            }
+            return PROTO_OK;
+
+        case PROTO_OP_READ_ADC:
+            if(len != 1)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            ch = req[0];
+            if(ch >= ADC_SCAN_CHANNELS)
+            {
+                return PROTO_ERR_ARG;
+            }
+            seq = db_read(&snap);
+            sys_put_le32((uint32_t)db_snap_value(&snap, TAG_ADC(ch)), &rsp[0]);
+            sys_put_le16((uint16_t)db_snap_value(&snap, TAG_ADC_RAW(ch)), &rsp[4]);
+            sys_put_le32(seq, &rsp[6]);
+            *rsp_len = 10;
+            return PROTO_OK;
+
+        case PROTO_OP_READ_HIST:
+            if(len == 8)
+            {
+                /* Times of this boot */
+                from = HIST_TIME(hist_boot_get(), sys_get_le32(&req[0]));
+                to = HIST_TIME(hist_boot_get(), sys_get_le32(&req[4]));
+            }
+            else if(len == 12)
+            {
+                from = HIST_TIME(sys_get_le16(&req[0]), sys_get_le32(&req[2]));
+                to = HIST_TIME(sys_get_le16(&req[6]), sys_get_le32(&req[8]));
+            }
+            else
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            /* The blocks follow this response, sent by the historian thread */
+            switch(hist_query(req_id, from, to))
+            {
+                case 0:
+                    return PROTO_OK;
+                case -EBUSY:
+                    return PROTO_ERR_BUSY;
+                default:
+                    return PROTO_ERR_ARG;
+            }
+
+        case PROTO_OP_PLC_WRITE:
+            if(len < 3)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            if(plc_write(sys_get_le16(&req[0]), &req[2], len - 2) != 0)
+            {
+                return PROTO_ERR_ARG;
+            }
+            return PROTO_OK;
+
+        case PROTO_OP_PLC_SWAP:
+            if(len != 2)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            switch(plc_swap(sys_get_le16(&req[0])))
+            {
+                case 0:
+                    return PROTO_OK;
+                case -EBUSY:
+                    return PROTO_ERR_BUSY;
+                default:
+                    return PROTO_ERR_ARG;
+            }
+
+        case PROTO_OP_PLC_STATS:
+            if(len != 0)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            plc_get_stats(&plc);
+            sys_put_le32(plc.scans, &rsp[0]);
+            sys_put_le32(k_cyc_to_us_floor32(plc.scan_last), &rsp[4]);
+            sys_put_le32(k_cyc_to_us_floor32(plc.scan_max), &rsp[8]);
+            sys_put_le16(plc.insns, &rsp[12]);
+            sys_put_le32(plc.loads, &rsp[14]);
+            sys_put_le32(plc.load_errors, &rsp[18]);
+            *rsp_len = 22;
+            return PROTO_OK;
+
+        case PROTO_OP_READ_STATS:
+            if(len != 2)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            if(wstats_get(req[0], req[1], &ws) != 0)
+            {
+                return PROTO_ERR_ARG;
+            }
+            proto_put_wstats(&ws, rsp);
+            *rsp_len = 20;
+            return PROTO_OK;
+
+        case PROTO_OP_READ_STATS_ALL:
+            if(len != 1)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            if(req[0] >= ADC_SCAN_CHANNELS)
+            {
+                return PROTO_ERR_ARG;
+            }
+            for(i = 0; i < NUM_WSTATS_WINDOWS; i++)
+            {
+                wstats_get(req[0], i, &ws);
+                proto_put_wstats(&ws, &rsp[20 * i]);
+            }
+            *rsp_len = 20 * NUM_WSTATS_WINDOWS;
+            return PROTO_OK;
+
+        case PROTO_OP_READ_TAG:
+            if(len != 2)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            if(db_get(sys_get_le16(&req[0]), &tag) != 0)
+            {
+                return PROTO_ERR_ARG;
+            }
+            rsp[0] = tag.type;
+            rsp[1] = tag.quality;
+            sys_put_le32((uint32_t)tag.value, &rsp[2]);
+            sys_put_le32(tag.timestamp, &rsp[6]);
+            sys_put_le32(tag.seq, &rsp[10]);
+            *rsp_len = 14;
+            return PROTO_OK;
+
+        case PROTO_OP_READ_CHANGES:
+            if(len != 6)
+            {
+                return PROTO_ERR_LENGTH;
+            }
+            if(sys_get_le16(&req[4]) > DB_NUM_TAGS)
+            {
+                return PROTO_ERR_ARG;
+            }
+            /* Counter first: a change racing with the scan shows up again next time */
+            sys_put_le32(db_change_count(), &rsp[0]);
+            n = db_changed(sys_get_le32(&req[0]), sys_get_le16(&req[4]), ids, PROTO_MAX_CHANGES, &next);
+            sys_put_le16(next, &rsp[4]);
+            for(i = 0; i < n; i++)
+            {
+                sys_put_le16(ids[i], &rsp[6 + 6 * i]);
+                sys_put_le32((uint32_t)db_value(ids[i]), &rsp[8 + 6 * i]);
+            }
+            *rsp_len = 6 + 6 * n;
+            return PROTO_OK;
+
+        default:
+            return PROTO_ERR_OPCODE;
+    }
+}
+
+void proto_handle_frame(uint8_t *buf, size_t len)
+{
+    static uint8_t rsp[PROTO_MAX_FRAME];
+    static uint8_t enc[PROTO_MAX_ENCODED + 2];
+    size_t rsp_len;
+    size_t n;
+    int dec;
+
+    if(len == 0)
+    {
+        /* Back-to-back delimiters */
+        return;
+    }
+    if(len > PROTO_MAX_ENCODED)
+    {
+        proto_stats.framing_errors++;
+        return;
+    }
+
+    dec = cobs_decode(buf, len, buf);
+    if(dec < 4 || dec > 2 + PROTO_MAX_PAYLOAD + 2)
+    {
+        proto_stats.framing_errors++;
+        return;
+    }
+    if(crc16_itu_t(0xFFFF, buf, dec - 2) != sys_get_le16(&buf[dec - 2]))
+    {
+        proto_stats.crc_errors++;
+        return;
+    }
+
+    /* Response: req_id, opcode | PROTO_RESPONSE, status, payload, crc */
+    rsp[0] = buf[0];
+    rsp[1] = buf[1] | PROTO_RESPONSE;
+    rsp[2] = proto_execute(buf[0], buf[1], &buf[2], dec - 4, &rsp[3], &rsp_len);
+    rsp_len += 3;
+    sys_put_le16(crc16_itu_t(0xFFFF, rsp, rsp_len), &rsp[rsp_len]);
+    rsp_len += 2;
+
+    enc[0] = 0;
+    n = cobs_encode(rsp, rsp_len, &enc[1]);
+    enc[n + 1] = 0;
+    uart_tx_write(enc, n + 2);
+    uart_tx_flush();
+
+    proto_stats.frames++;
+}
+
+void proto_get_stats(struct proto_stats *stats)
+{
+    *stats = proto_stats;
+}
@@ -0,0 +1,121 @@
+/**
+ * \file proto.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Binary command/response protocol for pollers, sharing the UART with the ASCII console.
+ *
+ * A request is 0x00, COBS(frame), 0x00 where frame is
+ *
+ *     req_id(1) opcode(1) payload(0..PROTO_MAX_PAYLOAD) crc16(2, little endian)
+ *
+ * and the CRC is CRC-16/CCITT-FALSE (crc16_itu_t, seed 0xFFFF) over req_id,
+ * opcode and payload. The ASCII console never sends 0x00, so a zero byte is
+ * what switches the receiver to binary framing. Every request gets an
+ * immediate response, framed the same way:
+ *
+ *     req_id(1) opcode|0x80(1) status(1) payload crc16(2)
+ *
+ * Frames with a bad CRC or bad COBS coding are dropped without an answer.
+ * All multi-byte fields are little endian.
+ *
+ * PROTO_OP_READ_CHANGES pages through the tags changed since a value of the
+ * change counter (db.h): repeat it with from_id = next_id until next_id is
+ * DB_NUM_TAGS, then use the count of the first page as the next since.
+ */
+
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+#define PROTO_MAX_PAYLOAD 32                        /* Largest request payload, and response payload but PROTO_OP_READ_STATS_ALL */
+#define PROTO_MAX_RESPONSE 120                      /* Largest response payload: PROTO_OP_READ_STATS_ALL, 6 windows of 20 bytes */
+#define PROTO_MAX_FRAME (2 + PROTO_MAX_RESPONSE + 3) /* Largest decoded frame (response has the status byte) */
+#define PROTO_MAX_ENCODED (PROTO_MAX_FRAME + PROTO_MAX_FRAME / 254 + 1) /* Largest COBS-encoded frame */
+#define PROTO_RESPONSE 0x80                         /* Set in the opcode of responses */
+#define PROTO_MAX_CHANGES ((PROTO_MAX_PAYLOAD - 6) / 6) /* Changed tags per PROTO_OP_READ_CHANGES response */
+
+/**
+ * \brief Request opcodes.
+ */
+enum proto_opcode
+{
+    PROTO_OP_PING = 0x00,           /**< Empty request, empty response */
+    PROTO_OP_READ_DB = 0x01,        /**< -> buttons(1) outputs(1) pot_mv(4): bit i = button/output i+1 */
+    PROTO_OP_WRITE_OUTPUTS = 0x02,  /**< op(1) mask(1) value(1), see enum output_op -> nothing */
+    PROTO_OP_READ_PERIOD = 0x03,    /**< id(1), see enum period_id in threads.h -> period_us(4) */
+    PROTO_OP_WRITE_PERIOD = 0x04,   /**< id(1) period_us(4) -> nothing */
+    PROTO_OP_READ_ADC = 0x05,       /**< channel(1) -> value(4) raw(2) seq(4), one snapshot; seq is its change counter (db.h) */
+    PROTO_OP_READ_HIST = 0x06,      /**< from_ms(4) to_ms(4) of this boot, or from_boot(2) from_ms(4) to_boot(2) to_ms(4) -> nothing, then PROTO_OP_HIST_BLOCK frames */
+    PROTO_OP_PLC_WRITE = 0x07,      /**< offset(2) code(1..PROTO_MAX_PAYLOAD-2): stores a chunk of a PLC program -> nothing */
+    PROTO_OP_PLC_SWAP = 0x08,       /**< len(2): installs the stored program, 0 unloads it (plc.h) -> nothing */
+    PROTO_OP_PLC_STATS = 0x09,      /**< -> scans(4) scan_last_us(4) scan_max_us(4) insns(2) loads(4) load_errors(4) */
+    PROTO_OP_READ_STATS = 0x0A,     /**< channel(1) window(1), see enum wstats_window -> count(4) min(4) max(4) mean(4) std(4) */
+    PROTO_OP_READ_TAG = 0x0B,       /**< id(2), see enum db_tag -> type(1) quality(1) value(4) timestamp_ms(4) seq(4) */
+    PROTO_OP_READ_CHANGES = 0x0C,   /**< since(4) from_id(2) -> count(4) next_id(2) then (id(2) value(4)) per changed tag */
+    PROTO_OP_READ_STATS_ALL = 0x0D, /**< channel(1) -> (count(4) min(4) max(4) mean(4) std(4)) per window, in enum wstats_window order */
+    PROTO_OP_TELEMETRY = 0x40,      /**< Never requested: unsolicited telemetry frames (telem.h) */
+    PROTO_OP_HIST_BLOCK = 0x41,     /**< Never requested: one historian block per frame, empty at the end (hist.h) */
+    PROTO_OP_TELEMETRY_PACKED = 0x42, /**< Never requested: telemetry frames in packed mode (telem.h) */
+};
+
+/**
+ * \brief Response status codes.
+ */
+enum proto_status
+{
+    PROTO_OK = 0,                   /**< Request executed */
+    PROTO_ERR_OPCODE,               /**< Unknown opcode */
+    PROTO_ERR_LENGTH,               /**< Payload length does not match the opcode */
+    PROTO_ERR_ARG,                  /**< Argument out of range */
+    PROTO_ERR_BUSY,                 /**< Request could not be queued */
+};
+
+/**
+ * \struct proto_stats
+ * \brief Counters kept by the protocol handler.
+ */
+struct proto_stats
+{
+    uint32_t frames;                /**< Valid requests answered */
+    uint32_t crc_errors;            /**< Frames dropped for a bad CRC */
+    uint32_t framing_errors;        /**< Frames dropped for bad COBS coding or length */
+};
+
+/**
+ * \brief COBS-encodes a buffer.
+ * \param in Data to encode.
+ * \param len Length of in.
+ * \param out Destination, at least len + len / 254 + 1 bytes.
+ * \return Encoded length (no delimiter is added).
+ */
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+
+/**
+ * \brief Decodes a COBS-encoded buffer, without delimiters.
+ * \param in Encoded data.
+ * \param len Length of in.
+ * \param out Destination, at least len bytes. May be the same as in.
+ * \return Decoded length, or -EINVAL if in is not valid COBS.
+ */
+int cobs_decode(const uint8_t *in, size_t len, uint8_t *out);
+
+/**
+ * \brief Handles one received frame and sends the response.
+ *
+ * Called by the UART command parser with the bytes found between two 0x00
+ * delimiters. Runs in thread context.
+ *
+ * \param buf COBS-encoded frame, decoded in place.
+ * \param len Length of buf.
+ */
+void proto_handle_frame(uint8_t *buf, size_t len);
+
+/**
+ * \brief Copies the protocol counters.
+ * \param stats Destination of the counters.
+ */
+void proto_get_stats(struct proto_stats *stats);
+
+#endif /* PROTO_H */
@@ -0,0 +1,219 @@
+/**
+ * \file sched.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Periodic task scheduler with rate-monotonic priorities.
+ */
+
+#include "sched.h"
+#include <string.h>
+
+K_THREAD_STACK_ARRAY_DEFINE(sched_stacks, SCHED_MAX_TASKS, SCHED_STACK_SIZE);
+
+static struct sched_task *sched_table;
+static int sched_ntasks;
+static int64_t sched_origin;        /* Common origin of every phase (in ticks) */
+static struct k_spinlock sched_stats_lock;  /* Keeps a stats block consistent for readers */
+
+/*
+ * Rate-monotonic assignment: a task gets SCHED_PRIO_BASE plus the number of
+ * tasks with a shorter period (ties broken by table order).
+ */
+static void sched_assign_priorities()
+{
+    int i, j, rank;
+
+    for(i = 0; i < sched_ntasks; i++)
+    {
+        rank = 0;
+        for(j = 0; j < sched_ntasks; j++)
+        {
+            if(sched_table[j].period_us < sched_table[i].period_us ||
+               (sched_table[j].period_us == sched_table[i].period_us && j < i))
+            {
+                rank++;
+            }
+        }
+        sched_table[i].prio = SCHED_PRIO_BASE + rank;
+        if(sched_table[i].tid != NULL)
+        {
+            k_thread_priority_set(sched_table[i].tid, sched_table[i].prio);
+        }
+    }
+}
+
+static void sched_stats_clear(struct sched_task *task)
+{
+    memset(&task->stats, 0, sizeof(task->stats));
+    task->stats.jitter_min = UINT32_MAX;
+    task->stats.resp_min = UINT32_MAX;
+    task->stats.exec_min = UINT32_MAX;
+    task->releases = 0;
+    task->misses = 0;
+    task->skipped = 0;
+}
+
+/*
+ * log2 histogram bin of a time: b such that t is in [2^(b-1), 2^b).
+ */
+static inline int sched_hist_bin(uint32_t t)
+{
+    return MIN((t == 0) ? 0 : 32 - __builtin_clz(t), SCHED_HIST_BINS - 1);
+}
+
+/*
+ * Folds one job into the stats block: a handful of compares and adds.
+ */
+static void sched_stats_update(struct sched_stats *st, uint32_t jitter, uint32_t resp, uint32_t exec)
+{
+    k_spinlock_key_t key = k_spin_lock(&sched_stats_lock);
+
+    st->jobs++;
+    st->jitter_min = MIN(st->jitter_min, jitter);
+    st->jitter_max = MAX(st->jitter_max, jitter);
+    st->jitter_sum += jitter;
+    st->resp_min = MIN(st->resp_min, resp);
+    st->resp_max = MAX(st->resp_max, resp);
+    st->resp_sum += resp;
+    st->exec_min = MIN(st->exec_min, exec);
+    st->exec_max = MAX(st->exec_max, exec);
+    st->exec_sum += exec;
+    st->jitter_hist[sched_hist_bin(jitter)]++;
+    st->resp_hist[sched_hist_bin(resp)]++;
+    st->exec_hist[sched_hist_bin(exec)]++;
+    k_spin_unlock(&sched_stats_lock, key);
+}
+
+/*
+ * Body of every periodic task.
+ */
+static void sched_task_code(void *argA, void *argB, void *argC)
+{
+    struct sched_task *task = argA;
+    uint64_t base_us = task->phase_us;      /* Offset from the origin of release 0 of the current period */
+    uint32_t period_us = task->period_us;
+    uint64_t n = 0;                         /* Releases since base_us */
+    uint64_t skip;
+    int64_t release = sched_origin + k_us_to_ticks_floor64(base_us);
+    int64_t now;
+    uint32_t rel_cyc, start_cyc, end_cyc;
+    timing_t t0, t1;
+
+    while(1)
+    {
+        k_sleep(K_TIMEOUT_ABS_TICKS(release));
+
+        if(atomic_clear(&task->reset))
+        {
+            sched_stats_clear(task);
+        }
+
+        rel_cyc = k_ticks_to_cyc_floor32(release);
+        start_cyc = k_cycle_get_32();
+        t0 = timing_counter_get();
+        task->job();
+        t1 = timing_counter_get();
+        end_cyc = k_cycle_get_32();
+        task->releases++;
+
+        sched_stats_update(&task->stats, start_cyc - rel_cyc, end_cyc - rel_cyc,
+                           (uint32_t)timing_cycles_get(&t0, &t1));
+
+        /* A new period counts from the release that just ran */
+        if(task->period_us != period_us)
+        {
+            base_us += n * period_us;
+            period_us = task->period_us;
+            n = 0;
+        }
+
+        /*
+         * Next release is one period after this one, whatever the job took.
+         * Every release is converted from the origin, so tick rounding never
+         * accumulates.
+         */
+        n++;
+        release = sched_origin + k_us_to_ticks_floor64(base_us + n * period_us);
+
+        /* Finished past the next release: deadline missed, skip every release already due */
+        now = k_uptime_ticks();
+        if(now > release)
+        {
+            skip = k_ticks_to_us_floor64(now - release) / period_us + 1;
+            task->misses++;
+            task->skipped += skip;
+            n += skip;
+            release = sched_origin + k_us_to_ticks_floor64(base_us + n * period_us);
+        }
+    }
+}
+
+int sched_start(struct sched_task *tasks, int n)
+{
+    int i;
+
+    if(n <= 0 || n > SCHED_MAX_TASKS)
+    {
+        return -EINVAL;
+    }
+    for(i = 0; i < n; i++)
+    {
+        if(tasks[i].period_us == 0 || tasks[i].job == NULL)
+        {
+            printk("sched_start(): invalid task %d\n\r", i);
+            return -EINVAL;
+        }
+        tasks[i].tid = NULL;
+        sched_stats_clear(&tasks[i]);
+    }
+
+    /* Execution times come from the timing API */
+    timing_init();
+    timing_start();
+
+    sched_table = tasks;
+    sched_ntasks = n;
+    sched_assign_priorities();
+
+    /* Each thread first sleeps until origin + phase, so every phase counts from the same origin */
+    sched_origin = k_uptime_ticks();
+    for(i = 0; i < n; i++)
+    {
+        tasks[i].tid = k_thread_create(&tasks[i].thread, sched_stacks[i],
+            K_THREAD_STACK_SIZEOF(sched_stacks[i]), sched_task_code,
+            &tasks[i], NULL, NULL, tasks[i].prio, 0, K_NO_WAIT);
+        k_thread_name_set(tasks[i].tid, tasks[i].name);
+    }
+
+    return 0;
+}
+
+int sched_set_period(struct sched_task *task, uint32_t period_us)
+{
+    if(period_us == 0)
+    {
+        return -EINVAL;
+    }
+
+    /* Read by the task once per release */
+    task->period_us = period_us;
+
+    sched_assign_priorities();
+    return 0;
+}
+
+void sched_get_stats(struct sched_task *task, struct sched_stats *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&sched_stats_lock);
+
+    *stats = task->stats;
+    k_spin_unlock(&sched_stats_lock, key);
+}
+
+void sched_reset_stats(void)
+{
+    for(int i = 0; i < sched_ntasks; i++)
+    {
+        atomic_set(&sched_table[i].reset, 1);
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * \file sched.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Periodic task scheduler with rate-monotonic priorities.
+ *
+ * Each entry of a task table gets its own thread. The thread sleeps until an
+ * absolute release instant (K_TIMEOUT_ABS_TICKS) and runs the job. Release n
+ * is origin + phase + n * period, converted to ticks as a whole, so releases
+ * never drift by the tick rounding of the period. A job that
+ * finishes after its next release (implicit deadline = period) is counted as
+ * a deadline miss and the releases it overran are skipped. Priorities follow
+ * the periods: the shorter the period, the higher the priority.
+ *
+ * Every job is also measured: release jitter and response time with the
+ * system cycle counter, execution time with the timing API. The results go
+ * into a fixed-size stats block per task: min/max/mean and a log2 histogram
+ * of each of the three.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 8           /* Periodic tasks supported */
+#define SCHED_STACK_SIZE 1024       /* Stack of each periodic task */
+#define SCHED_PRIO_BASE 4           /* Priority of the fastest task, event-driven threads stay above */
+#define SCHED_HIST_BINS 32          /* Histogram bins, bin b counts times in [2^(b-1), 2^b) cycles */
+
+/**
+ * \struct sched_stats
+ * \brief Timing of the jobs of one task since the last reset. Times in cycles of their own counter.
+ */
+struct sched_stats
+{
+    uint32_t jobs;                      /**< Jobs measured */
+    uint32_t jitter_min;                /**< Release to job start, system cycles */
+    uint32_t jitter_max;
+    uint64_t jitter_sum;                /**< Sum of release jitters, for the mean */
+    uint32_t resp_min;                  /**< Release to job end, system cycles */
+    uint32_t resp_max;
+    uint64_t resp_sum;                  /**< Sum of response times, for the mean */
+    uint32_t exec_min;                  /**< Job execution time, timing API cycles */
+    uint32_t exec_max;
+    uint64_t exec_sum;                  /**< Sum of execution times, for the mean */
+    uint32_t jitter_hist[SCHED_HIST_BINS];  /**< log2 histogram of the release jitter */
+    uint32_t resp_hist[SCHED_HIST_BINS];    /**< log2 histogram of the response time */
+    uint32_t exec_hist[SCHED_HIST_BINS];    /**< log2 histogram of the execution time */
+};
+
+/**
+ * \struct sched_task
+ * \brief One periodic task. Only name, period_us, phase_us and job are set by the user.
+ */
+struct sched_task
+{
+    const char *name;           /**< Task name, also given to its thread */
+    uint32_t period_us;         /**< Period (in us) */
+    uint32_t phase_us;          /**< Offset of the first release from sched_start() (in us) */
+    void (*job)(void);          /**< Function run at every release */
+
+    int prio;                   /**< Rate-monotonic priority, set by the scheduler */
+    k_tid_t tid;                /**< Thread of the task */
+    struct k_thread thread;
+    uint32_t releases;          /**< Jobs run */
+    uint32_t misses;            /**< Jobs that finished after their deadline */
+    uint32_t skipped;           /**< Releases dropped after a miss */
+    struct sched_stats stats;   /**< Job timing */
+    atomic_t reset;             /**< Set to clear stats before the next job */
+};
+
+/**
+ * \brief Assigns rate-monotonic priorities and starts every task of the table.
+ *
+ * All phases count from the same origin, taken once.
+ *
+ * \param tasks Task table.
+ * \param n Number of tasks, at most SCHED_MAX_TASKS.
+ * \return 0 if successful, -EINVAL if the table is invalid.
+ */
+int sched_start(struct sched_task *tasks, int n);
+
+/**
+ * \brief Changes the period of a running task.
+ *
+ * The new period applies from the next release and the priorities of the
+ * whole table are reassigned.
+ *
+ * \param task Task to change.
+ * \param period_us New period (in us).
+ * \return 0 if successful, -EINVAL for a null period.
+ */
+int sched_set_period(struct sched_task *task, uint32_t period_us);
+
+/**
+ * \brief Copies the timing of a task.
+ *
+ * Safe to call from any context.
+ *
+ * \param task Task to read.
+ * \param stats Destination of the stats block.
+ */
+void sched_get_stats(struct sched_task *task, struct sched_stats *stats);
+
+/**
+ * \brief Clears the timing and deadline counters of every task.
+ *
+ * Each task clears its own block before its next job, so nothing is lost or
+ * torn while a job is being measured.
+ */
+void sched_reset_stats(void);
+
+#endif /* SCHED_H */
@@ -0,0 +1,193 @@
+/**
+ * \file telem.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Binary telemetry streaming.
+ */
+
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include "telem.h"
+#include "proto.h"
+#include "uart.h"
+#include "threads.h"
+#include "codec.h"
+
+#define TELEM_HEADER 4                                      /* req_id, opcode, status, count */
+#define TELEM_FRAME (TELEM_HEADER + TELEM_BATCH * TELEM_RECORD_SIZE + 2)
+
+#define TELEM_WIRE (TELEM_FRAME + TELEM_FRAME / 254 + 3)    /* Frame on the line: delimiters and COBS overhead */
+
+BUILD_ASSERT(TELEM_WIRE <= UART_TX_FRAME_SIZE, "telemetry frame must fit in one TX frame");
+BUILD_ASSERT(TELEM_MAX_RATE * TELEM_WIRE / TELEM_BATCH <= UART_BAUDRATE / 10,
+             "TELEM_MAX_RATE must fit on the line with plain batches");
+
+static uint8_t telem_frame[TELEM_FRAME];
+static uint8_t telem_packed[TELEM_FRAME];
+static int32_t telem_cols[TELEM_BATCH * TELEM_COLUMNS];
+static uint8_t telem_enc[TELEM_WIRE];
+static int telem_count;                 /* Records in telem_frame */
+static uint32_t telem_first;            /* Uptime of the first record of the batch (in ms) */
+static uint32_t telem_seq;
+static atomic_t telem_on;
+static atomic_t telem_pack;
+static atomic_t telem_restart;          /* Set by telem_start(), handled by the job */
+static struct telem_stats telem_stats;
+
+int telem_start(uint32_t rate_hz, bool packed)
+{
+    if(rate_hz > TELEM_MAX_RATE)
+    {
+        return -EINVAL;
+    }
+
+    if(rate_hz == 0)
+    {
+        atomic_clear(&telem_on);
+        sched_set_period(&tasks[TASK_TELEM], TELEM_IDLE_PERIOD_US);
+        return 0;
+    }
+
+    sched_set_period(&tasks[TASK_TELEM], 1000000 / rate_hz);
+    atomic_set(&telem_pack, packed);
+    atomic_set(&telem_restart, 1);
+    atomic_set(&telem_on, 1);
+    return 0;
+}
+
+bool telem_active(void)
+{
+    return atomic_get(&telem_on) != 0;
+}
+
+/*
+ * Packs the records of the batch column by column into telem_packed.
+ * Returns the frame length without CRC, or 0 if packing does not pay off.
+ */
+static size_t telem_pack_batch(void)
+{
+    const uint8_t *rec;
+    int32_t *col;
+    int i, c;
+    int n;
+
+    for(i = 0; i < telem_count; i++)
+    {
+        rec = &telem_frame[TELEM_HEADER + i * TELEM_RECORD_SIZE];
+        col = &telem_cols[i];
+        for(c = 0; c < 2 + ADC_SCAN_CHANNELS; c++)
+        {
+            col[c * telem_count] = (int32_t)sys_get_le32(&rec[4 * c]);
+        }
+        col[c++ * telem_count] = rec[8 + 4 * ADC_SCAN_CHANNELS];
+        col[c * telem_count] = rec[9 + 4 * ADC_SCAN_CHANNELS];
+    }
+
+    /* No bigger than the plain frame, or it is not worth it */
+    n = codec_encode(telem_cols, telem_count * TELEM_COLUMNS, CODEC_LZ4, &telem_packed[TELEM_HEADER],
+                     telem_count * TELEM_RECORD_SIZE);
+    if(n < 0)
+    {
+        return 0;
+    }
+
+    telem_packed[0] = 0;
+    telem_packed[1] = PROTO_OP_TELEMETRY_PACKED | PROTO_RESPONSE;
+    telem_packed[2] = PROTO_OK;
+    telem_packed[3] = telem_count;
+    return TELEM_HEADER + n;
+}
+
+/*
+ * Closes the batch and queues it as one frame.
+ */
+static void telem_send(void)
+{
+    size_t raw = TELEM_HEADER + telem_count * TELEM_RECORD_SIZE;
+    size_t len = 0;
+    uint8_t *frame = telem_packed;
+    size_t n;
+
+    if(atomic_get(&telem_pack))
+    {
+        len = telem_pack_batch();
+    }
+    if(len == 0)
+    {
+        frame = telem_frame;
+        len = raw;
+        frame[0] = 0;
+        frame[1] = PROTO_OP_TELEMETRY | PROTO_RESPONSE;
+        frame[2] = PROTO_OK;
+        frame[3] = telem_count;
+    }
+    sys_put_le16(crc16_itu_t(0xFFFF, frame, len), &frame[len]);
+    len += 2;
+
+    telem_enc[0] = 0;
+    n = cobs_encode(frame, len, &telem_enc[1]);
+    telem_enc[n + 1] = 0;
+
+    if(uart_tx_write_nowait(telem_enc, n + 2) == 0)
+    {
+        telem_stats.frames++;
+        telem_stats.bytes += len;
+        telem_stats.raw_bytes += raw + 2;
+    }
+    else
+    {
+        telem_stats.dropped += telem_count;
+    }
+    telem_count = 0;
+}
+
+void telem_job(void)
+{
+    struct db_snapshot snap;
+    uint8_t *rec;
+    int i;
+
+    if(!atomic_get(&telem_on))
+    {
+        /* Stream stopped: send what is left of the last batch */
+        if(telem_count > 0)
+        {
+            telem_send();
+        }
+        return;
+    }
+    if(atomic_clear(&telem_restart))
+    {
+        telem_seq = 0;
+        telem_count = 0;
+    }
+
+    /* Start a frame that was left waiting for the line */
+    uart_tx_write_nowait(NULL, 0);
+
+    db_read(&snap);
+    rec = &telem_frame[TELEM_HEADER + telem_count * TELEM_RECORD_SIZE];
+    sys_put_le32(telem_seq++, &rec[0]);
+    sys_put_le32((uint32_t)k_ticks_to_us_floor64(k_uptime_ticks()), &rec[4]);
+    for(i = 0; i < ADC_SCAN_CHANNELS; i++)
+    {
+        sys_put_le32((uint32_t)db_snap_value(&snap, TAG_ADC(i)), &rec[8 + 4 * i]);
+    }
+    rec[8 + 4 * ADC_SCAN_CHANNELS] = db_snap_bits(&snap, TAG_BUTTON1, NUM_BUTTONS);
+    rec[9 + 4 * ADC_SCAN_CHANNELS] = db_snap_bits(&snap, TAG_OUTPUT1, NUM_OUTPUTS);
+    telem_stats.records++;
+
+    if(telem_count++ == 0)
+    {
+        telem_first = k_uptime_get_32();
+    }
+    if(telem_count == TELEM_BATCH || (k_uptime_get_32() - telem_first) >= TELEM_MAX_LATENCY_MS)
+    {
+        telem_send();
+    }
+}
+
+void telem_get_stats(struct telem_stats *stats)
+{
+    *stats = telem_stats;
+}
@@ -0,0 +1,82 @@
+/**
+ * \file telem.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Binary telemetry streaming.
+ *
+ * While streaming, the telemetry task takes one record per release and sends
+ * the records in batches, each batch one COBS frame of the binary protocol
+ * (proto.h) with req_id 0 and opcode PROTO_OP_TELEMETRY | PROTO_RESPONSE:
+ *
+ *     0x00 COBS( 0x00 0xC0 status(1) count(1) record * count crc16(2) ) 0x00
+ *
+ * Record layout, little endian, TELEM_RECORD_SIZE bytes:
+ *
+ *     seq(4) timestamp_us(4) adc_value(4) * ADC_SCAN_CHANNELS buttons(1) outputs(1)
+ *
+ * In packed mode the records of a batch go column by column (seq, timestamp,
+ * each ADC value, buttons, outputs) through the block codec (codec.h) instead,
+ * with opcode PROTO_OP_TELEMETRY_PACKED | PROTO_RESPONSE:
+ *
+ *     0x00 COBS( 0x00 0xC2 status(1) count(1) codec_block crc16(2) ) 0x00
+ *
+ * A packed batch that would not be smaller goes out as a plain one.
+ *
+ * seq counts records since the stream started, so a gap on the host means
+ * records were dropped. A batch leaves when it is full or TELEM_MAX_LATENCY_MS
+ * after its first record. It is dropped rather than delay the task if the
+ * UART still has both TX frames taken.
+ */
+
+#ifndef TELEM_H
+#define TELEM_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include "adc.h"
+
+#define TELEM_BATCH 16                  /* Records per frame, keeps a frame inside one TX DMA frame */
+#define TELEM_MAX_RATE 400              /* Highest record rate (in Hz), what the UART carries unpacked */
+#define TELEM_IDLE_PERIOD_US 10000      /* Task period while stopped, only flushes the last batch */
+#define TELEM_MAX_LATENCY_MS 100        /* Oldest record a partial batch may hold */
+#define TELEM_RECORD_SIZE (4 + 4 + 4 * ADC_SCAN_CHANNELS + 1 + 1)
+#define TELEM_COLUMNS (2 + ADC_SCAN_CHANNELS + 2)  /* Values per record in packed mode */
+
+/**
+ * \struct telem_stats
+ * \brief Counters of the telemetry stream.
+ */
+struct telem_stats
+{
+    uint32_t records;       /**< Records taken */
+    uint32_t frames;        /**< Frames queued for transmission */
+    uint32_t dropped;       /**< Records dropped with their frame because the UART was busy */
+    uint32_t bytes;         /**< Frame bytes queued, before COBS */
+    uint32_t raw_bytes;     /**< What the same frames would have taken unpacked */
+};
+
+/**
+ * \brief Starts or stops streaming.
+ * \param rate_hz Records per second, 0 stops the stream.
+ * \param packed Send batches through the block codec.
+ * \return 0 if successful, -EINVAL if the rate is above TELEM_MAX_RATE.
+ */
+int telem_start(uint32_t rate_hz, bool packed);
+
+/**
+ * \brief Tells whether the stream is running.
+ */
+bool telem_active(void);
+
+/**
+ * \brief Telemetry job, run by the scheduler at the stream rate.
+ */
+void telem_job(void);
+
+/**
+ * \brief Copies the stream counters.
+ * \param stats Destination of the counters.
+ */
+void telem_get_stats(struct telem_stats *stats);
+
+#endif /* TELEM_H */
@@ -4,92 +4,68 @@
  * code given by Prof. Paulo Pedreiras
  *
  * \date 1, June, 2024
- * \brief Implementation of thread functions for UART, Inputs, Outputs, ADC, and LEDs.
+ * \brief Implementation of thread functions for UART, Inputs, Outputs and ADC.
  */
 
 #include "threads.h"
 #include "uart.h"
 #include "IO.h"
 #include "adc.h"
+#include "telem.h"
+#include "modbus.h"
+#include "hist.h"
+#include "latency.h"
+#include "pid.h"
+#include "plc.h"
+#include "wstats.h"
+#include "ui.h"
 
 #define STACK_SIZE 1024                     /**< Size of stack area used by each thread (can be thread specific, if necessary) */
 
-/**< Thread scheduling priority */
-#define thread_UART_prio 1
-#define thread_INPUTS_prio 1
-#define thread_OUTPUTS_prio 1
-#define thread_Led_1_prio 1
-#define thread_Led_2_prio 1
-#define thread_Led_3_prio 1
-#define thread_Led_4_prio 1 
+/**< Thread scheduling priority, event-driven threads run above every periodic task (SCHED_PRIO_BASE) */
 #define thread_ADC_prio 1
+#define thread_INPUTS_prio 2
+#define thread_OUTPUTS_prio 3
+
+BUILD_ASSERT(TAG_BUTTON4 - TAG_BUTTON1 + 1 == NUM_BUTTONS, "one tag per button");
+BUILD_ASSERT(TAG_OUTPUT4 - TAG_OUTPUT1 + 1 == NUM_OUTPUTS, "one tag per output");
+BUILD_ASSERT(TAG_ADC3 - TAG_ADC0 + 1 == ADC_SCAN_CHANNELS, "one tag per scan list entry");
+BUILD_ASSERT(TAG_ADC3_RAW - TAG_ADC0_RAW + 1 == ADC_SCAN_CHANNELS, "one raw tag per scan list entry");
+
+/**< Periodic tasks, priorities are assigned by the scheduler */
+struct sched_task tasks[NUM_TASKS] = {
+    [TASK_UI] = { .name = "ui", .period_us = 1000000, .phase_us = 0, .job = task_UI_job },
+    [TASK_TELEM] = { .name = "telem", .period_us = TELEM_IDLE_PERIOD_US, .phase_us = 0, .job = telem_job },
+    [TASK_MODBUS] = { .name = "modbus", .period_us = MODBUS_IMAGE_PERIOD_US, .phase_us = 0, .job = modbus_image_job },
+    [TASK_PID] = { .name = "pid", .period_us = PID_PERIOD_US, .phase_us = 0, .job = pid_job },
+    [TASK_PLC] = { .name = "plc", .period_us = PLC_SCAN_US, .phase_us = 0, .job = plc_scan },
+};
 
 /* Thread periodicity (in ms)*/
-float thread_UART_period = 1000;
-float thread_INPUTS_period = 200;
 float thread_OUTPUTS_period = 200;
-float thread_ADC_period = 200;
+float thread_ADC_period = 1;
 
 /**< Create thread stack space */
-K_THREAD_STACK_DEFINE(thread_UART_stack, STACK_SIZE);
 K_THREAD_STACK_DEFINE(thread_INPUTS_stack, STACK_SIZE);
 K_THREAD_STACK_DEFINE(thread_OUTPUTS_stack, STACK_SIZE);
-K_THREAD_STACK_DEFINE(thread_Led_1_stack, STACK_SIZE);
-K_THREAD_STACK_DEFINE(thread_Led_2_stack, STACK_SIZE);
-K_THREAD_STACK_DEFINE(thread_Led_3_stack, STACK_SIZE);
-K_THREAD_STACK_DEFINE(thread_Led_4_stack, STACK_SIZE);
 K_THREAD_STACK_DEFINE(thread_ADC_stack, STACK_SIZE);
 
 /**< Create variables for thread data */
-struct k_thread thread_UART_data;
 struct k_thread thread_INPUTS_data;
 struct k_thread thread_OUTPUTS_data;
-struct k_thread thread_Led_1_data;
-struct k_thread thread_Led_2_data;
-struct k_thread thread_Led_3_data;
-struct k_thread thread_Led_4_data;
 struct k_thread thread_ADC_data;
 
 /**< Create task IDs */
-k_tid_t thread_UART_tid;                              
 k_tid_t thread_INPUTS_tid;                             
 k_tid_t thread_OUTPUTS_tid;
-k_tid_t thread_Led_1_tid;                              
-k_tid_t thread_Led_2_tid;                              
-k_tid_t thread_Led_3_tid;
-k_tid_t thread_Led_4_tid;
 k_tid_t thread_ADC_tid;
 
-/**< Semaphore for Task access synchronization */
-struct k_sem sem_adc;                   
-struct k_sem sem_outputs;                   
-struct k_sem sem_Led_1_update;              
-struct k_sem sem_Led_2_update; 
-struct k_sem sem_Led_3_update; 
-struct k_sem sem_Led_4_update;              
-
-/* Global vars (shared memory between tasks) */
-extern uint8_t Led_1_newState;
-extern uint8_t Led_2_newState;
-extern uint8_t Led_3_newState;
-extern uint8_t Led_4_newState;
+/**< Output change requests, drained by the outputs thread */
+K_MSGQ_DEFINE(outputs_msgq, sizeof(struct output_req), OUTPUTS_MSGQ_LEN, 4);
 
 void configure_threads()
 {
 
-    /* Create and init semaphores */
-    k_sem_init(&sem_adc, 1, 1);
-    k_sem_init(&sem_outputs, 0, 1);
-    k_sem_init(&sem_Led_1_update, 0, 1);
-    k_sem_init(&sem_Led_2_update, 0, 1);
-    k_sem_init(&sem_Led_3_update, 0, 1);
-    k_sem_init(&sem_Led_4_update, 0, 1);
-
-
-    thread_UART_tid = k_thread_create(&thread_UART_data, thread_UART_stack,
-        K_THREAD_STACK_SIZEOF(thread_UART_stack), thread_UART_code,
-        NULL, NULL, NULL, thread_UART_prio, 0, K_NO_WAIT);
-
     thread_INPUTS_tid = k_thread_create(&thread_INPUTS_data, thread_INPUTS_stack,
         K_THREAD_STACK_SIZEOF(thread_INPUTS_stack), thread_INPUTS_code,
         NULL, NULL, NULL, thread_INPUTS_prio, 0, K_NO_WAIT);
@@ -102,217 +78,222 @@ void configure_threads()
         K_THREAD_STACK_SIZEOF(thread_ADC_stack), thread_ADC_read,
         NULL, NULL, NULL, thread_ADC_prio, 0, K_NO_WAIT);
 
-    thread_Led_1_tid = k_thread_create(&thread_Led_1_data, thread_Led_1_stack,
-        K_THREAD_STACK_SIZEOF(thread_Led_1_stack), thread_Led_1_code,
-        NULL, NULL, NULL, thread_Led_1_prio, 0, K_NO_WAIT);
-
-    thread_Led_2_tid = k_thread_create(&thread_Led_2_data, thread_Led_2_stack,
-        K_THREAD_STACK_SIZEOF(thread_Led_2_stack), thread_Led_2_code,
-        NULL, NULL, NULL, thread_Led_2_prio, 0, K_NO_WAIT);
-    
-    thread_Led_3_tid = k_thread_create(&thread_Led_3_data, thread_Led_3_stack,
-        K_THREAD_STACK_SIZEOF(thread_Led_3_stack), thread_Led_3_code,
-        NULL, NULL, NULL, thread_Led_3_prio, 0, K_NO_WAIT);
-
-    thread_Led_4_tid = k_thread_create(&thread_Led_4_data, thread_Led_4_stack,
-        K_THREAD_STACK_SIZEOF(thread_Led_4_stack), thread_Led_4_code,
-        NULL, NULL, NULL, thread_Led_4_prio, 0, K_NO_WAIT);
+    if(sched_start(tasks, NUM_TASKS) != 0)
+    {
+        printk("sched_start() failed, periodic tasks not running\n\r");
+    }
 }
 
-void thread_Led_1_code(void *argA , void *argB, void *argC)
+int outputs_request(enum output_op op, uint32_t mask, uint32_t value)
 {
-    /* Thread loop */
-    while(1) 
-    {   
-        k_sem_take(&sem_Led_1_update,  K_FOREVER);
-        DB.OUTPUT1 = Led_1_newState;
+    struct output_req req = { .op = op, .mask = mask, .value = value };
+
+    if(mask == 0 || (mask & ~BIT_MASK(NUM_OUTPUTS)) || op > OUTPUT_OP_WRITE)
+    {
+        return -EINVAL;
     }
+    return k_msgq_put(&outputs_msgq, &req, K_NO_WAIT);
 }
 
-void thread_Led_2_code(void *argA , void *argB, void *argC)
+uint32_t period_get(enum period_id id)
 {
-    /* Thread loop */
-    while(1) 
-    {   
-        k_sem_take(&sem_Led_2_update,  K_FOREVER);
-        DB.OUTPUT2 = Led_2_newState;
+    switch(id)
+    {
+        case PERIOD_UI:
+            return tasks[TASK_UI].period_us;
+        case PERIOD_ADC:
+            return (uint32_t)(thread_ADC_period * 1000);
+        case PERIOD_OUTPUTS:
+            return (uint32_t)(thread_OUTPUTS_period * 1000);
+        case PERIOD_DEBOUNCE:
+            return button_debounce_get();
+        default:
+            return 0;
     }
 }
 
-void thread_Led_3_code(void *argA , void *argB, void *argC)
+int period_set(enum period_id id, uint32_t us)
 {
-    /* Thread loop */
-    while(1) 
-    {   
-        k_sem_take(&sem_Led_3_update,  K_FOREVER);
-        DB.OUTPUT3 = Led_3_newState;
+    static const uint32_t min_us[NUM_PERIODS] = {
+        [PERIOD_UI] = PERIOD_UI_MIN_US,
+        [PERIOD_ADC] = PERIOD_ADC_MIN_US,
+        [PERIOD_OUTPUTS] = PERIOD_OUTPUTS_MIN_US,
+        [PERIOD_DEBOUNCE] = PERIOD_DEBOUNCE_MIN_US,
+    };
+
+    if(id >= NUM_PERIODS)
+    {
+        return -EINVAL;
+    }
+    if(us < min_us[id] || us > PERIOD_MAX_US)
+    {
+        return -ERANGE;
     }
-}
 
-void thread_Led_4_code(void *argA , void *argB, void *argC)
-{
-    /* Thread loop */
-    while(1) 
-    {   
-        k_sem_take(&sem_Led_4_update,  K_FOREVER);
-        DB.OUTPUT4 = Led_4_newState;
+    switch(id)
+    {
+        case PERIOD_UI:
+            return sched_set_period(&tasks[TASK_UI], us);
+        case PERIOD_ADC:
+            thread_ADC_period = us / 1000.0f;
+            adc_stream_set_interval(us);
+            return 0;
+        case PERIOD_OUTPUTS:
+            thread_OUTPUTS_period = us / 1000.0f;
+            return 0;
+        case PERIOD_DEBOUNCE:
+            button_debounce_set(us);
+            return 0;
+        default:
+            return -EINVAL;
     }
 }
 
-void thread_UART_code(void *argA , void *argB, void *argC)
+void task_UI_job(void)
 {
-    /* Local vars */
-    int64_t fin_time = 0;
-    int64_t release_time = 0;     /* Timing variables to control task periodicity */
+    static bool quiet = false;
 
-    /* Compute next release instant */
-    release_time = k_uptime_get() + thread_UART_period;
-
-    /* Thread loop */
-    while(1) 
-    {   
-        print_UI();
-        /* Wait for next release instant */ 
-        fin_time = k_uptime_get();
-        if( fin_time < release_time) 
-        {
-            k_msleep(release_time - fin_time);
-            release_time += thread_UART_period;
-        }
+    /* Keep the terminal quiet while streaming or serving a Modbus master, redraw everything afterwards */
+    if(telem_active() || modbus_active())
+    {
+        quiet = true;
+        return;
+    }
+    if(quiet)
+    {
+        quiet = false;
+        ui_invalidate();
     }
+    print_UI();
 }
 
 void thread_INPUTS_code()
 {
-
     /* Local vars */
-    int64_t fin_time = 0;
-    int64_t release_time = 0;     /* Timing variables to control task periodicity */
-
-    /* Compute next release instant */
-    release_time = k_uptime_get() + thread_INPUTS_period;
+    struct button_event ev;
+    k_spinlock_key_t key;
 
     /* Thread loop */
     while(1) 
     {       
-        DB.BUTTON1 = button_state[0];
-        DB.BUTTON2 = button_state[1];
-        DB.BUTTON3 = button_state[2];
-        DB.BUTTON4 = button_state[3];
-
-        /* Wait for next release instant */ 
-        fin_time = k_uptime_get();
-        if( fin_time < release_time) 
+        /* Sleep until the button ISR queues a debounced change */
+        if(button_event_get(&ev, K_FOREVER) != 0)
         {
-            k_msleep(release_time - fin_time);
-            release_time += thread_INPUTS_period;
+            continue;
         }
+
+        key = db_write_begin();
+        db_set_bits(TAG_BUTTON1, NUM_BUTTONS, ev.pressed);
+        db_write_end(key);
+        lat_probe(LAT_BUTTON_DB, ev.timestamp);
+
+        hist_log(HIST_BUTTONS, ev.pressed, ev.changed);
     }
 }
 
 void thread_OUTPUTS_code()
 {
     /* Local vars */
-    int64_t fin_time = 0;
-    int64_t release_time = 0;     /* Timing variables to control task periodicity */
+    struct output_req req;
+    k_spinlock_key_t key;
+    uint32_t image;
 
-    /* Compute next release instant */
-    release_time = k_uptime_get() + thread_OUTPUTS_period;
     /* Thread loop */
     while(1) 
     { 
-        k_sem_take(&sem_outputs,  K_FOREVER);   
-        if(DB.OUTPUT1 == 1)
-        {
-            gpio_pin_set_dt(&led0_dev,1);
-        }
-        else if(DB.OUTPUT1 == 0)
-        {
-            gpio_pin_set_dt(&led0_dev,0);
-        } 
-
-        if(DB.OUTPUT2 == 1)
+        /* Sleep until a change is requested; on timeout re-assert the current image */
+        if(k_msgq_get(&outputs_msgq, &req, K_USEC(period_get(PERIOD_OUTPUTS))) != 0)
         {
-            gpio_pin_set_dt(&led1_dev,1);
+            outputs_apply(outputs_image_get());
+            continue;
         }
-        else if(DB.OUTPUT2 == 0)
-        {
-            gpio_pin_set_dt(&led1_dev,0);
-        } 
-        k_sem_give(&sem_outputs);   
 
-        if(DB.OUTPUT3 == 1)
-        {
-            gpio_pin_set_dt(&led2_dev,1);
-        }
-        else if(DB.OUTPUT3 == 0)
+        /* Fold this request and any other already queued into one image, then write it at once */
+        image = outputs_image_get();
+        do
         {
-            gpio_pin_set_dt(&led2_dev,0);
-        } 
-        k_sem_give(&sem_outputs);
+            image = outputs_image_op(image, req.op, req.mask, req.value);
+        } while(k_msgq_get(&outputs_msgq, &req, K_NO_WAIT) == 0);
 
-        if(DB.OUTPUT4 == 1)
+        if(image != outputs_image_get())
         {
-            gpio_pin_set_dt(&led3_dev,1);
+            hist_log(HIST_OUTPUTS, image, 0);
         }
-        else if(DB.OUTPUT4 == 0)
-        {
-            gpio_pin_set_dt(&led3_dev,0);
-        } 
-        k_sem_give(&sem_outputs);
+        outputs_apply(image);
+        lat_probe(LAT_OUTPUTS_PIN, 0);
 
-        fin_time = k_uptime_get();
-        if( fin_time < release_time) 
-        {
-            k_msleep(release_time - fin_time);
-            release_time += thread_OUTPUTS_period;
-        }
+        key = db_write_begin();
+        db_set_bits(TAG_OUTPUT1, NUM_OUTPUTS, image);
+        db_write_end(key);
     }
 }
 
 void thread_ADC_read()
 {
+    const struct adc_block *blk;
+    uint32_t updated;
+    int i;
+    k_spinlock_key_t key;
 
-    /* Local vars */
-    int64_t fin_time=0;
-    int64_t release_time=0;     /* Timing variables to control task periodicity */
-
-    int err = 0;
-
-    /* Compute next release instant */
-    release_time = k_uptime_get() + thread_UART_period;
+    /* The ADC samples on its own at thread_ADC_period, the thread only wakes up once per block */
+    if(adc_stream_start((uint32_t)(thread_ADC_period * 1000)) != ERR_OK)
+    {
+        printk("adc_stream_start() failed, ADC thread stopped\n\r");
+        key = db_write_begin();
+        for(i = 0; i < ADC_SCAN_CHANNELS; i++)
+        {
+            db_set_quality(TAG_ADC(i), DB_Q_BAD);
+        }
+        db_write_end(key);
+        return;
+    }
 
     /* Main loop */
     while(1)
     {
-    int8_t volt = 0;
-    int8_t volt_to_temp = 0;
+        blk = adc_stream_get(K_FOREVER);
+        if(blk == NULL)
+        {
+            /* Sequence could not be re-armed: values are stale until it runs again */
+            key = db_write_begin();
+            for(i = 0; i < ADC_SCAN_CHANNELS; i++)
+            {
+                db_set_quality(TAG_ADC(i), DB_Q_BAD);
+                db_set_quality(TAG_ADC_RAW(i), DB_Q_BAD);
+            }
+            db_write_end(key);
+            continue;
+        }
 
-        /* Get one sample, checks for errors and prints the values */
-        err = adc_sample();
-        if(err) {
-            printk("adc_sample() failed with error code %d\n\r",err);
+        /* Publish the channels that are due in this block */
+        updated = adc_scan_publish(blk);
+        wstats_block(blk);
+        adc_stream_release();
+        if(updated == 0)
+        {
+            continue;
         }
-        else {
-            if(adc_sample_buffer[0] > 1023) {
-                printk("adc reading out of range (value is %u)\n\r", adc_sample_buffer[0]);
+
+        key = db_write_begin();
+        for(i = 0; i < ADC_SCAN_CHANNELS; i++)
+        {
+            if(updated & BIT(i))
+            {
+                db_set(TAG_ADC(i), adc_results[i].value);
+                db_set(TAG_ADC_RAW(i), adc_results[i].raw);
             }
-            else {
-                /* ADC is set to use gain of 1/4 and reference VDD/4, so input range is 0...VDD (3 V), with 10 bit resolution */
-                volt = (uint8_t)(1000*adc_sample_buffer[0]*((float)3/1023));
-                //printk("\nadc reading: raw:%4u / %4u mV: \n\r",adc_sample_buffer[0],volt);
-                volt_to_temp = 60*volt-60;
+        }
+        db_write_end(key);
+        for(i = 0; i < ADC_SCAN_CHANNELS; i++)
+        {
+            if(updated & BIT(i))
+            {
+                hist_log_adc(i, adc_results[i].raw);
             }
         }
-    k_sem_take(&sem_adc,  K_FOREVER);
-    DB.Pot_Voltage = volt_to_temp;
-    k_sem_give(&sem_adc);
-    
-        fin_time = k_uptime_get();
-        if( fin_time < release_time) 
+        if(updated & BIT(ADC_POT_CHANNEL))
         {
-            k_msleep(release_time - fin_time);
-            release_time += thread_UART_period;
+            lat_probe(LAT_ADC_PUBLISH, adc_results[ADC_POT_CHANNEL].timestamp);
         }
     }
-}
\ No newline at end of file
+}
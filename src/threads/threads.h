@@ -16,111 +16,134 @@
 #include <zephyr/timing/timing.h>   /* for timing services */
 #include <stdio.h>
 #include <string.h>
+#include "db.h"
+#include "IO.h"
+#include "sched.h"
 
 #ifndef threads_H
 #define threads_H
 
+#define OUTPUTS_MSGQ_LEN 16                     /**< Output change requests that can be queued */
+
+/**
+ * \struct output_req
+ * \brief Output change request handled by the outputs thread.
+ */
+struct output_req
+{
+    uint8_t op;         /**< Operation (enum output_op) */
+    uint8_t mask;       /**< Outputs affected (bit i = output i+1) */
+    uint8_t value;      /**< New bits for OUTPUT_OP_WRITE */
+};
+
 /**
- * \struct DATABASE
- * \brief Data structure to store button and output states along with ADC value.
+ * \brief Periodic tasks, index in the task table.
  */
-struct DATABASE
+enum task_id
 {
-    int8_t BUTTON1;       /**< State of Button 1 */
-    int8_t BUTTON2;       /**< State of Button 2 */
-    int8_t BUTTON3;       /**< State of Button 3 */
-    int8_t BUTTON4;       /**< State of Button 4 */
-    int8_t OUTPUT1;       /**< State of Output 1 */
-    int8_t OUTPUT2;       /**< State of Output 2 */
-    int8_t OUTPUT3;       /**< State of Output 3 */
-    int8_t OUTPUT4;       /**< State of Output 4 */
-    int8_t Pot_Voltage;   /**< Potentiometer Voltage */
+    TASK_UI = 0,        /**< Refreshes the user interface */
+    TASK_TELEM,         /**< Takes telemetry records while streaming */
+    TASK_MODBUS,        /**< Refreshes the Modbus register image */
+    TASK_PID,           /**< Runs the PID loop */
+    TASK_PLC,           /**< Runs the PLC scan */
+    NUM_TASKS
 };
 
-extern struct DATABASE DB;                      /**< Global database instance */
-extern struct k_sem sem_adc;                    /**< Semaphore for ADC */
-extern struct k_sem sem_inputs;                 /**< Semaphore for Inputs */
-extern struct k_sem sem_outputs;                /**< Semaphore for Outputs */
-extern struct k_sem sem_Led_1_update;           /**< Semaphore for LED 1 update */
-extern struct k_sem sem_Led_2_update;           /**< Semaphore for LED 2 update */
-extern struct k_sem sem_Led_3_update;           /**< Semaphore for LED 3 update */
-extern struct k_sem sem_Led_4_update;           /**< Semaphore for LED 4 update */
-
-extern struct gpio_dt_spec led0_dev;            /**< GPIO specification for LED 0 */
-extern struct gpio_dt_spec led1_dev;            /**< GPIO specification for LED 1 */
-extern struct gpio_dt_spec led2_dev;            /**< GPIO specification for LED 2 */
-extern struct gpio_dt_spec led3_dev;            /**< GPIO specification for LED 3 */
-
-extern float thread_UART_period;                /**< Periodicity of UART thread (in ms) */
-extern float thread_INPUTS_period;              /**< Periodicity of Inputs thread (in ms) */
-extern float thread_OUTPUTS_period;             /**< Periodicity of Outputs thread (in ms) */
-extern float thread_ADC_period;                 /**< Periodicity of ADC thread (in ms) */
+extern struct sched_task tasks[NUM_TASKS];      /**< Periodic task table, run by the scheduler */
 
 /**
- * \brief Configures the threads.
- *
- * This function sets up and initializes the threads for UART, inputs, outputs, ADC, and LEDs.
+ * \brief Run-time adjustable periods.
  */
-void configure_threads();
+enum period_id
+{
+    PERIOD_UI = 0,          /**< UI refresh (TASK_UI) */
+    PERIOD_ADC,             /**< ADC sampling interval */
+    PERIOD_OUTPUTS,         /**< Output refresh when idle */
+    PERIOD_DEBOUNCE,        /**< Button debounce window */
+    NUM_PERIODS
+};
+/*
+ * Shortest period each subsystem can keep up with; the longest is PERIOD_MAX_US
+ * for all of them. period_set() and the frequency commands refuse anything else.
+ */
+#define PERIOD_UI_MIN_US 100000         /* A full redraw takes tens of ms at 115200 baud */
+#define PERIOD_ADC_MIN_US 200           /* Four 40 us acquisitions plus the per-frame callback */
+#define PERIOD_OUTPUTS_MIN_US 1000      /* Idle re-assert of the output image */
+#define PERIOD_DEBOUNCE_MIN_US 1000     /* Below this, contact bounce gets through */
+#define PERIOD_MAX_US 1000000
+
+extern float thread_OUTPUTS_period;             /**< Interval between output refreshes when idle (in ms) */
+extern float thread_ADC_period;                 /**< ADC sampling interval (in ms) */
 
 /**
- * \brief UART thread function.
- *
- * This function contains the code that runs in the UART thread. It handles UART communication.
- *
- * \param argA Argument A (unused).
- * \param argB Argument B (unused).
- * \param argC Argument C (unused).
+ * \brief Returns one of the run-time adjustable periods.
+ * \param id Period to read.
+ * \return Period (in us).
  */
-void thread_UART_code(void *argA, void *argB, void *argC); 
+uint32_t period_get(enum period_id id);
 
 /**
- * \brief Inputs thread function.
- *
- * This function contains the code that runs in the Inputs thread. It handles input processing.
+ * \brief Changes one of the run-time adjustable periods.
+ * \param id Period to change.
+ * \param us New period (in us).
+ * \return 0 if successful, -EINVAL for an unknown id, -ERANGE for a period the subsystem cannot keep.
  */
-void thread_INPUTS_code();
+int period_set(enum period_id id, uint32_t us);
 
 /**
- * \brief Outputs thread function.
+ * \brief Configures the threads.
  *
- * This function contains the code that runs in the Outputs thread. It handles output processing.
+ * This function sets up and initializes the event-driven threads for inputs, outputs
+ * and ADC, and starts the periodic tasks of the task table.
  */
-void thread_OUTPUTS_code();
+void configure_threads();
 
 /**
- * \brief ADC read thread function.
+ * \brief UI job.
  *
- * This function contains the code that runs in the ADC thread. It handles ADC value reading.
+ * Runs at every release of TASK_UI and redraws the user interface, except while
+ * telemetry is streaming on the same UART.
  */
-void thread_ADC_read();
+void task_UI_job(void);
 
 /**
- * \brief LED 1 thread function.
+ * \brief Inputs thread function.
  *
- * This function contains the code that runs in the LED 1 thread. It handles updating the state of LED 1.
+ * This function contains the code that runs in the Inputs thread. It sleeps until the
+ * button ISR queues a debounced event and copies the new button states into the database.
  */
-void thread_Led_1_code();
+void thread_INPUTS_code();
 
 /**
- * \brief LED 2 thread function.
+ * \brief Requests an output change.
  *
- * This function contains the code that runs in the LED 2 thread. It handles updating the state of LED 2.
+ * Safe to call from any context, including interrupts. The outputs thread
+ * applies the change to the pins as soon as it runs; all outputs in mask
+ * switch together.
+ *
+ * \param op Operation on the output image (enum output_op).
+ * \param mask Outputs affected (bit i = output i+1).
+ * \param value New bits for OUTPUT_OP_WRITE, ignored otherwise.
+ * \return 0 if queued, -EINVAL for an unknown output, -ENOMSG if the queue is full.
  */
-void thread_Led_2_code();
+int outputs_request(enum output_op op, uint32_t mask, uint32_t value);
 
 /**
- * \brief LED 3 thread function.
+ * \brief Outputs thread function.
  *
- * This function contains the code that runs in the LED 3 thread. It handles updating the state of LED 3.
+ * This function contains the code that runs in the Outputs thread. It sleeps on the
+ * output request queue, folds every queued request into the output image, writes
+ * the image to the pins at once and updates the database. When idle for
+ * thread_OUTPUTS_period it re-asserts the image.
  */
-void thread_Led_3_code();
+void thread_OUTPUTS_code();
 
 /**
- * \brief LED 4 thread function.
+ * \brief ADC read thread function.
  *
- * This function contains the code that runs in the LED 4 thread. It handles updating the state of LED 4.
+ * This function contains the code that runs in the ADC thread. It starts the ADC
+ * streaming engine and publishes the value of every completed block to the database.
  */
-void thread_Led_4_code();
+void thread_ADC_read();
 
 #endif /* threads_H */
\ No newline at end of file
@@ -13,48 +13,496 @@
 
 #include "uart.h"
 #include "threads.h"
+#include "adc.h"
+#include "bench.h"
+#include "latency.h"
+#include "ui.h"
+#include "proto.h"
+#include "telem.h"
+#include "modbus.h"
+#include "hist.h"
+#include "alarm.h"
+#include "pid.h"
+#include "plc.h"
+#include "wstats.h"
+#include <stdarg.h>
 
 /* UART related variables */
 const struct device *uart_dev = DEVICE_DT_GET(UART_NODE);   /**< UART device instance */
-uint8_t RX_buf[RXBUF_SIZE];                                 /**< RX buffer, to store received data */
-uint8_t RX_chars[RXBUF_SIZE];                               /**< chars actually received  */
-volatile int uart_RXbuf_nchar = 0;                          /**< Number of chars currrntly on the rx buffer */
-uint8_t command_state[RXBUF_SIZE];                          /**< Output sent to the interface depending on user commands */
-uint8_t Led_1_newState;                                     /**< New state for LED 1 */
-uint8_t Led_2_newState;                                     /**< New state for LED 2 */
-uint8_t Led_3_newState;                                     /**< New state for LED 3 */
-uint8_t Led_4_newState;                                     /**< New state for LED 4 */                
+uint8_t RX_chars[RXBUF_SIZE];                               /**< Last command received */
+uint8_t command_state[CMD_STATE_SIZE];                      /**< Output sent to the interface depending on user commands */
+static bool show_task_stats = false;                        /**< Periodic task timing shown below the interface */
+
+/* TX engine: one frame is filled while the other is sent by DMA */
+static uint8_t uart_tx_frames[2][UART_TX_FRAME_SIZE];       /**< TX DMA frames */
+static int uart_tx_fill_idx = 0;                            /**< Frame being filled */
+static size_t uart_tx_fill_len = 0;                         /**< Bytes in the frame being filled */
+static K_SEM_DEFINE(uart_tx_idle, 1, 1);                    /**< Available when no frame is being sent */
+static K_MUTEX_DEFINE(uart_tx_mutex);                       /**< Serializes writers */
+
+/* RX pipeline: the driver fills two DMA buffers in turn, the ISR copies the bytes
+ * into a lock-free ring (head written only by the ISR, tail only by the parser)
+ * and the parser assembles lines in its own work queue */
+static uint8_t uart_rx_bufs[2][RXBUF_SIZE];                 /**< RX DMA buffers */
+static int uart_rx_next_buf = 1;                            /**< Buffer given on the next UART_RX_BUF_REQUEST */
+static uint8_t uart_rx_ring[UART_RX_RING_SIZE];             /**< Bytes waiting for the parser */
+static atomic_t uart_rx_head;                               /**< Bytes written by the ISR */
+static atomic_t uart_rx_tail;                               /**< Bytes consumed by the parser */
+static uint8_t uart_line[RXBUF_SIZE];                       /**< Line being assembled */
+static int uart_line_len = 0;                               /**< Chars in uart_line, -1 while discarding a long line */
+static uint32_t uart_rx_gaps[UART_RX_GAPS];                 /**< Ring positions followed by a t3.5 silence */
+static atomic_t uart_rx_gaps_head;
+static atomic_t uart_rx_gaps_tail;
+static struct k_spinlock uart_rx_gaps_lock;                 /**< Gaps come from the UART ISR and the idle timer */
+static struct k_timer uart_rx_idle;                         /**< Expires when the line stayed silent after a full buffer */
+static uint8_t uart_mb_frame[MODBUS_MAX_ADU];               /**< Modbus request being received */
+static int uart_mb_len = -1;                                /**< Bytes in uart_mb_frame, -1 when not receiving Modbus */
+static uint8_t uart_frame[PROTO_MAX_ENCODED];               /**< Binary frame being received */
+static int uart_frame_len = -1;                             /**< Bytes in uart_frame, -1 while in ASCII mode */
+static struct uart_rx_stats uart_rx_stats;
+static struct k_work_q uart_rx_wq;                          /**< Command parser work queue */
+static struct k_work uart_rx_work;
+K_THREAD_STACK_DEFINE(uart_rx_wq_stack, UART_RX_WQ_STACK_SIZE);
+
+BUILD_ASSERT(IS_POWER_OF_TWO(UART_RX_RING_SIZE), "UART_RX_RING_SIZE must be a power of two");
+BUILD_ASSERT(IS_POWER_OF_TWO(UART_RX_GAPS), "UART_RX_GAPS must be a power of two");
 
 
 /* Struct for UART configuration (if using default values is not needed) */
 const struct uart_config uart_cfg = 
 {
-		.baudrate = 115200,
+		.baudrate = UART_BAUDRATE,
 		.parity = UART_CFG_PARITY_NONE,
 		.stop_bits = UART_CFG_STOP_BITS_1,
 		.data_bits = UART_CFG_DATA_BITS_8,
 		.flow_ctrl = UART_CFG_FLOW_CTRL_NONE
 };
 
+/*
+ * Formats a log2 histogram of the task table: its first occupied bin, then
+ * the share of the jobs (in %) of every bin up to the last occupied one.
+ */
+static void print_hist(char *buf, size_t size, const char *name, const uint32_t *hist, uint32_t jobs)
+{
+    int lo = 0, hi = SCHED_HIST_BINS - 1;
+    size_t n;
+
+    while(lo < hi && hist[lo] == 0)
+    {
+        lo++;
+    }
+    while(hi > lo && hist[hi] == 0)
+    {
+        hi--;
+    }
+    n = snprintf(buf, size, "%s b%d:", name, lo);
+    for(; lo <= hi && n < size; lo++)
+    {
+        n += snprintf(&buf[n], size - n, " %u", (uint32_t)((uint64_t)hist[lo] * 100 / jobs));
+    }
+}
+
+int print_task_row(char *buf, size_t size, const struct sched_task *task, const struct sched_stats *st)
+{
+    if(st->jobs == 0)
+    {
+        return snprintf(buf, size, " %-8s %8u       0 %5u  no jobs yet", task->name, task->period_us, task->misses);
+    }
+    return snprintf(buf, size, " %-8s %8u %7u %5u  %6u/%u/%-8u  %6u/%u/%-8u  %6u/%u/%u", task->name,
+                    task->period_us, st->jobs, task->misses,
+                    k_cyc_to_us_floor32(st->jitter_min), k_cyc_to_us_floor32((uint32_t)(st->jitter_sum / st->jobs)),
+                    k_cyc_to_us_floor32(st->jitter_max),
+                    k_cyc_to_us_floor32(st->resp_min), k_cyc_to_us_floor32((uint32_t)(st->resp_sum / st->jobs)),
+                    k_cyc_to_us_floor32(st->resp_max),
+                    (uint32_t)(timing_cycles_to_ns(st->exec_min) / 1000),
+                    (uint32_t)(timing_cycles_to_ns(st->exec_sum / st->jobs) / 1000),
+                    (uint32_t)(timing_cycles_to_ns(st->exec_max) / 1000));
+}
+
 void print_UI()
 {
-    printf("\033[2J\033[H");
-    printf("\n---------------------------------------------------------------------------------------------------------------------\n");
-    printf("\n UART frequency: %fHz", (int)1/(thread_UART_period*0.001));
-    printf("\n Buttons frequency: %.0fHz", (int)1/(thread_INPUTS_period * 0.001));
-    printf("\n ADC frequency: %.0fHz", (int)1/(thread_ADC_period * 0.001));
-    printf("\n Outputs(LEDs) frequency: %.0fHz", (int)1/(thread_OUTPUTS_period * 0.001));
-    printf("\n");
-    printf("\n %s",command_state);
-    printf("\n");
-    printf("#---------------------------------------------------------------------------------------------------------------------#\n");
-    printf(" Available commands:");
-    printf("\n  \033[0;32m/fuxxx /fbxxx /faxxx /foxxx \033[0;37m- (Change frequency of UART, buttons, ADC and outputs(LEDs), xxx is desired frequency)");
-    printf("\n  \033[0;32m/bx \033[0;37m- (Check Button State)");
-    printf("\n  \033[0;32m/ox_y \033[0;37m- (Active (y=1) or Disable (y=0) Led x)"); 
-    printf("\n  \033[0;32m/a \033[0;37m- (See ADC value)");
-    printf("\n#---------------------------------------------------------------------------------------------------------------------#\n");
-    printf("\n String sent: %s",RX_chars);
+    static const char rule[] = "#---------------------------------------------------------------------------------------------------------------------#";
+    struct sched_stats st;
+    char line[UI_COLS];
+    char hj[44], hr[44], he[44];
+    struct uart_rx_stats rx;
+    struct proto_stats ps;
+    struct modbus_stats ms;
+    struct hist_stats hs;
+    struct alarm_stats as;
+    struct pid_stats pst;
+    struct plc_stats ls;
+    int r = 0;
+    int i;
+
+    ui_begin();
+    ui_printf(r++, "%s", rule);
+    ui_printf(r++, " UART frequency: %uHz", 1000000 / tasks[TASK_UI].period_us);
+    ui_printf(r++, " Buttons debounce: %ums", button_debounce_get() / 1000);
+    ui_printf(r++, " ADC frequency: %uHz", (unsigned int)(1000 / thread_ADC_period));
+    ui_printf(r++, " Outputs(LEDs) frequency: %uHz", (unsigned int)(1000 / thread_OUTPUTS_period));
+    ui_printf(r++, "");
+    ui_printf(r++, " %s", command_state);
+    ui_printf(r++, "");
+    ui_printf(r++, "%s", rule);
+    ui_printf(r++, " Available commands:");
+    ui_printf(r++, "  \033[0;32m/fuxxx /fbxxx /faxxx /foxxx \033[0;37m- (Change frequency of UART, buttons, ADC and outputs(LEDs), xxx is desired frequency)");
+    ui_printf(r++, "  \033[0;32m/bx /be \033[0;37m- (Check Button State, or button event counters)");
+    ui_printf(r++, "  \033[0;32m/ox_y \033[0;37m- (Active (y=1) or Disable (y=0) Led x)");
+    ui_printf(r++, "  \033[0;32m/osM /ocM /otM /owM \033[0;37m- (Set, clear, toggle or write the Leds in hex mask M at once)");
+    ui_printf(r++, "  \033[0;32m/a /ax \033[0;37m- (See ADC value, or value of scan channel x)");
+    ui_printf(r++, "  \033[0;32m/gxxx \033[0;37m- (Value, quality, change sequence and time of tag xxx, 0 to %d)", DB_NUM_TAGS - 1);
+    ui_printf(r++, "  \033[0;32m/w /wx \033[0;37m- (1/10/60 s sliding mean+-std of the pot, or of channel x; every window: binary READ_STATS_ALL)");
+    ui_printf(r++, "  \033[0;32m/prx /psxxx /ppxxx /pixxx /pdxxx \033[0;37m- (PID off (x=0), on ADC (1) or on the plant model (2); setpoint in mV; Kp, Ki, Kd in 1/1000)");
+    ui_printf(r++, "  \033[0;32m/m /l \033[0;37m- (Run hot-path or end-to-end latency benchmarks, results on the console)");
+    ui_printf(r++, "  \033[0;32m/s /sr \033[0;37m- (Show or hide task timing, reset task timing)");
+    ui_printf(r++, "  \033[0;32m/txxx \033[0;37m- (Stream binary telemetry at xxx Hz, /t0 stops)");
+    ui_printf(r++, "  \033[0;32m/tpxxx \033[0;37m- (Same, delta/LZ4 packed)");
+    ui_printf(r++, "  \033[0;32mcmd;cmd;... \033[0;37m- (Run several commands from one line)");
+    ui_printf(r++, "%s", rule);
+
+    if(show_task_stats)
+    {
+        ui_printf(r++, " task       period    jobs  miss  jitter(min/mean/max)   resp(min/mean/max)   exec(min/mean/max) us");
+        ui_printf(r++, "            log2 histograms: first bin b, then %% of jobs per bin (bin b: [2^(b-1), 2^b) cycles)");
+        for(i = 0; i < NUM_TASKS; i++)
+        {
+            sched_get_stats(&tasks[i], &st);
+            print_task_row(line, sizeof(line), &tasks[i], &st);
+            ui_printf(r++, "%s", line);
+            if(st.jobs == 0)
+            {
+                continue;
+            }
+            print_hist(hj, sizeof(hj), "jitter", st.jitter_hist, st.jobs);
+            print_hist(hr, sizeof(hr), "resp", st.resp_hist, st.jobs);
+            print_hist(he, sizeof(he), "exec", st.exec_hist, st.jobs);
+            ui_printf(r++, "            %s | %s | %s", hj, hr, he);
+        }
+    }
+
+    uart_rx_get_stats(&rx);
+    ui_printf(r++, "");
+    proto_get_stats(&ps);
+    ui_printf(r++, " RX bytes: %u, dropped: %u, lines: %u, frames: %u (crc errors: %u, framing errors: %u)",
+              rx.bytes, rx.dropped, rx.lines, ps.frames, ps.crc_errors, ps.framing_errors);
+    modbus_get_stats(&ms);
+    ui_printf(r++, " Modbus requests: %u, exceptions: %u, crc errors: %u",
+              ms.requests, ms.exceptions, ms.crc_errors);
+    hist_get_stats(&hs);
+    ui_printf(r++, " History records: %u (dropped: %u), blocks: %u (indexed: %u, %u of %u bytes), erases: %u over %u sectors",
+              hs.records, hs.dropped, hs.blocks, hs.indexed, hs.bytes, hs.raw_bytes, hs.erases, hs.sectors);
+    pid_get_stats(&pst);
+    ui_printf(r++, " PID setpoint: %d, measured: %d (max %d), duty: %u/1000, saturated: %u of %u iterations",
+              (int)pst.setpoint, (int)pst.y, (int)pst.y_max, pst.duty, pst.saturated, pst.jobs);
+    plc_get_stats(&ls);
+    ui_printf(r++, " PLC instructions: %u (outputs 0x%x), scans: %u, scan: %uus (max %uus), loads: %u (rejected: %u)",
+              ls.insns, ls.out_mask, ls.scans, k_cyc_to_us_floor32(ls.scan_last), k_cyc_to_us_floor32(ls.scan_max),
+              ls.loads, ls.load_errors);
+    alarm_get_stats(&as);
+    ui_printf(r++, " Alarms active: 0x%02x of %d, trips: %u, clears: %u, output errors: %u",
+              as.active, alarm_count, as.trips, as.clears, as.out_errors);
+    ui_printf(r++, " Tags: %d (%d boolean, %d integer), changes: %u", DB_NUM_TAGS, DB_NUM_BOOLS, DB_NUM_INTS,
+              db_change_count());
+    ui_printf(r++, " String sent: %.*s", (int)strcspn((char *)RX_chars, "\r"), RX_chars);
+    ui_end();
+}
+
+/*
+ * Sends the frame being filled and switches to the other one. uart_tx_idle must be taken.
+ */
+static void uart_tx_submit_locked(void)
+{
+    if(uart_tx(uart_dev, uart_tx_frames[uart_tx_fill_idx], uart_tx_fill_len, SYS_FOREVER_US) != 0)
+    {
+        k_sem_give(&uart_tx_idle);
+    }
+    uart_tx_fill_idx ^= 1;
+    uart_tx_fill_len = 0;
+}
+
+static void uart_tx_flush_locked(void)
+{
+    if(uart_tx_fill_len == 0)
+    {
+        return;
+    }
+
+    /* Wait for the previous frame to leave, then send this one and fill the other */
+    k_sem_take(&uart_tx_idle, K_FOREVER);
+    uart_tx_submit_locked();
+}
+
+int uart_tx_write_nowait(const uint8_t *buf, size_t len)
+{
+    if(len > UART_TX_FRAME_SIZE)
+    {
+        return -EINVAL;
+    }
+    if(k_mutex_lock(&uart_tx_mutex, K_NO_WAIT) != 0)
+    {
+        return -EBUSY;
+    }
+
+    /* No room left: the frame being filled can only go if the line is idle */
+    if(len > UART_TX_FRAME_SIZE - uart_tx_fill_len)
+    {
+        if(k_sem_take(&uart_tx_idle, K_NO_WAIT) != 0)
+        {
+            k_mutex_unlock(&uart_tx_mutex);
+            return -EBUSY;
+        }
+        uart_tx_submit_locked();
+    }
+
+    if(len > 0)
+    {
+        memcpy(&uart_tx_frames[uart_tx_fill_idx][uart_tx_fill_len], buf, len);
+        uart_tx_fill_len += len;
+    }
+
+    /* Start sending right away if the line is idle, else it waits for the next call or flush */
+    if(uart_tx_fill_len > 0 && k_sem_take(&uart_tx_idle, K_NO_WAIT) == 0)
+    {
+        uart_tx_submit_locked();
+    }
+
+    k_mutex_unlock(&uart_tx_mutex);
+    return 0;
+}
+
+void uart_tx_write(const uint8_t *buf, size_t len)
+{
+    size_t n;
+
+    k_mutex_lock(&uart_tx_mutex, K_FOREVER);
+    while(len > 0)
+    {
+        n = MIN(len, UART_TX_FRAME_SIZE - uart_tx_fill_len);
+        memcpy(&uart_tx_frames[uart_tx_fill_idx][uart_tx_fill_len], buf, n);
+        uart_tx_fill_len += n;
+        buf += n;
+        len -= n;
+        if(uart_tx_fill_len == UART_TX_FRAME_SIZE)
+        {
+            uart_tx_flush_locked();
+        }
+    }
+    k_mutex_unlock(&uart_tx_mutex);
+}
+
+void uart_tx_printf(const char *fmt, ...)
+{
+    va_list args;
+    size_t space;
+    int n;
+
+    k_mutex_lock(&uart_tx_mutex, K_FOREVER);
+
+    /* Format in place; if it does not fit, send what is there and format again in an empty frame */
+    space = UART_TX_FRAME_SIZE - uart_tx_fill_len;
+    va_start(args, fmt);
+    n = vsnprintf((char *)&uart_tx_frames[uart_tx_fill_idx][uart_tx_fill_len], space, fmt, args);
+    va_end(args);
+    if(n >= 0 && (size_t)n >= space && uart_tx_fill_len > 0)
+    {
+        uart_tx_flush_locked();
+        space = UART_TX_FRAME_SIZE;
+        va_start(args, fmt);
+        n = vsnprintf((char *)uart_tx_frames[uart_tx_fill_idx], space, fmt, args);
+        va_end(args);
+    }
+    if(n > 0)
+    {
+        uart_tx_fill_len += MIN((size_t)n, space - 1);
+    }
+
+    k_mutex_unlock(&uart_tx_mutex);
+}
+
+void uart_tx_flush(void)
+{
+    k_mutex_lock(&uart_tx_mutex, K_FOREVER);
+    uart_tx_flush_locked();
+    k_mutex_unlock(&uart_tx_mutex);
+}
+
+/*
+ * Records a t3.5 silence after everything pushed so far. Runs in the UART ISR
+ * or the idle timer.
+ */
+static void uart_rx_mark_gap(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&uart_rx_gaps_lock);
+    uint32_t gh = atomic_get(&uart_rx_gaps_head);
+
+    if(gh - (uint32_t)atomic_get(&uart_rx_gaps_tail) < UART_RX_GAPS)
+    {
+        uart_rx_gaps[gh & (UART_RX_GAPS - 1)] = atomic_get(&uart_rx_head);
+        atomic_set(&uart_rx_gaps_head, gh + 1);
+    }
+    else
+    {
+        uart_rx_stats.gaps_lost++;
+    }
+    k_spin_unlock(&uart_rx_gaps_lock, key);
+}
+
+/*
+ * The driver reported nothing for a whole buffer plus its RX timeout after a
+ * chunk that filled its buffer: the line went silent right at the buffer end.
+ */
+static void uart_rx_idle_expired(struct k_timer *timer)
+{
+    uart_rx_mark_gap();
+    k_work_submit_to_queue(&uart_rx_wq, &uart_rx_work);
+}
+
+/*
+ * Copies received bytes into the RX ring. Runs in the UART ISR.
+ */
+static void uart_rx_push(const uint8_t *buf, size_t len)
+{
+    uint32_t head = atomic_get(&uart_rx_head);
+    uint32_t free = UART_RX_RING_SIZE - (head - (uint32_t)atomic_get(&uart_rx_tail));
+    size_t n = MIN(len, free);
+
+    for(size_t i = 0; i < n; i++)
+    {
+        uart_rx_ring[(head + i) & (UART_RX_RING_SIZE - 1)] = buf[i];
+    }
+    atomic_set(&uart_rx_head, head + n);
+
+    uart_rx_stats.bytes += len;
+    uart_rx_stats.dropped += len - n;
+}
+
+/*
+ * A t3.5 silence ends a Modbus request.
+ */
+static void uart_rx_gap(void)
+{
+    if(uart_mb_len > 0)
+    {
+        modbus_handle_frame(uart_mb_frame, uart_mb_len);
+    }
+    uart_mb_len = -1;
+}
+
+/*
+ * Drains the RX ring, assembles lines and runs each complete command.
+ */
+static void uart_rx_work_handler(struct k_work *work)
+{
+    uint32_t tail = atomic_get(&uart_rx_tail);
+    uint32_t head = atomic_get(&uart_rx_head);
+    uint8_t c;
+
+    while(tail != head)
+    {
+        c = uart_rx_ring[tail & (UART_RX_RING_SIZE - 1)];
+        tail++;
+
+        /* Modbus request: everything up to the next silence (modbus.h) */
+        if(uart_mb_len >= 0)
+        {
+            if(uart_mb_len < (int)sizeof(uart_mb_frame))
+            {
+                uart_mb_frame[uart_mb_len++] = c;
+            }
+        }
+        else if(c == MODBUS_ADDR && uart_frame_len < 0 && uart_line_len == 0)
+        {
+            uart_mb_frame[0] = c;
+            uart_mb_len = 1;
+        }
+
+        /* 0x00 never appears in ASCII: it opens and closes binary frames (proto.h) */
+        else if(c == 0)
+        {
+            if(uart_frame_len > 0)
+            {
+                proto_handle_frame(uart_frame, uart_frame_len);
+                uart_frame_len = -1;
+            }
+            else
+            {
+                uart_frame_len = 0;
+                uart_line_len = 0;
+            }
+        }
+        else if(uart_frame_len >= 0)
+        {
+            /* An oversized frame keeps counting so that the handler rejects it */
+            if(uart_frame_len < (int)sizeof(uart_frame))
+            {
+                uart_frame[uart_frame_len] = c;
+            }
+            uart_frame_len = MIN(uart_frame_len + 1, (int)sizeof(uart_frame) + 1);
+        }
+        else if(c == '\r')
+        {
+            if(uart_line_len >= 0)
+            {
+                uart_line[uart_line_len++] = '\r';
+                uart_line[uart_line_len] = '\0';
+                uart_rx_stats.lines++;
+                read_user_inp(uart_line);
+            }
+            uart_line_len = 0;
+        }
+        else if(c == '\n' || uart_line_len < 0)
+        {
+            /* Ignore the LF of CRLF, and the rest of a line that was too long */
+        }
+        else if(c == 127)
+        {
+            if(uart_line_len > 0)
+            {
+                uart_line_len--;
+            }
+        }
+        else if(uart_line_len < RXBUF_SIZE - 2)
+        {
+            uart_line[uart_line_len++] = c;
+        }
+        else
+        {
+            uart_rx_stats.too_long++;
+            uart_line_len = -1;
+        }
+
+        /* Silences are handled once the bytes before them are */
+        while(atomic_get(&uart_rx_gaps_tail) != atomic_get(&uart_rx_gaps_head) &&
+              (int32_t)(tail - uart_rx_gaps[atomic_get(&uart_rx_gaps_tail) & (UART_RX_GAPS - 1)]) >= 0)
+        {
+            atomic_inc(&uart_rx_gaps_tail);
+            uart_rx_gap();
+        }
+
+        /* Release the ring space as we go, and pick up bytes that arrived meanwhile */
+        if(tail == head)
+        {
+            atomic_set(&uart_rx_tail, tail);
+            head = atomic_get(&uart_rx_head);
+        }
+    }
+}
+
+void uart_rx_get_stats(struct uart_rx_stats *stats)
+{
+    *stats = uart_rx_stats;
+}
+
+void uart_rx_inject(const uint8_t *buf, size_t len)
+{
+    unsigned int key;
+
+    /* uart_rx_push() expects to be the only producer, as in the ISR */
+    key = irq_lock();
+    uart_rx_push(buf, len);
+    irq_unlock(key);
+    k_work_submit_to_queue(&uart_rx_wq, &uart_rx_work);
 }
 
 int uart_init()
@@ -82,12 +530,24 @@ int uart_init()
         return FATAL_ERR;
     }
 		
-    /* Enable data reception */
-    err =  uart_rx_enable(uart_dev ,RX_buf,sizeof(RX_buf),RX_TIMEOUT);
+    /* First frame clears the screen */
+    ui_invalidate();
+
+    /* Start the command parser */
+    k_work_queue_start(&uart_rx_wq, uart_rx_wq_stack, K_THREAD_STACK_SIZEOF(uart_rx_wq_stack),
+                       UART_RX_WQ_PRIO, &(struct k_work_queue_config){ .name = "uart_rx" });
+    k_work_init(&uart_rx_work, uart_rx_work_handler);
+    k_timer_init(&uart_rx_idle, uart_rx_idle_expired, NULL);
+
+    /* Enable data reception, the second buffer is given on UART_RX_BUF_REQUEST */
+    uart_rx_next_buf = 1;
+    err =  uart_rx_enable(uart_dev, uart_rx_bufs[0], sizeof(uart_rx_bufs[0]), RX_TIMEOUT);
     if (err) {
         printk("uart_rx_enable() error. Error code:%d\n\r",err);
         return FATAL_ERR;
     }
+
+    return 0;
 }
 
 void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
@@ -97,52 +557,47 @@ void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
     switch (evt->type) {
 	
         case UART_TX_DONE:
-		    printk("\nUART_TX_DONE event \n\r");
+        case UART_TX_ABORTED:
+            /* Frame out (or dropped), the next one can go */
+            k_sem_give(&uart_tx_idle);
             break;
-
-    	case UART_TX_ABORTED:
-	    	printk("\nUART_TX_ABORTED event \n\r");
-		    break;
 		
 	    case UART_RX_RDY:
-		    printk("\nUART_RX_RDY event \n\r");
-            memcpy(&RX_chars[uart_RXbuf_nchar],&(RX_buf[evt->data.rx.offset]),evt->data.rx.len); 
-            if(RX_chars[uart_RXbuf_nchar] == '\r')
-            {
-                RX_chars[uart_RXbuf_nchar + 1] = '\0'; 
-                read_user_inp(RX_chars);
-                RX_chars[0] = '\0';
-                uart_RXbuf_nchar = 0;
-            }
-            else if(RX_chars[uart_RXbuf_nchar] == 127)
+            k_timer_stop(&uart_rx_idle);
+            uart_rx_push(&evt->data.rx.buf[evt->data.rx.offset], evt->data.rx.len);
+            /*
+             * A chunk that stops short of the buffer end was closed by the RX
+             * timeout (RX_TIMEOUT = t3.5), so the silence is already there. A
+             * chunk that filled its buffer says nothing about what follows:
+             * more bytes are reported within one buffer time plus the RX
+             * timeout, otherwise the idle timer records the silence.
+             */
+            if(evt->data.rx.offset + evt->data.rx.len < sizeof(uart_rx_bufs[0]))
             {
-                if(uart_RXbuf_nchar - 1 >= 0)
-                {
-                    RX_chars[uart_RXbuf_nchar - 1] = '\0';
-                    uart_RXbuf_nchar = uart_RXbuf_nchar - 1;
-                }
+                uart_rx_mark_gap();
             }
             else
             {
-                RX_chars[uart_RXbuf_nchar + 1] = '\0';
-                uart_RXbuf_nchar++;   
-            }           
+                k_timer_start(&uart_rx_idle, K_USEC(UART_RX_IDLE_US), K_NO_WAIT);
+            }
+            k_work_submit_to_queue(&uart_rx_wq, &uart_rx_work);
 		    break;
 
 	    case UART_RX_BUF_REQUEST:
-		    printk("\nUART_RX_BUF_REQUEST event \n\r");
+            /* Hand over the other buffer so reception never pauses */
+            uart_rx_buf_rsp(uart_dev, uart_rx_bufs[uart_rx_next_buf], sizeof(uart_rx_bufs[0]));
+            uart_rx_next_buf ^= 1;
  		    break;
 
 	    case UART_RX_BUF_RELEASED:
-		    printk("\nUART_RX_BUF_RELEASED event \n\r");
 		    break;
 		
 	    case UART_RX_DISABLED:
-            printk("\nUART_RX_DISABLED event \n\r");
-		    err =  uart_rx_enable(uart_dev ,RX_buf,sizeof(RX_buf),RX_TIMEOUT);
+            /* Only happens after an error, start again from the first buffer */
+            uart_rx_next_buf = 1;
+		    err =  uart_rx_enable(uart_dev, uart_rx_bufs[0], sizeof(uart_rx_bufs[0]), RX_TIMEOUT);
             if (err) {
                 printk("\nuart_rx_enable() error. Error code:%d\n\r",err);
-                exit(FATAL_ERR);                
             }
 		    break;
 
@@ -157,151 +612,434 @@ void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
 
 }
 
-void read_user_inp(uint8_t RX_chars_user[RXBUF_SIZE])
+/*
+ * Command handlers. Each one gets its already parsed and range-checked
+ * arguments and leaves its answer in command_state.
+ */
+static int cmd_freq(const struct cmd_desc *cmd, const struct cmd_args *args)
 {
-    strcpy(RX_chars,RX_chars_user);
-
-    /* SET Frequency COMMAND 
-    * For frequency set 20Hz to adc, buttons and outputs
-    * /fa20
-    * /fb20
-    * /fo20
-    */
-    if(RX_chars[0] == '/' && RX_chars[1] == 'f' && (RX_chars[2] == 'b' || RX_chars[2] == 'a' || RX_chars[2] == 'o' || RX_chars[2] == 'u') )   
-    {
-        char *init = strchr(RX_chars, 'f');
-        char *end = strchr(RX_chars, '\r');
-        int len = end - init -2;
-        char number_aux[len];
-        strncpy(number_aux, init+2, len);
-        number_aux[len+1] = '\0';
-        if(RX_chars[2] == 'u')
-        {
-            thread_UART_period = 1/(atoi(number_aux) * 0.001);
-            printf("\nUART frequency: %f",thread_UART_period);
-        }
-        if(RX_chars[2] == 'b')
-        {
-            thread_INPUTS_period = 1/(atoi(number_aux) * 0.001);
-            printf("\nButtons frequency: %f",thread_INPUTS_period);
-        }
-        if(RX_chars[2] == 'a')
-        {
-            thread_ADC_period = 1/(atoi(number_aux) * 0.001);
-            printf("\nADC frequency: %f",thread_ADC_period);
-        }
-        if(RX_chars[2] == 'o')
-        {
-            thread_OUTPUTS_period = 1/(atoi(number_aux) * 0.001);
-            printf("\nLEDs frequency: %f",thread_OUTPUTS_period);
-        }
+    enum period_id id;
+    const char *name;
+    int ret;
+
+    switch(cmd->name[1])
+    {
+        case 'u':
+            id = PERIOD_UI;
+            name = "UART period";
+            break;
+        case 'b':
+            /* Buttons are event driven, the frequency sets the fastest accepted press rate */
+            id = PERIOD_DEBOUNCE;
+            name = "Buttons debounce";
+            break;
+        case 'a':
+            id = PERIOD_ADC;
+            name = "ADC period";
+            break;
+        default:
+            id = PERIOD_OUTPUTS;
+            name = "LEDs period";
+            break;
     }
 
-    /* Read button state COMMAND
-    *   /bx
-    *   x - button to be read, available buttons 1-4.
-    */ 
-    else if(RX_chars[0] == '/' && RX_chars[1] == 'b' && (isdigit(RX_chars[2]) == 1 ))            
+    ret = period_set(id, 1000000 / args->a);
+    if(ret != 0)
     {
-        if(RX_chars[2] == '1')
-        {
-            uint8_t str_aux[RXBUF_SIZE];
-            uint8_t str_message[] = "Button 1 state: "; 
-            sprintf(str_aux,"%i",DB.BUTTON1);
-            strcat(str_message,str_aux);
-            strcpy(command_state,str_message);
-        }
-        else if(RX_chars[2] == '2')
-        {
-            uint8_t str_aux[RXBUF_SIZE];
-            uint8_t str_message[] = "Button 2 state: "; 
-            sprintf(str_aux,"%i",DB.BUTTON2);
-            strcat(str_message,str_aux);
-            strcpy(command_state,str_message);
-        }
-        else if(RX_chars[2] == '3')
-        {
-            uint8_t str_aux[RXBUF_SIZE];
-            uint8_t str_message[] = "Button 3 state: "; 
-            sprintf(str_aux,"%i",DB.BUTTON3);
-            strcat(str_message,str_aux);
-            strcpy(command_state,str_message);
-        }
-        else if(RX_chars[2] == '4')
-        {
-            uint8_t str_aux[RXBUF_SIZE];
-            uint8_t str_message[] = "Button 4 state: "; 
-            sprintf(str_aux,"%i",DB.BUTTON4);
-            strcat(str_message,str_aux);
-            strcpy(command_state,str_message);
-        }
-        else
-        {
-            printf("\nInvalid command");
-            return;
-        }
+        return ret;
     }
+    snprintf(command_state, sizeof(command_state), "%s: %uus", name, period_get(id));
+    return 0;
+}
 
-    /* Set output state COMMAND
-    *   /ox_y
-    *   x - output to be set, outputs available 1-4.
-    *   y - state of the output
-    */
-    else if(RX_chars[0] == '/' && RX_chars[1] == 'o' && (isdigit(RX_chars[2]) == 1) && RX_chars[3] == '_' && (RX_chars[4] == '1' || RX_chars[4] == '0') )      
+static int cmd_button(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    snprintf(command_state, sizeof(command_state), "Button %u state: %d", args->a,
+             (int)db_value(TAG_BUTTON1 + args->a - 1));
+    return 0;
+}
+
+static int cmd_button_events(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    struct button_stats stats;
+
+    button_get_stats(&stats);
+    snprintf(command_state, sizeof(command_state), "Button events: %u, overflows: %u, bounces: %u",
+             stats.events, stats.overflows, stats.bounces);
+    return 0;
+}
+
+static int cmd_output(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    return outputs_request(args->b ? OUTPUT_OP_SET : OUTPUT_OP_CLEAR, BIT(args->a - 1), 0);
+}
+
+static int cmd_output_mask(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    switch(cmd->name[1])
     {
-        if(RX_chars[2] == '1')
-        {
-            k_sem_take(&sem_outputs,  K_FOREVER);   
-            Led_1_newState = RX_chars[4] - '0';
-            k_sem_give(&sem_Led_1_update);
-            k_sem_give(&sem_outputs);
-        }
-        else if(RX_chars[2] == '2')
+        case 's':
+            return outputs_request(OUTPUT_OP_SET, args->a, 0);
+        case 'c':
+            return outputs_request(OUTPUT_OP_CLEAR, args->a, 0);
+        case 't':
+            return outputs_request(OUTPUT_OP_TOGGLE, args->a, 0);
+        default:
+            /* Write covers every output, the mask is the new image */
+            return outputs_request(OUTPUT_OP_WRITE, BIT_MASK(NUM_OUTPUTS), args->a);
+    }
+}
+
+static int cmd_pid(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    static const char *const modes[] = { "off", "on ADC", "on plant model" };
+    int ret;
+
+    switch(cmd->name[1])
+    {
+        case 'p':
+            ret = pid_set(PID_KP, args->a);
+            break;
+        case 'i':
+            ret = pid_set(PID_KI, args->a);
+            break;
+        case 'd':
+            ret = pid_set(PID_KD, args->a);
+            break;
+        case 's':
+            ret = pid_set(PID_SETPOINT, args->a);
+            break;
+        default:
+            ret = pid_start(args->a);
+            break;
+    }
+    if(ret == 0)
+    {
+        snprintf(command_state, sizeof(command_state), "PID %s: sp %d, kp %d ki %d kd %d (/1000)",
+                 (cmd->name[1] == 'r') ? modes[args->a] : "updated", (int)pid_get(PID_SETPOINT),
+                 (int)pid_get(PID_KP), (int)pid_get(PID_KI), (int)pid_get(PID_KD));
+    }
+    return ret;
+}
+
+static int cmd_task_stats(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    if(cmd->name[1] == 'r')
+    {
+        sched_reset_stats();
+        strcpy(command_state, "Task timing reset");
+    }
+    else
+    {
+        show_task_stats = !show_task_stats;
+    }
+    return 0;
+}
+
+static int cmd_bench(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    bench_request();
+    strcpy(command_state, "Benchmarks queued");
+    return 0;
+}
+
+static int cmd_latency(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    latency_request();
+    strcpy(command_state, "Latency benchmarks queued");
+    return 0;
+}
+
+static int cmd_adc(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    struct db_snapshot snap;
+    int ch = args->a;
+
+    if(args->n == 0)
+    {
+        snprintf(command_state, sizeof(command_state), "ADC value is: %d mV",
+                 (int)db_value(TAG_ADC(ADC_POT_CHANNEL)));
+    }
+    else
+    {
+        /* Value and counts of the same publication */
+        db_read(&snap);
+        snprintf(command_state, sizeof(command_state), "ADC channel %d: %d (raw %d)",
+                 ch, (int)db_snap_value(&snap, TAG_ADC(ch)), (int)db_snap_value(&snap, TAG_ADC_RAW(ch)));
+    }
+    return 0;
+}
+
+static int cmd_tag(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    static const char *const quality[] = { [DB_Q_UNINIT] = "uninit", [DB_Q_GOOD] = "good", [DB_Q_BAD] = "bad" };
+    struct db_tag_info tag;
+
+    db_get(args->a, &tag);
+    snprintf(command_state, sizeof(command_state), "Tag %u %s: %d, %s, seq %u at %ums", args->a,
+             db_tag_name[args->a], (int)tag.value, quality[tag.quality], tag.seq, tag.timestamp);
+    return 0;
+}
+
+/*
+ * Sliding windows of one channel in one reply; every window of a channel in
+ * one frame is PROTO_OP_READ_STATS_ALL.
+ */
+static int cmd_wstats(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    struct wstats_result s1, s10, s60;
+    int ch = (args->n == 0) ? ADC_POT_CHANNEL : args->a;
+
+    wstats_get(ch, WSTATS_SLIDE_1S, &s1);
+    wstats_get(ch, WSTATS_SLIDE_10S, &s10);
+    wstats_get(ch, WSTATS_SLIDE_60S, &s60);
+    snprintf(command_state, sizeof(command_state), "ADC %d 1s %d+-%d 10s %d+-%d 60s %d+-%d (%d..%d)",
+             ch, (int)s1.mean, (int)s1.std, (int)s10.mean, (int)s10.std, (int)s60.mean, (int)s60.std,
+             (int)s60.min, (int)s60.max);
+    return 0;
+}
+
+static int cmd_telem(const struct cmd_desc *cmd, const struct cmd_args *args)
+{
+    struct telem_stats stats;
+
+    if(telem_start(args->a, cmd->name[1] == 'p') != 0)
+    {
+        return -EINVAL;
+    }
+    telem_get_stats(&stats);
+    snprintf(command_state, sizeof(command_state), "Telemetry %s: %u rec, %u lost, %u/%u B",
+             args->a ? "on" : "off", stats.records, stats.dropped, stats.bytes, stats.raw_bytes);
+    return 0;
+}
+
+/* Highest frequency of each /f command: the shortest period its subsystem keeps */
+#define FREQ_UI_MAX (1000000 / PERIOD_UI_MIN_US)
+#define FREQ_DEBOUNCE_MAX (1000000 / PERIOD_DEBOUNCE_MIN_US)
+#define FREQ_ADC_MAX (1000000 / PERIOD_ADC_MIN_US)
+#define FREQ_OUTPUTS_MAX (1000000 / PERIOD_OUTPUTS_MIN_US)
+
+/*
+ * Command table: id, name letters, argument schema, argument range, handler.
+ * The enum, the descriptor table and the lookup switch are all generated
+ * from this list, so a new command is one line here plus its handler.
+ */
+#define CMD_LIST(X) \
+    X(FU, 'f', 'u', CMD_ARG_DEC,       1, FREQ_UI_MAX,            cmd_freq)           \
+    X(FB, 'f', 'b', CMD_ARG_DEC,       1, FREQ_DEBOUNCE_MAX,      cmd_freq)           \
+    X(FA, 'f', 'a', CMD_ARG_DEC,       1, FREQ_ADC_MAX,           cmd_freq)           \
+    X(FO, 'f', 'o', CMD_ARG_DEC,       1, FREQ_OUTPUTS_MAX,       cmd_freq)           \
+    X(B,  'b', 0,   CMD_ARG_DIGIT,     1, NUM_BUTTONS,            cmd_button)         \
+    X(BE, 'b', 'e', CMD_ARG_NONE,      0, 0,                      cmd_button_events)  \
+    X(O,  'o', 0,   CMD_ARG_PAIR,      1, NUM_OUTPUTS,            cmd_output)         \
+    X(OS, 'o', 's', CMD_ARG_HEX,       1, BIT_MASK(NUM_OUTPUTS),  cmd_output_mask)    \
+    X(OC, 'o', 'c', CMD_ARG_HEX,       1, BIT_MASK(NUM_OUTPUTS),  cmd_output_mask)    \
+    X(OT, 'o', 't', CMD_ARG_HEX,       1, BIT_MASK(NUM_OUTPUTS),  cmd_output_mask)    \
+    X(OW, 'o', 'w', CMD_ARG_HEX,       0, BIT_MASK(NUM_OUTPUTS),  cmd_output_mask)    \
+    X(PP, 'p', 'p', CMD_ARG_DEC,       0, 1000000,                cmd_pid)            \
+    X(PI, 'p', 'i', CMD_ARG_DEC,       0, 1000000,                cmd_pid)            \
+    X(PD, 'p', 'd', CMD_ARG_DEC,       0, 1000000,                cmd_pid)            \
+    X(PS, 'p', 's', CMD_ARG_DEC,       0, 1000000,                cmd_pid)            \
+    X(PR, 'p', 'r', CMD_ARG_DIGIT,     0, PID_PLANT,              cmd_pid)            \
+    X(S,  's', 0,   CMD_ARG_NONE,      0, 0,                      cmd_task_stats)     \
+    X(SR, 's', 'r', CMD_ARG_NONE,      0, 0,                      cmd_task_stats)     \
+    X(M,  'm', 0,   CMD_ARG_NONE,      0, 0,                      cmd_bench)          \
+    X(L,  'l', 0,   CMD_ARG_NONE,      0, 0,                      cmd_latency)        \
+    X(A,  'a', 0,   CMD_ARG_OPT_DIGIT, 0, ADC_SCAN_CHANNELS - 1,  cmd_adc)            \
+    X(G,  'g', 0,   CMD_ARG_DEC,       0, DB_NUM_TAGS - 1,        cmd_tag)            \
+    X(W,  'w', 0,   CMD_ARG_OPT_DIGIT, 0, ADC_SCAN_CHANNELS - 1,  cmd_wstats)         \
+    X(T,  't', 0,   CMD_ARG_DEC,       0, TELEM_MAX_RATE,         cmd_telem)          \
+    X(TP, 't', 'p', CMD_ARG_DEC,       0, TELEM_MAX_RATE,         cmd_telem)
+
+#define CMD_KEY(c0, c1) (((c0) << 8) | (c1))
+#define CMD_ENUM(id, c0, c1, arg, min, max, fn) CMD_##id,
+#define CMD_DESC(id, c0, c1, arg, min, max, fn) [CMD_##id] = { { c0, c1, 0 }, arg, min, max, fn },
+#define CMD_CASE(id, c0, c1, arg, min, max, fn) case CMD_KEY(c0, c1): return &cmd_table[CMD_##id];
+
+enum cmd_id
+{
+    CMD_LIST(CMD_ENUM)
+    NUM_CMDS
+};
+
+static const struct cmd_desc cmd_table[NUM_CMDS] = {
+    CMD_LIST(CMD_DESC)
+};
+
+/*
+ * Constant-time lookup, the compiler turns the switch into a jump table or a short search.
+ */
+static const struct cmd_desc *cmd_lookup(uint8_t c0, uint8_t c1)
+{
+    switch(CMD_KEY(c0, c1))
+    {
+        CMD_LIST(CMD_CASE)
+        default:
+            return NULL;
+    }
+}
+
+static inline bool cmd_is_name(char c)
+{
+    return c >= 'a' && c <= 'z';
+}
+
+static inline int cmd_hex_value(char c)
+{
+    if(c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+    {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+int cmd_parse(const char *s, size_t len, struct cmd_call *call)
+{
+    const char *end = s + len;
+    const struct cmd_desc *cmd;
+    uint8_t c0, c1 = 0;
+    uint32_t v;
+    int d;
+
+    /* Skip blanks around the command */
+    while(s < end && *s == ' ')
+    {
+        s++;
+    }
+    while(end > s && (end[-1] == ' ' || end[-1] == '\r'))
+    {
+        end--;
+    }
+
+    /* Name: '/' and one or two lowercase letters */
+    if(end - s < 2 || s[0] != '/' || !cmd_is_name(s[1]))
+    {
+        return -EINVAL;
+    }
+    c0 = s[1];
+    s += 2;
+    if(s < end && cmd_is_name(*s))
+    {
+        c1 = *s++;
+    }
+    cmd = cmd_lookup(c0, c1);
+    if(cmd == NULL)
+    {
+        return -ENOENT;
+    }
+
+    /* Arguments, in one pass */
+    call->cmd = cmd;
+    call->args.a = 0;
+    call->args.b = 0;
+    call->args.n = 0;
+    switch(cmd->arg)
+    {
+        case CMD_ARG_NONE:
+            break;
+
+        case CMD_ARG_DEC:
+            for(v = 0; s < end && *s >= '0' && *s <= '9' && v <= cmd->max; s++)
+            {
+                v = v * 10 + (*s - '0');
+                call->args.n = 1;
+            }
+            call->args.a = v;
+            break;
+
+        case CMD_ARG_HEX:
+            for(v = 0; s < end && (d = cmd_hex_value(*s)) >= 0 && v <= cmd->max; s++)
+            {
+                v = (v << 4) | d;
+                call->args.n = 1;
+            }
+            call->args.a = v;
+            break;
+
+        case CMD_ARG_OPT_DIGIT:
+            if(s == end)
+            {
+                break;
+            }
+            /* fall through */
+        case CMD_ARG_DIGIT:
+            if(s < end && *s >= '0' && *s <= '9')
+            {
+                call->args.a = *s++ - '0';
+                call->args.n = 1;
+            }
+            break;
+
+        case CMD_ARG_PAIR:
+            if(end - s >= 3 && s[0] >= '0' && s[0] <= '9' && s[1] == '_' && (s[2] == '0' || s[2] == '1'))
+            {
+                call->args.a = s[0] - '0';
+                call->args.b = s[2] - '0';
+                call->args.n = 2;
+                s += 3;
+            }
+            break;
+    }
+
+    /* Whole token used, and the value in range */
+    if(s != end)
+    {
+        return -EINVAL;
+    }
+    if(cmd->arg != CMD_ARG_NONE && !(cmd->arg == CMD_ARG_OPT_DIGIT && call->args.n == 0))
+    {
+        if(call->args.n == 0 || call->args.a < cmd->min || call->args.a > cmd->max)
         {
-            k_sem_take(&sem_outputs,  K_FOREVER);   
-            Led_2_newState = RX_chars[4] - '0';
-            k_sem_give(&sem_Led_2_update);
-            k_sem_give(&sem_outputs);
+            return -EINVAL;
         }
-        else if(RX_chars[2] == '3')
+    }
+
+    return 0;
+}
+
+void read_user_inp(uint8_t RX_chars_user[RXBUF_SIZE])
+{
+    struct cmd_call call;
+    const char *tok = (const char *)RX_chars_user;
+    const char *sep;
+    size_t len;
+    int ret;
+    bool multi = strchr((const char *)RX_chars_user, ';') != NULL;
+
+    strcpy(RX_chars, RX_chars_user);
+
+    /* Several commands may share a line, separated by ';' */
+    while(1)
+    {
+        sep = strchr(tok, ';');
+        len = (sep != NULL) ? (size_t)(sep - tok) : strlen(tok);
+
+        /* Empty commands of a multi-command line (";;" or a trailing ';') are skipped */
+        if(multi && strspn(tok, " \r") >= len)
         {
-            k_sem_take(&sem_outputs,  K_FOREVER);   
-            Led_3_newState = RX_chars[4] - '0';
-            k_sem_give(&sem_Led_3_update);
-            k_sem_give(&sem_outputs);
         }
-        else if(RX_chars[2] == '4')
+        else if(cmd_parse(tok, len, &call) != 0)
         {
-            k_sem_take(&sem_outputs,  K_FOREVER);   
-            Led_4_newState = RX_chars[4] - '0';
-            k_sem_give(&sem_Led_4_update);
-            k_sem_give(&sem_outputs);
+            snprintf(command_state, sizeof(command_state), "Invalid command: %.*s",
+                     (int)strcspn(tok, ";\r"), tok);
+            return;
         }
-        else
+        else if((ret = call.cmd->handler(call.cmd, &call.args)) != 0)
         {
-            printf("\nInvalid command");
+            /* Well formed but refused by its subsystem */
+            snprintf(command_state, sizeof(command_state), "Failed (%d): %.*s", ret,
+                     (int)strcspn(tok, ";\r"), tok);
             return;
         }
 
+        if(sep == NULL)
+        {
+            break;
+        }
+        tok = sep + 1;
     }
-
-    /* Read ADC state COMMAND 
-    * /a
-    */
-    else if(RX_chars[0] == '/' && RX_chars[1] == 'a')            
-    {
-        uint8_t str_aux[RXBUF_SIZE];
-        uint8_t str_message[] = "ADC value is: "; 
-        k_sem_take(&sem_adc,  K_FOREVER);
-        sprintf(str_aux,"%d",DB.Pot_Voltage);
-        k_sem_give(&sem_adc); 
-        strcat(str_message,str_aux);
-        strcpy(command_state,str_message);
-    }
-
-    else
-    {
-        printf("\nInvalid Command");
-        return;
-    }
-}
\ No newline at end of file
+}
@@ -33,11 +33,105 @@
 #define RXBUF_SIZE 60                   /* RX buffer size */
 #define TXBUF_SIZE 60                   /* TX buffer size */
 #define MSG_BUF_SIZE 100                /* Buffer for messages sent via UART */
-#define RX_TIMEOUT 1000                 /* Inactivity period after the instant when last char was received that triggers an rx event (in us) */
+#define CMD_STATE_SIZE 100              /* Answer of the last command, one UI row with room for the echo of a full line */
+#define UART_TX_FRAME_SIZE 512          /* Size of each of the two TX DMA frames */
+#define UART_RX_RING_SIZE 256           /* Bytes buffered between the RX ISR and the command parser (power of two) */
+#define UART_RX_WQ_STACK_SIZE 2048      /* Stack of the command parser work queue */
+#define UART_RX_WQ_PRIO 3               /* Command parser priority, below the event-driven IO threads */
+#define UART_BAUDRATE 115200            /* Line rate */
+#define UART_RX_GAPS 16                 /* Idle gaps remembered between the RX ISR and the parser (power of two) */
 
-extern uint8_t RX_buf[RXBUF_SIZE];      /* RX buffer, to store received data */
-extern uint8_t RX_chars[RXBUF_SIZE];    /* Chars actually received  */
-extern volatile int uart_RXbuf_nchar;   /* Number of chars currently on the rx buffer */
+/* Modbus RTU t3.5 silence: 3.5 characters of 11 bits, fixed at 1750 us above 19200 baud */
+#define UART_T35_US ((UART_BAUDRATE) > 19200 ? 1750 : (38500000 / (UART_BAUDRATE)))
+#define RX_TIMEOUT UART_T35_US          /* Inactivity period after the instant when last char was received that triggers an rx event (in us) */
+/* Longest the driver stays quiet while bytes keep coming: one RX buffer at 11 bits per char, plus RX_TIMEOUT */
+#define UART_RX_IDLE_US (RXBUF_SIZE * 11000000ULL / (UART_BAUDRATE) + RX_TIMEOUT)
+
+extern uint8_t RX_chars[RXBUF_SIZE];    /* Last command received */
+
+/**
+ * \struct uart_rx_stats
+ * \brief Counters kept by the RX pipeline.
+ */
+struct uart_rx_stats
+{
+    uint32_t bytes;         /**< Bytes received */
+    uint32_t dropped;       /**< Bytes lost because the RX ring was full */
+    uint32_t lines;         /**< Command lines parsed */
+    uint32_t too_long;      /**< Lines discarded for not fitting in RXBUF_SIZE */
+    uint32_t gaps_lost;     /**< Idle gaps not recorded because the gap ring was full */
+};
+
+/**
+ * \brief Argument schemas of the commands.
+ */
+enum cmd_arg_type
+{
+    CMD_ARG_NONE = 0,       /**< No argument */
+    CMD_ARG_DEC,            /**< Decimal number in [min, max] */
+    CMD_ARG_HEX,            /**< Hexadecimal number in [min, max] */
+    CMD_ARG_DIGIT,          /**< One digit in [min, max] */
+    CMD_ARG_OPT_DIGIT,      /**< Optional digit in [min, max] */
+    CMD_ARG_PAIR,           /**< x_y, x a digit in [min, max] and y 0 or 1 */
+};
+
+/**
+ * \struct cmd_args
+ * \brief Parsed arguments of a command.
+ */
+struct cmd_args
+{
+    uint32_t a;             /**< First argument */
+    uint32_t b;             /**< Second argument (CMD_ARG_PAIR) */
+    uint8_t n;              /**< Number of arguments given */
+};
+
+struct cmd_desc;
+
+/**
+ * \brief Command handler.
+ * \param cmd Command descriptor, lets one handler serve several commands.
+ * \param args Parsed, range-checked arguments.
+ * \return 0 if successful, negative value to report an invalid command.
+ */
+typedef int (*cmd_handler_t)(const struct cmd_desc *cmd, const struct cmd_args *args);
+
+/**
+ * \struct cmd_desc
+ * \brief Entry of the command table.
+ */
+struct cmd_desc
+{
+    char name[3];           /**< Letters after '/', one or two */
+    uint8_t arg;            /**< Argument schema (enum cmd_arg_type) */
+    uint32_t min;           /**< Smallest accepted argument */
+    uint32_t max;           /**< Largest accepted argument */
+    cmd_handler_t handler;  /**< Function run by the command */
+};
+
+/**
+ * \struct cmd_call
+ * \brief A parsed command, ready to run.
+ */
+struct cmd_call
+{
+    const struct cmd_desc *cmd;
+    struct cmd_args args;
+};
+
+/**
+ * \brief Parses one command.
+ *
+ * The name is resolved with a switch generated from the command table and the
+ * arguments are parsed in the same pass, so the cost does not depend on the
+ * number of commands.
+ *
+ * \param s Command text, e.g. "/fu20". Need not be null terminated.
+ * \param len Length of s.
+ * \param call Destination of the parsed command.
+ * \return 0 if successful, -ENOENT for an unknown name, -EINVAL for bad arguments.
+ */
+int cmd_parse(const char *s, size_t len, struct cmd_call *call);
 
 /**
  * \brief Prints the UI.
@@ -47,11 +141,84 @@ extern volatile int uart_RXbuf_nchar;   /* Number of chars currently on the rx b
  */
 void print_UI();
 
+struct sched_task;
+struct sched_stats;
+
+/**
+ * \brief Formats the timing row of a task, as the task table of the UI shows it.
+ *
+ * Shared by print_UI() and the ui_row benchmark (bench.h).
+ *
+ * \param buf Destination of the row text.
+ * \param size Size of buf.
+ * \param task Task of the row.
+ * \param st Job timing of the task.
+ * \return Length of the row, as snprintf().
+ */
+int print_task_row(char *buf, size_t size, const struct sched_task *task, const struct sched_stats *st);
+
+/**
+ * \brief Queues bytes for transmission.
+ *
+ * Bytes are appended to the TX frame being filled. A full frame is handed to
+ * the DMA with uart_tx() while the next one fills, so the caller only waits
+ * if it fills a second frame before the first one is out. Thread context only.
+ *
+ * \param buf Bytes to send.
+ * \param len Number of bytes.
+ */
+void uart_tx_write(const uint8_t *buf, size_t len);
+
+/**
+ * \brief Queues bytes for transmission without ever waiting.
+ *
+ * The bytes are kept together in one TX frame, and transmission starts at once
+ * if the line is idle. Otherwise they leave with the next call or flush; a
+ * call with len 0 only starts a frame left pending. Safe for tasks that must
+ * not block on the UART.
+ *
+ * \param buf Bytes to send.
+ * \param len Number of bytes, at most UART_TX_FRAME_SIZE.
+ * \return 0 if queued, -EBUSY if both frames are taken, -EINVAL if len is too large.
+ */
+int uart_tx_write_nowait(const uint8_t *buf, size_t len);
+
+/**
+ * \brief Formats text straight into the TX frame being filled.
+ *
+ * Same rules as uart_tx_write(). Text longer than a frame is truncated.
+ *
+ * \param fmt printf-style format.
+ */
+void uart_tx_printf(const char *fmt, ...);
+
+/**
+ * \brief Starts the transmission of the frame being filled, if not empty.
+ */
+void uart_tx_flush(void);
+
+/**
+ * \brief Copies the RX pipeline counters.
+ * \param stats Destination of the counters.
+ */
+void uart_rx_get_stats(struct uart_rx_stats *stats);
+
+/**
+ * \brief Feeds bytes to the command parser as if they had been received.
+ *
+ * Used by the latency benchmarks (latency.h). Must not be called from an interrupt.
+ *
+ * \param buf Bytes to feed.
+ * \param len Number of bytes; what does not fit in the RX ring is dropped and counted.
+ */
+void uart_rx_inject(const uint8_t *buf, size_t len);
+
 /**
  * \brief Initializes the UART.
  *
  * This function initializes and configures the UART device. It sets up the UART
- * configuration, registers the UART callback, and enables data reception.
+ * configuration, registers the UART callback, starts the command parser work
+ * queue and enables double-buffered data reception.
  *
  * \return 0 on success, FATAL_ERR on failure.
  */
@@ -63,7 +230,8 @@ int uart_init();
  * This function handles UART events. Callback functions are executed in the scope
  * of interrupt handlers and run asynchronously after hardware/software interrupts.
  * They have a higher priority than tasks/threads and should be short and simple.
- * Heavier processing should be deferred to a task with suitable priority.
+ * Received bytes are only copied into the RX ring; line assembly and parsing run
+ * in the command parser work queue.
  *
  * \param dev The UART device.
  * \param evt The UART event.
@@ -74,6 +242,8 @@ void uart_cb(const struct device *dev, struct uart_event *evt, void *user_data);
 /**
  * \brief Reads user input from UART.
  *
+ * Runs in the command parser work queue, once per received line. The line may
+ * hold several commands separated by ';', run in order until one fails.
  * This function processes user input commands received via UART. It handles
  * commands for setting frequencies, reading button states, setting output
  * states, and reading ADC values.
@@ -0,0 +1,113 @@
+/**
+ * \file ui.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Differential terminal renderer.
+ */
+
+#include "ui.h"
+#include "uart.h"
+#include <stdarg.h>
+
+static char ui_screen[UI_ROWS][UI_COLS];    /* What every row of the terminal shows */
+static char ui_line[UI_COLS];
+static int ui_rows;                         /* Rows drawn by the frame being built */
+static int ui_prev_rows;                    /* Rows drawn by the previous frame */
+static bool ui_sent;                        /* Something was sent in this frame */
+static bool ui_full = true;                 /* Next frame redraws the whole screen */
+
+void ui_begin(void)
+{
+    ui_rows = 0;
+    ui_sent = false;
+
+    if(ui_full)
+    {
+        memset(ui_screen, 0, sizeof(ui_screen));
+        ui_prev_rows = 0;
+        uart_tx_printf("\033[2J");
+        ui_sent = true;
+    }
+}
+
+/*
+ * Formats a row into line and, if it differs from what the row shows, copies
+ * it into shown. Tells whether the row changed.
+ */
+static bool ui_row_vupdate(char *shown, char *line, const char *fmt, va_list args)
+{
+    vsnprintf(line, UI_COLS, fmt, args);
+    if(strcmp(line, shown) == 0)
+    {
+        return false;
+    }
+    strcpy(shown, line);
+    return true;
+}
+
+void ui_printf(int row, const char *fmt, ...)
+{
+    va_list args;
+    bool changed;
+
+    if(row < 0 || row >= UI_ROWS)
+    {
+        return;
+    }
+
+    va_start(args, fmt);
+    changed = ui_row_vupdate(ui_screen[row], ui_line, fmt, args);
+    va_end(args);
+
+    ui_rows = MAX(ui_rows, row + 1);
+    if(!changed)
+    {
+        return;
+    }
+
+    /* Row is 1-based for the terminal */
+    uart_tx_printf("\033[%d;1H%s\033[K", row + 1, ui_screen[row]);
+    ui_sent = true;
+}
+
+bool ui_row_update(char *shown, const char *fmt, ...)
+{
+    char line[UI_COLS];
+    va_list args;
+    bool changed;
+
+    va_start(args, fmt);
+    changed = ui_row_vupdate(shown, line, fmt, args);
+    va_end(args);
+    return changed;
+}
+
+void ui_end(void)
+{
+    int row;
+
+    /* Erase what the previous frame left below this one */
+    for(row = ui_rows; row < ui_prev_rows; row++)
+    {
+        if(ui_screen[row][0] != '\0')
+        {
+            uart_tx_printf("\033[%d;1H\033[K", row + 1);
+            ui_screen[row][0] = '\0';
+            ui_sent = true;
+        }
+    }
+    ui_prev_rows = ui_rows;
+    ui_full = false;
+
+    /* Park the cursor below the frame */
+    if(ui_sent)
+    {
+        uart_tx_printf("\033[%d;1H", ui_rows + 1);
+        uart_tx_flush();
+    }
+}
+
+void ui_invalidate(void)
+{
+    ui_full = true;
+}
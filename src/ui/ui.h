@@ -0,0 +1,65 @@
+/**
+ * \file ui.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Differential terminal renderer.
+ *
+ * A frame is drawn row by row between ui_begin() and ui_end(). The renderer
+ * keeps what each row last showed and only sends the rows whose text changed,
+ * each one as a cursor move, the new text and an erase to end of line. An
+ * idle screen therefore costs nothing on the wire, and the refresh cost
+ * follows the amount of change instead of the screen size.
+ */
+
+#ifndef UI_H
+#define UI_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define UI_ROWS 48              /* Rows the renderer can address */
+#define UI_COLS 160             /* Longest row, escape sequences included */
+
+/**
+ * \brief Starts a new frame.
+ */
+void ui_begin(void);
+
+/**
+ * \brief Draws one row of the frame.
+ *
+ * The row is sent only if its text differs from what the terminal shows.
+ *
+ * \param row Row number, 0 is the top of the screen.
+ * \param fmt printf-style format of the row text.
+ */
+void ui_printf(int row, const char *fmt, ...);
+
+/**
+ * \brief Formats a row the caller keeps and tells whether it changed.
+ *
+ * The formatting and change detection of ui_printf(), without the screen
+ * and without sending anything. Lets the benchmarks time the renderer while
+ * the UI task draws.
+ *
+ * \param shown What the row shows, UI_COLS bytes; takes the new text if it changed.
+ * \param fmt printf-style format of the row text.
+ * \return true if the text differs from shown.
+ */
+bool ui_row_update(char *shown, const char *fmt, ...);
+
+/**
+ * \brief Ends the frame.
+ *
+ * Rows drawn by the previous frame but not by this one are erased, then
+ * everything is handed to the UART TX engine.
+ */
+void ui_end(void);
+
+/**
+ * \brief Forces the next frame to clear the screen and draw every row.
+ */
+void ui_invalidate(void);
+
+#endif /* UI_H */
@@ -0,0 +1,348 @@
+/**
+ * \file wstats.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Windowed count, min, max, mean and standard deviation of every ADC channel.
+ */
+
+#include "wstats.h"
+#include "conv.h"
+
+#define WSTATS_RAW_MAX ((1 << ADC_RESOLUTION) - 1)
+#define WSTATS_SLOPE_SPAN 16            /* Counts around the mean the conversion slope is measured over */
+
+/*
+ * Exact aggregates of a set of raw samples. An empty set has min > max so
+ * that merging it changes nothing. With ADC_RESOLUTION-bit (10-bit) samples
+ * sum and sumsq fit in 64 bits for any 32-bit n; the variance works on n * sumsq - sum^2, which
+ * needs 128 bits past about a million samples, so wstats_get() computes it
+ * with wstats_u128.
+ */
+struct wstats_acc
+{
+    uint32_t n;
+    int16_t min;
+    int16_t max;
+    int64_t sum;
+    uint64_t sumsq;
+};
+
+static const struct wstats_acc wstats_empty = { .n = 0, .min = INT16_MAX, .max = INT16_MIN };
+static const uint8_t wstats_seconds[] = { 1, 10, 60 };     /* Length of the windows, in seconds */
+
+BUILD_ASSERT(WSTATS_TUMBLE_1S - WSTATS_SLIDE_1S == ARRAY_SIZE(wstats_seconds), "one length per sliding window");
+BUILD_ASSERT(WSTATS_COARSE_BUCKETS >= 60, "the coarse ring must hold the longest window");
+
+/* Running state of one channel, only touched by the ADC thread */
+struct wstats_chan
+{
+    struct wstats_acc fine;                                 /* Open bucket */
+    struct wstats_acc second;                               /* Open second, merged from closed buckets */
+    struct wstats_acc tumble[ARRAY_SIZE(wstats_seconds)];   /* Open tumbling periods */
+    struct wstats_acc fine_ring[WSTATS_FINE_BUCKETS];       /* Closed buckets of the last second */
+    struct wstats_acc coarse_ring[WSTATS_COARSE_BUCKETS];   /* Closed seconds */
+};
+
+static struct wstats_chan wstats_chan[ADC_SCAN_CHANNELS];
+static uint32_t wstats_frames;          /* Frames in the open bucket */
+static uint32_t wstats_bucket_frames;   /* Frames per bucket at the current interval */
+static uint8_t wstats_fine_head;        /* Next slot of fine_ring */
+static uint8_t wstats_coarse_head;      /* Next slot of coarse_ring */
+static uint32_t wstats_closed;          /* Seconds closed since the last restart */
+
+/* Windows, rebuilt when a bucket closes and read by wstats_get() */
+static struct k_spinlock wstats_lock;
+static struct wstats_acc wstats_win[ADC_SCAN_CHANNELS][NUM_WSTATS_WINDOWS];
+
+static inline void wstats_merge(struct wstats_acc *dst, const struct wstats_acc *src)
+{
+    dst->n += src->n;
+    dst->min = MIN(dst->min, src->min);
+    dst->max = MAX(dst->max, src->max);
+    dst->sum += src->sum;
+    dst->sumsq += src->sumsq;
+}
+
+/*
+ * Merges the last count entries of a ring whose next slot is head.
+ */
+static void wstats_ring_sum(const struct wstats_acc *ring, int size, int head, int count, struct wstats_acc *out)
+{
+    int i;
+
+    *out = wstats_empty;
+    for(i = 1; i <= count; i++)
+    {
+        wstats_merge(out, &ring[(head - i + size) % size]);
+    }
+}
+
+void wstats_set_interval(uint32_t interval_us)
+{
+    k_spinlock_key_t key;
+    int ch, i;
+
+    wstats_bucket_frames = MAX(1, WSTATS_FINE_US / MAX(interval_us, 1));
+    wstats_frames = 0;
+    wstats_fine_head = 0;
+    wstats_coarse_head = 0;
+    wstats_closed = 0;
+    for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+    {
+        wstats_chan[ch].fine = wstats_empty;
+        wstats_chan[ch].second = wstats_empty;
+        for(i = 0; i < ARRAY_SIZE(wstats_seconds); i++)
+        {
+            wstats_chan[ch].tumble[i] = wstats_empty;
+        }
+        for(i = 0; i < WSTATS_FINE_BUCKETS; i++)
+        {
+            wstats_chan[ch].fine_ring[i] = wstats_empty;
+        }
+        for(i = 0; i < WSTATS_COARSE_BUCKETS; i++)
+        {
+            wstats_chan[ch].coarse_ring[i] = wstats_empty;
+        }
+    }
+
+    key = k_spin_lock(&wstats_lock);
+    for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+    {
+        for(i = 0; i < NUM_WSTATS_WINDOWS; i++)
+        {
+            wstats_win[ch][i] = wstats_empty;
+        }
+    }
+    k_spin_unlock(&wstats_lock, key);
+}
+
+/*
+ * Closes the open bucket of every channel, and the open second once it has
+ * all its buckets, then rebuilds the windows that changed.
+ */
+static void wstats_close(void)
+{
+    struct wstats_acc win[NUM_WSTATS_WINDOWS];
+    struct wstats_chan *c;
+    k_spinlock_key_t key;
+    bool second;
+    int ch, i;
+
+    second = ((wstats_fine_head + 1) % WSTATS_FINE_BUCKETS == 0);
+    for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+    {
+        c = &wstats_chan[ch];
+        c->fine_ring[wstats_fine_head] = c->fine;
+        wstats_merge(&c->second, &c->fine);
+        c->fine = wstats_empty;
+        wstats_ring_sum(c->fine_ring, WSTATS_FINE_BUCKETS, wstats_fine_head + 1, WSTATS_FINE_BUCKETS,
+                        &win[WSTATS_SLIDE_1S]);
+
+        if(second)
+        {
+            c->coarse_ring[wstats_coarse_head] = c->second;
+            for(i = 1; i < ARRAY_SIZE(wstats_seconds); i++)
+            {
+                wstats_ring_sum(c->coarse_ring, WSTATS_COARSE_BUCKETS, wstats_coarse_head + 1, wstats_seconds[i],
+                                &win[WSTATS_SLIDE_1S + i]);
+            }
+            for(i = 0; i < ARRAY_SIZE(wstats_seconds); i++)
+            {
+                wstats_merge(&c->tumble[i], &c->second);
+            }
+            c->second = wstats_empty;
+        }
+
+        key = k_spin_lock(&wstats_lock);
+        wstats_win[ch][WSTATS_SLIDE_1S] = win[WSTATS_SLIDE_1S];
+        if(second)
+        {
+            for(i = 0; i < ARRAY_SIZE(wstats_seconds); i++)
+            {
+                wstats_win[ch][WSTATS_SLIDE_1S + i] = win[WSTATS_SLIDE_1S + i];
+                if((wstats_closed + 1) % wstats_seconds[i] == 0)
+                {
+                    wstats_win[ch][WSTATS_TUMBLE_1S + i] = c->tumble[i];
+                }
+            }
+        }
+        k_spin_unlock(&wstats_lock, key);
+
+        if(second)
+        {
+            for(i = 0; i < ARRAY_SIZE(wstats_seconds); i++)
+            {
+                if((wstats_closed + 1) % wstats_seconds[i] == 0)
+                {
+                    c->tumble[i] = wstats_empty;
+                }
+            }
+        }
+    }
+
+    wstats_fine_head = (wstats_fine_head + 1) % WSTATS_FINE_BUCKETS;
+    if(second)
+    {
+        wstats_coarse_head = (wstats_coarse_head + 1) % WSTATS_COARSE_BUCKETS;
+        wstats_closed++;
+    }
+}
+
+void wstats_block(const struct adc_block *blk)
+{
+    struct wstats_acc *acc;
+    int32_t x;
+    int f, ch;
+
+    for(f = 0; f < ADC_BLOCK_SAMPLES; f++)
+    {
+        for(ch = 0; ch < ADC_SCAN_CHANNELS; ch++)
+        {
+            acc = &wstats_chan[ch].fine;
+            x = blk->samples[f][ch];
+            acc->n++;
+            acc->sum += x;
+            acc->sumsq += (uint32_t)(x * x);
+            acc->min = MIN(acc->min, x);
+            acc->max = MAX(acc->max, x);
+        }
+        if(++wstats_frames >= wstats_bucket_frames)
+        {
+            wstats_frames = 0;
+            wstats_close();
+        }
+    }
+}
+
+/*
+ * Unsigned 128-bit integer, just enough arithmetic for the variance: the
+ * targets have no native 128-bit type.
+ */
+struct wstats_u128
+{
+    uint64_t hi;
+    uint64_t lo;
+};
+
+static struct wstats_u128 wstats_mul64(uint64_t a, uint64_t b)
+{
+    uint64_t p00 = (a & UINT32_MAX) * (b & UINT32_MAX);
+    uint64_t p01 = (a & UINT32_MAX) * (b >> 32);
+    uint64_t p10 = (a >> 32) * (b & UINT32_MAX);
+    uint64_t mid = (p00 >> 32) + (p01 & UINT32_MAX) + (p10 & UINT32_MAX);
+    struct wstats_u128 r;
+
+    r.lo = (mid << 32) | (p00 & UINT32_MAX);
+    r.hi = (a >> 32) * (b >> 32) + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+    return r;
+}
+
+static struct wstats_u128 wstats_sub128(struct wstats_u128 a, struct wstats_u128 b)
+{
+    struct wstats_u128 r;
+
+    r.lo = a.lo - b.lo;
+    r.hi = a.hi - b.hi - (a.lo < b.lo);
+    return r;
+}
+
+/*
+ * Long division by a 32-bit divisor, one 32-bit digit at a time, floor.
+ */
+static struct wstats_u128 wstats_div128(struct wstats_u128 a, uint32_t d)
+{
+    uint32_t digits[4] = { a.hi >> 32, (uint32_t)a.hi, a.lo >> 32, (uint32_t)a.lo };
+    uint64_t rem = 0, cur;
+    int i;
+
+    for(i = 0; i < 4; i++)
+    {
+        cur = (rem << 32) | digits[i];
+        digits[i] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+    return (struct wstats_u128){ ((uint64_t)digits[0] << 32) | digits[1], ((uint64_t)digits[2] << 32) | digits[3] };
+}
+
+/*
+ * Integer square root, floor.
+ */
+static uint32_t wstats_isqrt(uint64_t v)
+{
+    uint64_t r = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while(bit > v)
+    {
+        bit >>= 2;
+    }
+    while(bit != 0)
+    {
+        if(v >= r + bit)
+        {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+int wstats_get(int ch, enum wstats_window w, struct wstats_result *res)
+{
+    struct wstats_acc acc;
+    k_spinlock_key_t key;
+    struct wstats_u128 d;
+    uint64_t abs_sum, var_q16;
+    int64_t mean_q8, slope_q8;
+    int32_t r0, lo, hi, v0, v1;
+
+    if(ch < 0 || ch >= ADC_SCAN_CHANNELS || w >= NUM_WSTATS_WINDOWS)
+    {
+        return -EINVAL;
+    }
+
+    key = k_spin_lock(&wstats_lock);
+    acc = wstats_win[ch][w];
+    k_spin_unlock(&wstats_lock, key);
+
+    memset(res, 0, sizeof(*res));
+    res->count = acc.n;
+    if(acc.n == 0)
+    {
+        return 0;
+    }
+
+    /* Min and max: the conversion is monotonic but may decrease (NTC) */
+    v0 = conv_apply(ch, acc.min);
+    v1 = conv_apply(ch, acc.max);
+    res->min = MIN(v0, v1);
+    res->max = MAX(v0, v1);
+
+    /* Mean: raw mean with 8 fractional bits, converted between its two neighbouring codes */
+    mean_q8 = (acc.sum * 256 + (acc.sum < 0 ? -(int64_t)acc.n : (int64_t)acc.n) / 2) / (int64_t)acc.n;
+    r0 = (int32_t)(mean_q8 >> 8);
+    v0 = conv_apply(ch, r0);
+    v1 = conv_apply(ch, r0 + 1);
+    res->mean = v0 + (int32_t)(((int64_t)(v1 - v0) * (mean_q8 & 0xFF) + 128) >> 8);
+
+    /*
+     * Variance, exact: n^2 var = n sumsq - sum^2 >= 0, in 128 bits, then
+     * scaled by the slope at the mean. The variance of 10-bit samples is at
+     * most 2^18, so var_q16 fits in 64 bits.
+     */
+    abs_sum = (uint64_t)(acc.sum < 0 ? -acc.sum : acc.sum);
+    d = wstats_sub128(wstats_mul64(acc.n, acc.sumsq), wstats_mul64(abs_sum, abs_sum));
+    d = (struct wstats_u128){ (d.hi << 16) | (d.lo >> 48), d.lo << 16 };
+    var_q16 = wstats_div128(wstats_div128(d, acc.n), acc.n).lo;
+    lo = CLAMP(r0 - WSTATS_SLOPE_SPAN, 0, WSTATS_RAW_MAX - 2 * WSTATS_SLOPE_SPAN);
+    hi = lo + 2 * WSTATS_SLOPE_SPAN;
+    slope_q8 = ((int64_t)(conv_apply(ch, hi) - conv_apply(ch, lo)) << 8) / (hi - lo);
+    slope_q8 = (slope_q8 < 0) ? -slope_q8 : slope_q8;
+    res->std = (int32_t)(((int64_t)wstats_isqrt(var_q16) * slope_q8 + BIT(15)) >> 16);
+    return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * \file wstats.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Windowed count, min, max, mean and standard deviation of every ADC channel.
+ *
+ * wstats_block() runs in the ADC thread on every block and adds each raw
+ * sample to the open bucket of its channel: a count, a sum, a sum of squares
+ * and a min/max, a few integer operations per sample and no division. The
+ * samples are integers, so the sums are exact and the variance computed from
+ * them at query time has no rounding error to accumulate, unlike a
+ * floating-point running mean; it equals what Welford's update would give in
+ * exact arithmetic. Exact sums also merge by addition, which is what the
+ * windows are built from.
+ *
+ * Buckets close every WSTATS_FINE_US, counted in scan frames. Closed buckets
+ * are kept in two rings, WSTATS_FINE_BUCKETS of WSTATS_FINE_US and
+ * WSTATS_COARSE_BUCKETS of one second each, and every window is rebuilt from
+ * them when a bucket closes:
+ *
+ *     WSTATS_SLIDE_*     last 1 s (updated every WSTATS_FINE_US), 10 s or 60 s (every second)
+ *     WSTATS_TUMBLE_*    last completed 1 s, 10 s or 60 s period
+ *
+ * Results are converted to engineering units at query time only (conv.h):
+ * min, max and mean exactly, the standard deviation through the slope of the
+ * conversion at the mean. Changing the sampling interval restarts every
+ * window, and blocks dropped by an overrun are missing from the counts.
+ */
+
+#ifndef WSTATS_H
+#define WSTATS_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+#include "adc.h"
+
+#define WSTATS_FINE_US 100000           /* Bucket length */
+#define WSTATS_FINE_BUCKETS 10          /* Buckets per second, WSTATS_FINE_BUCKETS * WSTATS_FINE_US = 1 s */
+#define WSTATS_COARSE_BUCKETS 60        /* Seconds of history, the longest window */
+
+/**
+ * \brief Windows kept for every channel.
+ */
+enum wstats_window
+{
+    WSTATS_SLIDE_1S = 0,    /**< Last second */
+    WSTATS_SLIDE_10S,       /**< Last 10 seconds */
+    WSTATS_SLIDE_60S,       /**< Last 60 seconds */
+    WSTATS_TUMBLE_1S,       /**< Last completed second */
+    WSTATS_TUMBLE_10S,      /**< Last completed 10 s period */
+    WSTATS_TUMBLE_60S,      /**< Last completed 60 s period */
+    NUM_WSTATS_WINDOWS
+};
+
+/**
+ * \struct wstats_result
+ * \brief Aggregates of one window, in the units of the channel (milli-units).
+ */
+struct wstats_result
+{
+    uint32_t count;         /**< Samples in the window, 0 if it has none yet */
+    int32_t min;            /**< Smallest value */
+    int32_t max;            /**< Largest value */
+    int32_t mean;           /**< Mean value */
+    int32_t std;            /**< Standard deviation (population) */
+};
+
+/**
+ * \brief Restarts every window for a new sampling interval.
+ *
+ * Call from the ADC thread whenever the sequence is (re)armed.
+ *
+ * \param interval_us Time between two scan frames (in us).
+ */
+void wstats_set_interval(uint32_t interval_us);
+
+/**
+ * \brief Adds the samples of a block. Runs in the ADC thread.
+ * \param blk Block obtained with adc_stream_get().
+ */
+void wstats_block(const struct adc_block *blk);
+
+/**
+ * \brief Returns the aggregates of one window of one channel.
+ * \param ch Scan list index.
+ * \param w Window.
+ * \param res Destination.
+ * \return 0 if successful, -EINVAL for an unknown channel or window.
+ */
+int wstats_get(int ch, enum wstats_window w, struct wstats_result *res);
+
+#endif /* WSTATS_H */
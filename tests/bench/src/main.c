@@ -0,0 +1,51 @@
+/**
+ * \file main.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief The application under test, started once for every suite.
+ *
+ * ztest provides main(); the start sequence of the application main() is
+ * run instead from the setup of the first suite.
+ */
+
+#include <zephyr/kernel.h>
+#include "test_app.h"
+#include "db.h"
+#include "threads.h"
+#include "uart.h"
+#include "IO.h"
+#include "adc.h"
+#include "bench.h"
+#include "hist.h"
+#include "pid.h"
+
+static bool test_started;
+static int test_uart_err;
+
+void *test_app_start(void)
+{
+    if(test_started)
+    {
+        return NULL;
+    }
+    test_started = true;
+
+    /* Same order as main() of the application */
+    db_init();
+    outputs_config();
+    /* Targets without an asynchronous UART run without the command line */
+    test_uart_err = uart_init();
+    button_config();
+    adc_stream_init();
+    hist_init();
+    pid_init();
+    bench_init();
+    configure_threads();
+
+    return NULL;
+}
+
+bool test_uart_ready(void)
+{
+    return test_uart_err == 0;
+}
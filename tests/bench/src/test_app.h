@@ -0,0 +1,28 @@
+/**
+ * \file test_app.h
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief The application under test, started once for every suite.
+ */
+
+#ifndef TEST_APP_H
+#define TEST_APP_H
+
+#include <stdbool.h>
+
+/**
+ * \brief Starts the application as its main() does, the first time only.
+ *
+ * Meant as the setup function of every suite, so the hot paths are timed
+ * with the application threads running, as with the /m command.
+ *
+ * \return NULL, the suites keep no fixture.
+ */
+void *test_app_start(void);
+
+/**
+ * \brief Tells whether the command line is running (uart_init() succeeded).
+ */
+bool test_uart_ready(void);
+
+#endif /* TEST_APP_H */
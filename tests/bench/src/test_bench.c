@@ -0,0 +1,46 @@
+/**
+ * \file test_bench.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Cycle budgets of the hot paths.
+ *
+ * Every case of bench_cases[] with a budget is timed BENCH_ITERATIONS times
+ * by bench_run() (timing_counter_get(), min/median/max printed), with the
+ * inputs the /m command gives it, and the test fails if a median goes over
+ * its budget times CONFIG_BENCH_TEST_BUDGET_PERCENT.
+ */
+
+#include <zephyr/ztest.h>
+#include "test_app.h"
+#include "bench.h"
+
+ZTEST(bench, test_budgets)
+{
+    const struct bench_case *c;
+    struct bench_result res;
+    int i, over = 0;
+
+    bench_cases_prepare();
+    for(i = 0; i < BENCH_NUM_CASES; i++)
+    {
+        c = &bench_cases[i];
+        if(c->cycles == 0)
+        {
+            continue;
+        }
+        if(bench_run(c, &res) == -EAGAIN)
+        {
+            TC_PRINT("%s: cannot run now, skipped\n", c->name);
+            continue;
+        }
+        if((uint64_t)res.median * 100 > (uint64_t)res.budget * CONFIG_BENCH_TEST_BUDGET_PERCENT)
+        {
+            TC_PRINT("%s: median %u cycles, budget %u x %d%%\n", c->name, res.median, res.budget,
+                     CONFIG_BENCH_TEST_BUDGET_PERCENT);
+            over++;
+        }
+    }
+    zassert_equal(over, 0, "%d hot paths over budget", over);
+}
+
+ZTEST_SUITE(bench, NULL, test_app_start, NULL, NULL, NULL);
@@ -0,0 +1,100 @@
+/**
+ * \file test_cmd.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Command parser: resolved commands, range checks and constant cost.
+ */
+
+#include <zephyr/ztest.h>
+#include <string.h>
+#include <stdio.h>
+#include "test_app.h"
+#include "bench.h"
+#include "uart.h"
+#include "threads.h"
+#include "IO.h"
+
+#define TEST_CMD_SPREAD_PERCENT 25      /* Largest parse cost difference between both ends of the table */
+#define TEST_CMD_SPREAD_MIN 16          /* Counts always allowed, for coarse timing counters */
+
+static int test_parse(const char *s, struct cmd_call *call)
+{
+    return cmd_parse(s, strlen(s), call);
+}
+
+ZTEST(cmd, test_resolve)
+{
+    struct cmd_call call;
+
+    zassert_ok(test_parse("/fu10", &call));
+    zassert_true(strcmp(call.cmd->name, "fu") == 0, "resolved to /%s", call.cmd->name);
+    zassert_equal(call.args.a, 10);
+    zassert_equal(call.args.n, 1);
+
+    zassert_ok(test_parse("/o3_1", &call));
+    zassert_true(strcmp(call.cmd->name, "o") == 0, "resolved to /%s", call.cmd->name);
+    zassert_equal(call.args.a, 3);
+    zassert_equal(call.args.b, 1);
+    zassert_equal(call.args.n, 2);
+
+    zassert_ok(test_parse("/owf", &call));
+    zassert_true(strcmp(call.cmd->name, "ow") == 0, "resolved to /%s", call.cmd->name);
+    zassert_equal(call.args.a, 0xf);
+
+    zassert_ok(test_parse("/a", &call));
+    zassert_equal(call.args.n, 0);
+    zassert_ok(test_parse("/a2", &call));
+    zassert_equal(call.args.a, 2);
+
+    /* Blanks around the command and the line ending are not part of it */
+    zassert_ok(test_parse(" /tp100 \r", &call));
+    zassert_true(strcmp(call.cmd->name, "tp") == 0, "resolved to /%s", call.cmd->name);
+    zassert_equal(call.args.a, 100);
+}
+
+ZTEST(cmd, test_reject)
+{
+    struct cmd_call call;
+    char s[16];
+
+    zassert_equal(test_parse("/zz", &call), -ENOENT);
+    zassert_equal(test_parse("/fu", &call), -EINVAL);
+    zassert_equal(test_parse("/fu10x", &call), -EINVAL);
+    zassert_equal(test_parse("fu10", &call), -EINVAL);
+    zassert_equal(test_parse("/fa0", &call), -EINVAL);
+
+    /* Out of range: one above the highest UI frequency and a missing button */
+    snprintf(s, sizeof(s), "/fu%u", 1000000 / PERIOD_UI_MIN_US + 1);
+    zassert_equal(test_parse(s, &call), -EINVAL, "%s accepted", s);
+    snprintf(s, sizeof(s), "/b%d", NUM_BUTTONS + 1);
+    zassert_equal(test_parse(s, &call), -EINVAL, "%s accepted", s);
+    zassert_equal(test_parse("/o3_2", &call), -EINVAL);
+}
+
+/*
+ * Fails if the medians of a and b are further apart than the allowed spread.
+ */
+static void test_spread(const char *a, const char *b)
+{
+    struct bench_result ra, rb;
+    uint32_t lo, hi;
+
+    bench_measure(a, bench_cmd_parse, (void *)a, 1, &ra);
+    bench_measure(b, bench_cmd_parse, (void *)b, 1, &rb);
+    lo = MIN(ra.median, rb.median);
+    hi = MAX(ra.median, rb.median);
+    zassert_true(hi <= lo + lo * TEST_CMD_SPREAD_PERCENT / 100 + TEST_CMD_SPREAD_MIN,
+                 "%s %u cycles, %s %u cycles", a, ra.median, b, rb.median);
+}
+
+/*
+ * Commands at both ends of the table cost the same, for the same argument
+ * schema: the name lookup does not walk the table.
+ */
+ZTEST(cmd, test_cost)
+{
+    test_spread("/fu10", "/tp100");
+    test_spread("/a1", "/w1");
+}
+
+ZTEST_SUITE(cmd, NULL, test_app_start, NULL, NULL, NULL);
@@ -0,0 +1,47 @@
+/**
+ * \file test_conv.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief Fixed-point conversion against the float one it replaced.
+ */
+
+#include <zephyr/ztest.h>
+#include "test_app.h"
+#include "bench.h"
+#include "adc.h"
+#include "conv.h"
+
+#define TEST_CONV_MAX_ERR_MV 1      /* Largest error of the fixed-point path, against the float one rounded */
+
+/*
+ * Every ADC code of the linear channel converts within TEST_CONV_MAX_ERR_MV
+ * of the float reference.
+ */
+ZTEST(conv, test_accuracy)
+{
+    int32_t raw, fixed, ref;
+
+    for(raw = 0; raw < (1 << ADC_RESOLUTION); raw++)
+    {
+        fixed = conv_apply(ADC_POT_CHANNEL, raw);
+        ref = (int32_t)((float)raw * ADC_FULL_SCALE_MV / ((1 << ADC_RESOLUTION) - 1) + 0.5f);
+        zassert_within(fixed, ref, TEST_CONV_MAX_ERR_MV, "code %d: %d mV, float %d mV", raw, fixed, ref);
+    }
+}
+
+/*
+ * The fixed-point path is the cheaper one, per sample, on the block of the
+ * conv_ benchmarks.
+ */
+ZTEST(conv, test_cost)
+{
+    struct bench_result fixed, flt;
+
+    bench_cases_prepare();
+    bench_run(bench_case_find("conv_float"), &flt);
+    bench_run(bench_case_find("conv_fixed"), &fixed);
+    zassert_true(fixed.median <= flt.median, "fixed %u cycles per sample, float %u", fixed.median,
+                 flt.median);
+}
+
+ZTEST_SUITE(conv, NULL, test_app_start, NULL, NULL, NULL);
@@ -0,0 +1,70 @@
+/**
+ * \file test_latency.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief End-to-end latencies: no drops, right outputs, p99 within bounds.
+ */
+
+#include <zephyr/ztest.h>
+#include "test_app.h"
+#include "latency.h"
+#include "adc.h"
+#include "threads.h"
+
+#define TEST_LAT_EDGE_P99_US 1000       /* Button edge -> database, one thread wake-up */
+#define TEST_LAT_CMD_P99_US 5000        /* Command line -> pin, parser and outputs thread */
+
+static struct lat_result test_res;
+
+/*
+ * Runs a benchmark, skipping the test if the build cannot, and checks what
+ * every benchmark must meet: something measured, nothing dropped or wrong.
+ */
+static void test_lat_run(enum lat_bench b)
+{
+    int ret = latency_run(b, &test_res);
+
+    if(ret == -ENOTSUP)
+    {
+        ztest_test_skip();
+    }
+    zassert_ok(ret);
+    zassert_true(test_res.runs > 0, "nothing came out");
+    zassert_equal(test_res.dropped, 0, "%u of %u stimuli dropped", test_res.dropped,
+                  test_res.runs + test_res.dropped);
+    zassert_equal(test_res.errors, 0, "%u wrong outputs", test_res.errors);
+}
+
+ZTEST(latency, test_edge_to_db)
+{
+    test_lat_run(LAT_BENCH_EDGE_TO_DB);
+    zassert_true(test_res.p99_us <= TEST_LAT_EDGE_P99_US, "p99 %u us", test_res.p99_us);
+}
+
+ZTEST(latency, test_cmd_to_pin)
+{
+    if(!test_uart_ready())
+    {
+        ztest_test_skip();
+    }
+    test_lat_run(LAT_BENCH_CMD_TO_PIN);
+    zassert_true(test_res.p99_us <= TEST_LAT_CMD_P99_US, "p99 %u us", test_res.p99_us);
+}
+
+/*
+ * A block published later than the next one is due means the consumer fell behind.
+ */
+ZTEST(latency, test_adc_publish)
+{
+    uint32_t block_us = ADC_BLOCK_SAMPLES * period_get(PERIOD_ADC);
+
+    test_lat_run(LAT_BENCH_ADC_PUBLISH);
+    zassert_true(test_res.p99_us <= block_us, "p99 %u us, block %u us", test_res.p99_us, block_us);
+}
+
+ZTEST(latency, test_adc_step)
+{
+    test_lat_run(LAT_BENCH_ADC_STEP);
+}
+
+ZTEST_SUITE(latency, NULL, test_app_start, NULL, NULL, NULL);
@@ -0,0 +1,57 @@
+/**
+ * \file test_pid.c
+ * \author Francisco Heleno <francisco.c.heleno@ua.pt> and Hugo Carola <hugocarola@ua.pt>
+ * \date 17, October, 2026
+ * \brief PID step response on the plant model and loop period jitter.
+ */
+
+#include <zephyr/ztest.h>
+#include "test_app.h"
+#include "pid.h"
+#include "threads.h"
+
+#define TEST_PID_MS 1000                        /* Length of the step response */
+#define TEST_PID_OVERSHOOT 50                   /* Largest overshoot, per mille of the setpoint */
+#define TEST_PID_SETTLE_JOBS 300                /* Iterations to enter the settle band for good */
+#define TEST_PID_JOBS_PERCENT 95                /* Iterations that must run, of TEST_PID_MS / PID_PERIOD_US */
+
+/*
+ * Step from 0 to the default setpoint on the plant model, with the default
+ * gains, over TEST_PID_MS. Skipped while the loop runs on the ADC, to leave
+ * it alone.
+ */
+ZTEST(pid, test_step)
+{
+    struct pid_stats st;
+    uint32_t misses;
+    int32_t band, err;
+
+    pid_get_stats(&st);
+    if(st.mode == PID_ADC)
+    {
+        ztest_test_skip();
+    }
+
+    misses = tasks[TASK_PID].misses;
+    zassert_ok(pid_start(PID_PLANT));
+    k_msleep(TEST_PID_MS);
+    pid_get_stats(&st);
+    misses = tasks[TASK_PID].misses - misses;
+    pid_start(PID_OFF);
+
+    band = st.setpoint * PID_SETTLE_BAND / 1000;
+    err = st.setpoint - st.y;
+    zassert_true(st.jobs * 100 >= TEST_PID_MS * 1000 / PID_PERIOD_US * TEST_PID_JOBS_PERCENT,
+                 "%u iterations of %u", st.jobs, TEST_PID_MS * 1000 / PID_PERIOD_US);
+    zassert_equal(misses, 0, "%u deadlines missed", misses);
+    zassert_true(st.y_max - st.setpoint <= st.setpoint * TEST_PID_OVERSHOOT / 1000,
+                 "overshoot %d of %d", st.y_max - st.setpoint, st.setpoint);
+    zassert_true(st.settled_at <= TEST_PID_SETTLE_JOBS, "settled after %u iterations", st.settled_at);
+    zassert_true(err <= band && err >= -band, "error %d, band %d", err, band);
+    zassert_within((int32_t)k_cyc_to_us_floor32(st.period_max), PID_PERIOD_US,
+                   CONFIG_BENCH_TEST_PID_JITTER_US, "longest period %u us", k_cyc_to_us_floor32(st.period_max));
+    zassert_within((int32_t)k_cyc_to_us_floor32(st.period_min), PID_PERIOD_US,
+                   CONFIG_BENCH_TEST_PID_JITTER_US, "shortest period %u us", k_cyc_to_us_floor32(st.period_min));
+}
+
+ZTEST_SUITE(pid, NULL, test_app_start, NULL, NULL, NULL);
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""Host decoder for the binary frames sent on the console UART.
+
+Reads a raw capture of the UART (a file, or a serial port with pyserial) and
+prints one line per telemetry record and per historian record:
+
+    telemetry: seq timestamp_us adc0 .. adcN buttons outputs
+    history:   boot ms type id value
+
+Plain and packed telemetry (src/telem/telem.h) and historian blocks
+(src/hist/hist.h) are decoded; packed data goes through the same block codec
+as src/codec/codec.c, LZ4 included, with no dependency beyond the standard
+library.
+
+    tools/decode.py capture.bin
+    tools/decode.py /dev/ttyACM0 --baud 115200
+"""
+
+import argparse
+import struct
+import sys
+
+ADC_SCAN_CHANNELS = 4
+TELEM_RECORD = struct.Struct("<II%diBB" % ADC_SCAN_CHANNELS)
+TELEM_COLUMNS = 2 + ADC_SCAN_CHANNELS + 2
+HIST_HEADER = struct.Struct("<HBBIII")
+HIST_RECORD = struct.Struct("<IBBh")
+HIST_PACKED = 0x01
+CODEC_LZ4 = 0x01
+
+OP_TELEMETRY = 0xC0
+OP_HIST_BLOCK = 0xC1
+OP_TELEMETRY_PACKED = 0xC2
+
+
+def crc16_ccitt_false(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            raise ValueError("bad COBS")
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def lz4_block_decompress(src, size):
+    """Decompresses one raw LZ4 block (no frame header)."""
+    dst = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+        n = token >> 4
+        if n == 15:
+            while True:
+                b = src[i]
+                i += 1
+                n += b
+                if b != 255:
+                    break
+        dst += src[i:i + n]
+        i += n
+        if i >= len(src):
+            break
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        if offset == 0 or offset > len(dst):
+            raise ValueError("bad LZ4 offset")
+        m = token & 15
+        if m == 15:
+            while True:
+                b = src[i]
+                i += 1
+                m += b
+                if b != 255:
+                    break
+        m += 4
+        for _ in range(m):
+            dst.append(dst[-offset])
+    if len(dst) != size:
+        raise ValueError("bad LZ4 length")
+    return bytes(dst)
+
+
+def varint(buf, i):
+    x = 0
+    for k in range(5):
+        b = buf[i + k]
+        x |= (b & 0x7F) << (7 * k)
+        if not b & 0x80:
+            return x, i + k + 1
+    raise ValueError("bad varint")
+
+
+def codec_decode(buf, n):
+    """Decodes one codec block of n values. Returns (values, bytes used)."""
+    flags = buf[0]
+    i = 1
+    if flags & CODEC_LZ4:
+        vlen, i = varint(buf, i)
+        clen = buf[i] | (buf[i + 1] << 8)
+        i += 2
+        stream = lz4_block_decompress(buf[i:i + clen], vlen)
+        used = i + clen
+        i = 0
+    else:
+        stream = buf[1:]
+        used = None
+        i = 0
+    values = []
+    prev = 0
+    for _ in range(n):
+        z, i = varint(stream, i)
+        prev = (prev + ((z >> 1) ^ -(z & 1))) & 0xFFFFFFFF
+        values.append(prev - (1 << 32) if prev & 0x80000000 else prev)
+    return values, (used if used is not None else 1 + i)
+
+
+def print_telemetry(records):
+    for r in records:
+        print("telemetry", *r)
+
+
+def decode_frame(frame):
+    if len(frame) < 5 or crc16_ccitt_false(frame[:-2]) != struct.unpack_from("<H", frame, len(frame) - 2)[0]:
+        print("bad frame", frame.hex(), file=sys.stderr)
+        return
+    opcode, body = frame[1], frame[3:-2]
+
+    if opcode == OP_TELEMETRY:
+        count = body[0]
+        print_telemetry(TELEM_RECORD.unpack_from(body, 1 + k * TELEM_RECORD.size) for k in range(count))
+
+    elif opcode == OP_TELEMETRY_PACKED:
+        count = body[0]
+        v, _ = codec_decode(body[1:], count * TELEM_COLUMNS)
+        cols = [v[c * count:(c + 1) * count] for c in range(TELEM_COLUMNS)]
+        print_telemetry(zip(*cols))
+
+    elif opcode == OP_HIST_BLOCK:
+        if not body:
+            print("history end")
+            return
+        boot, count, flags, seq, first_ms, last_ms = HIST_HEADER.unpack_from(body)
+        data = body[HIST_HEADER.size:]
+        if flags & HIST_PACKED:
+            v, _ = codec_decode(data, 4 * count)
+            recs = zip(*[v[c * count:(c + 1) * count] for c in range(4)])
+        else:
+            recs = (HIST_RECORD.unpack_from(data, k * HIST_RECORD.size) for k in range(count))
+        for ms, typ, ident, value in recs:
+            print("history", boot, ms, typ, ident, value)
+
+    else:
+        print("response", frame[:-2].hex())
+
+
+def frames(stream):
+    """Yields the decoded frames found between 0x00 delimiters, skipping ASCII."""
+    buf = bytearray()
+    inside = False
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        for b in chunk:
+            if b != 0:
+                if inside:
+                    buf.append(b)
+                continue
+            if inside and buf:
+                try:
+                    yield cobs_decode(bytes(buf))
+                except ValueError:
+                    print("bad COBS", bytes(buf).hex(), file=sys.stderr)
+                buf.clear()
+                inside = False
+            else:
+                inside = True
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("source", help="capture file or serial port")
+    ap.add_argument("--baud", type=int, default=115200)
+    args = ap.parse_args()
+
+    if args.source.startswith("/dev/"):
+        import serial
+        stream = serial.Serial(args.source, args.baud, timeout=None)
+    else:
+        stream = open(args.source, "rb")
+
+    for frame in frames(stream):
+        decode_frame(frame)
+
+
+if __name__ == "__main__":
+    main()
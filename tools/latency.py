@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Runs the end-to-end latency bench on a native_sim build.
+
+Starts the zephyr.exe of a native_sim build, finds the pseudo-terminal its
+uart0 is attached to, sends the /l command and collects the JSON lines of
+the bench (src/bench/latency.h) until {"bench":"done"}. The results are
+printed as a table and, with --out, written one JSON object per line so
+runs can be compared.
+
+With --budgets the hot-path benchmarks (/m, src/bench/bench.h) run as well
+and the exit status is 1 if any of them went over its cycle budget.
+
+    west build -b native_sim && tools/latency.py build/zephyr/zephyr.exe
+    tools/latency.py build/zephyr/zephyr.exe --out latency.jsonl --budgets
+"""
+
+import argparse
+import json
+import os
+import re
+import select
+import subprocess
+import sys
+import time
+
+PTY_RE = re.compile(rb"uart connected to pseudotty: (/dev/pts/\d+)")
+
+
+def read_lines(fd, deadline):
+    """Yields the lines read from fd until the deadline."""
+    buf = b""
+    while time.monotonic() < deadline:
+        r, _, _ = select.select([fd], [], [], 0.1)
+        if not r:
+            continue
+        chunk = os.read(fd, 4096)
+        if not chunk:
+            return
+        buf += chunk
+        while b"\n" in buf:
+            line, buf = buf.split(b"\n", 1)
+            yield line.strip(b"\r")
+
+
+def find_pty(proc, deadline):
+    for line in read_lines(proc.stdout.fileno(), deadline):
+        m = PTY_RE.search(line)
+        if m:
+            return m.group(1).decode()
+    return None
+
+
+def run_budgets(fd, timeout):
+    """Runs /m and returns the lines of the benchmarks over budget, or None on timeout."""
+    os.write(fd, b"/m\r")
+    over = []
+    for line in read_lines(fd, time.monotonic() + timeout):
+        text = line.decode(errors="replace")
+        start = text.find("bench ")
+        if start >= 0 and text.endswith(" OVER"):
+            over.append(text[start:])
+        if "bench: done" in text:
+            return over
+    return None
+
+
+def run(exe, timeout, budgets):
+    proc = subprocess.Popen([exe], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    try:
+        pty = find_pty(proc, time.monotonic() + 10)
+        if pty is None:
+            sys.exit("no pseudotty line from %s" % exe)
+
+        fd = os.open(pty, os.O_RDWR | os.O_NOCTTY)
+        try:
+            # Let the application boot, then start the bench
+            time.sleep(1)
+            os.write(fd, b"/l\r")
+
+            results = []
+            for line in read_lines(fd, time.monotonic() + timeout):
+                start = line.find(b"{\"bench\"")
+                if start < 0:
+                    continue
+                try:
+                    res = json.loads(line[start:])
+                except ValueError:
+                    continue
+                if res["bench"] == "done":
+                    break
+                results.append(res)
+            else:
+                sys.exit("bench did not finish within %d s" % timeout)
+
+            over = run_budgets(fd, timeout) if budgets else []
+            if over is None:
+                sys.exit("hot-path benchmarks did not finish within %d s" % timeout)
+            return results, over
+        finally:
+            os.close(fd)
+    finally:
+        proc.terminate()
+        proc.wait()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("exe", help="zephyr.exe of a native_sim build")
+    ap.add_argument("--timeout", type=int, default=120, help="seconds to wait for the bench")
+    ap.add_argument("--out", help="write the results here, one JSON object per line")
+    ap.add_argument("--budgets", action="store_true", help="also run /m and fail on a cycle budget exceeded")
+    args = ap.parse_args()
+
+    results, over = run(args.exe, args.timeout, args.budgets)
+
+    for res in results:
+        name = res.pop("bench")
+        print("%-14s %s" % (name, " ".join("%s=%s" % kv for kv in res.items())))
+        res["bench"] = name
+
+    if args.out:
+        with open(args.out, "w") as f:
+            for res in results:
+                f.write(json.dumps(res) + "\n")
+
+    for line in over:
+        print(line)
+    if over:
+        sys.exit("%d benchmark(s) over budget" % len(over))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Assembler and uploader for the PLC scan engine (src/plc/plc.h).
+
+A program is one instruction per line, operands separated by spaces, '#'
+starts a comment:
+
+    # Output 1 follows button 1 while the pot is above 1.5 V, after 100 ms
+    LD_IN 0
+    LD_ADC 0
+    PUSH 1500
+    GT
+    AND
+    TON 0 100
+    ST_OUT 0
+    END
+
+Without a port the bytecode is only assembled (and written with --out).
+With a port it is uploaded with PROTO_OP_PLC_WRITE chunks and installed with
+PROTO_OP_PLC_SWAP; the scan switches to it without stopping. --unload
+removes the running program, --stats prints the scan counters.
+
+    tools/plc.py interlock.plc --out interlock.bin
+    tools/plc.py interlock.plc /dev/ttyACM0
+    tools/plc.py --stats /dev/ttyACM0
+"""
+
+import argparse
+import struct
+import sys
+
+from decode import cobs_decode, crc16_ccitt_false
+
+# name: (opcode, operand struct)
+OPS = {
+    "END": (0x00, ""),
+    "LD_IN": (0x01, "B"),
+    "LD_OUT": (0x02, "B"),
+    "LD_M": (0x03, "B"),
+    "LD_ADC": (0x04, "B"),
+    "PUSH": (0x05, "i"),
+    "AND": (0x06, ""),
+    "OR": (0x07, ""),
+    "XOR": (0x08, ""),
+    "NOT": (0x09, ""),
+    "GT": (0x0A, ""),
+    "GE": (0x0B, ""),
+    "LT": (0x0C, ""),
+    "LE": (0x0D, ""),
+    "EQ": (0x0E, ""),
+    "NE": (0x0F, ""),
+    "ST_OUT": (0x10, "B"),
+    "ST_M": (0x11, "B"),
+    "TON": (0x12, "BH"),
+    "TOF": (0x13, "BH"),
+    "CTU": (0x14, "BH"),
+    "RES": (0x15, "B"),
+}
+
+PROTO_MAX_PAYLOAD = 32
+OP_PLC_WRITE = 0x07
+OP_PLC_SWAP = 0x08
+OP_PLC_STATS = 0x09
+STATUS = ["ok", "unknown opcode", "bad length", "invalid program", "busy"]
+
+
+def assemble(text):
+    code = bytearray()
+    for n, line in enumerate(text.splitlines(), 1):
+        words = line.split("#", 1)[0].split()
+        if not words:
+            continue
+        name = words[0].upper()
+        if name not in OPS:
+            sys.exit("line %d: unknown instruction %s" % (n, words[0]))
+        op, fmt = OPS[name]
+        if len(words) - 1 != len(fmt):
+            sys.exit("line %d: %s takes %d operands" % (n, name, len(fmt)))
+        code.append(op)
+        code += struct.pack("<" + fmt, *(int(w, 0) for w in words[1:]))
+    if not code or code[-1] != OPS["END"][0]:
+        code.append(OPS["END"][0])
+    return bytes(code)
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+            continue
+        block.append(b)
+        if len(block) == 254:
+            out += bytes([255]) + block
+            block = bytearray()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out)
+
+
+class Link:
+    def __init__(self, port, baud):
+        import serial
+        self.ser = serial.Serial(port, baud, timeout=2)
+        self.req_id = 0
+
+    def request(self, opcode, payload=b""):
+        self.req_id = (self.req_id + 1) & 0xFF
+        frame = bytes([self.req_id, opcode]) + payload
+        frame += struct.pack("<H", crc16_ccitt_false(frame))
+        self.ser.write(b"\0" + cobs_encode(frame) + b"\0")
+        buf = bytearray()
+        while True:
+            c = self.ser.read(1)
+            if not c:
+                sys.exit("no response to opcode 0x%02x" % opcode)
+            if c != b"\0":
+                buf += c
+                continue
+            if not buf:
+                continue
+            try:
+                rsp = cobs_decode(bytes(buf))
+            except ValueError:
+                rsp = b""
+            buf = bytearray()
+            # Skip the console and any unsolicited frame
+            if (len(rsp) >= 5 and rsp[0] == self.req_id and rsp[1] == opcode | 0x80 and
+                    crc16_ccitt_false(rsp[:-2]) == struct.unpack("<H", rsp[-2:])[0]):
+                if rsp[2] != 0:
+                    sys.exit("opcode 0x%02x: %s" % (opcode, STATUS[rsp[2]] if rsp[2] < len(STATUS) else rsp[2]))
+                return rsp[3:-2]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("program", nargs="?", help="program source")
+    ap.add_argument("port", nargs="?", help="serial port to upload to")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--out", help="write the bytecode to this file")
+    ap.add_argument("--unload", action="store_true", help="remove the running program")
+    ap.add_argument("--stats", action="store_true", help="print the scan counters")
+    args = ap.parse_args()
+
+    # A lone argument is the port when no program is needed
+    if (args.unload or args.stats) and args.port is None:
+        args.program, args.port = None, args.program
+
+    code = None
+    if args.program:
+        with open(args.program) as f:
+            code = assemble(f.read())
+        print("%d bytes" % len(code))
+        if args.out:
+            with open(args.out, "wb") as f:
+                f.write(code)
+
+    if args.port is None:
+        return
+    link = Link(args.port, args.baud)
+    if code is not None:
+        step = PROTO_MAX_PAYLOAD - 2
+        for off in range(0, len(code), step):
+            link.request(OP_PLC_WRITE, struct.pack("<H", off) + code[off:off + step])
+        link.request(OP_PLC_SWAP, struct.pack("<H", len(code)))
+        print("installed")
+    elif args.unload:
+        link.request(OP_PLC_SWAP, struct.pack("<H", 0))
+        print("unloaded")
+    if args.stats:
+        scans, last, peak, insns, loads, errors = struct.unpack("<IIIHII", link.request(OP_PLC_STATS))
+        print("instructions %d, scans %d, scan %d us (max %d us), loads %d (rejected %d)" %
+              (insns, scans, last, peak, loads, errors))
+
+
+if __name__ == "__main__":
+    main()